@@ -395,6 +395,9 @@ void EditorComponent::ResizeLayout()
 	saveModeComboBox.SetSize(XMFLOAT2(120, 20));
 	saveModeComboBox.SetPos(XMFLOAT2(screenW - 140, 70));
 
+	saveCompressionCheckBox.SetSize(XMFLOAT2(20, 20));
+	saveCompressionCheckBox.SetPos(XMFLOAT2(screenW - 370, 70));
+
 	pathTraceTargetSlider.SetSize(XMFLOAT2(200, 20));
 	pathTraceTargetSlider.SetPos(XMFLOAT2(screenW - 240, 100));
 
@@ -694,7 +697,9 @@ void EditorComponent::Load()
 					wiResourceManager::MODE embed_mode = (wiResourceManager::MODE)saveModeComboBox.GetItemUserData(saveModeComboBox.GetSelected());
 					wiResourceManager::SetMode(embed_mode);
 
-					scene.Serialize(archive);
+					archive.SetCompressionEnabled(saveCompressionCheckBox.GetCheck());
+
+					scene.Serialize(archive, true);
 
 					ResetHistory();
 				}
@@ -962,6 +967,11 @@ void EditorComponent::Load()
 	saveModeComboBox.SetTooltip("Choose whether to embed resources (textures, sounds...) in the scene file when saving, or keep them as separate files");
 	GetGUI().AddWidget(&saveModeComboBox);
 
+	saveCompressionCheckBox.Create("Compress: ");
+	saveCompressionCheckBox.SetTooltip("Compress the scene file when saving. The file will be smaller, but it will load slower when it is already in the file cache or on fast storage, because it must be decompressed.\nKeep it disabled for scenes where load time matters.");
+	saveCompressionCheckBox.SetCheck(false);
+	GetGUI().AddWidget(&saveCompressionCheckBox);
+
 
 	pathTraceTargetSlider.Create(1, 2048, 1024, 2047, "Path tracing sample count: ");
 	pathTraceTargetSlider.SetTooltip("The path tracing will perform this many samples per pixel.");
@@ -91,6 +91,7 @@ public:
 	wiCheckBox isTranslatorCheckBox;
 	wiButton saveButton;
 	wiComboBox saveModeComboBox;
+	wiCheckBox saveCompressionCheckBox;
 	wiButton modelButton;
 	wiButton scriptButton;
 	wiButton clearButton;
@@ -77,7 +77,7 @@ struct TerraGen : public wiWindow
 void MeshWindow::Create(EditorComponent* editor)
 {
 	wiWindow::Create("Mesh Window");
-	SetSize(XMFLOAT2(580, 540));
+	SetSize(XMFLOAT2(580, 560));
 
 	float x = 150;
 	float y = 0;
@@ -327,6 +327,20 @@ void MeshWindow::Create(EditorComponent* editor)
 		});
 	AddWidget(&optimizeButton);
 
+	cookConvexHullButton.Create("Cook Physics Hull");
+	cookConvexHullButton.SetTooltip("Compute a simplified convex hull for the Convex Hull physics shape. It is saved with the mesh, so its rigid bodies are created faster when the scene is loaded.");
+	cookConvexHullButton.SetSize(XMFLOAT2(240, hei));
+	cookConvexHullButton.SetPos(XMFLOAT2(x - 50, y += step));
+	cookConvexHullButton.OnClick([&](wiEventArgs args) {
+		MeshComponent* mesh = wiScene::GetScene().meshes.GetComponent(entity);
+		if (mesh != nullptr)
+		{
+			wiPhysicsEngine::CookConvexHull(*mesh);
+			SetEntity(entity);
+		}
+	});
+	AddWidget(&cookConvexHullButton);
+
 	x = 150;
 	y = 190;
 
@@ -627,6 +641,7 @@ void MeshWindow::SetEntity(Entity entity)
 		if (mesh->vertexBuffer_TAN.IsValid()) ss << "tangent; ";
 		if (mesh->streamoutBuffer_POS.IsValid()) ss << "streamout_position; ";
 		if (mesh->streamoutBuffer_TAN.IsValid()) ss << "streamout_tangents; ";
+		if (!mesh->convexhull_positions.empty()) ss << std::endl << "Physics convex hull vertex count: " << mesh->convexhull_positions.size();
 		if (mesh->IsTerrain()) ss << std::endl << std::endl << "Terrain will use 4 blend materials and blend by vertex colors, the default one is always the subset material and uses RED vertex color channel mask, the other 3 are selectable below.";
 		meshInfoLabel.SetText(ss.str());
 
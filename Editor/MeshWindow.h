@@ -27,6 +27,7 @@ public:
 	wiButton recenterButton;
 	wiButton recenterToBottomButton;
 	wiButton optimizeButton;
+	wiButton cookConvexHullButton;
 
 	wiCheckBox terrainCheckBox;
 	wiComboBox terrainMat1Combo;
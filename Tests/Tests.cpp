@@ -5,6 +5,12 @@
 #include <sstream>
 #include <fstream>
 #include <thread>
+#include <filesystem>
+
+#ifdef PLATFORM_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif // PLATFORM_LINUX
 
 using namespace wiECS;
 using namespace wiScene;
@@ -120,6 +126,9 @@ void TestsRenderer::Load()
 	testSelector.AddItem("Controller Test");
 	testSelector.AddItem("Inverse Kinematics");
 	testSelector.AddItem("65k Instances");
+	testSelector.AddItem("ECS Performance Test");
+	testSelector.AddItem("RenderQueue Sort Test");
+	testSelector.AddItem("Archive Load Test");
 	testSelector.SetMaxVisibleItemCount(10);
 	testSelector.OnSelect([=](wiEventArgs args) {
 
@@ -293,6 +302,18 @@ void TestsRenderer::Load()
 		}
 		break;
 
+		case 19:
+			RunECSPerformanceTest();
+			break;
+
+		case 20:
+			RunRenderQueueSortTest();
+			break;
+
+		case 21:
+			RunArchiveLoadTest();
+			break;
+
 		default:
 			assert(0);
 			break;
@@ -437,6 +458,354 @@ void TestsRenderer::RunJobSystemTest()
 		ss << "wiJobSystem::Dispatch() took " << time << " milliseconds" << std::endl;
 	}
 
+	ss << std::endl;
+	ss << "3) Dispatch overhead test:" << std::endl;
+
+	// Empty jobs, so only the scheduling cost is measured:
+	{
+		const uint32_t groupSizes[] = { 1, 64, 4096 };
+		for (uint32_t groupSize : groupSizes)
+		{
+			timer.record();
+			wiJobSystem::Dispatch(ctx, itemCount, groupSize, [](wiJobArgs args) {});
+			wiJobSystem::Wait(ctx);
+			double time = timer.elapsed();
+			ss << "groupSize = " << groupSize << ": " << time * 1000000.0 / itemCount << " nanoseconds per job" << std::endl;
+		}
+	}
+
+	ss << std::endl;
+	ss << "4) Scaling test:" << std::endl;
+
+	// The same workload split into as many groups as threads are allowed to work on it.
+	//	One group can only execute on one thread, so this measures scaling from 1 to N threads:
+	{
+		const uint32_t workCount = 64;
+		const uint32_t maxThreads = wiJobSystem::GetThreadCount() + 1; // +1: the waiting thread also works
+		double time_single = 0;
+		for (uint32_t threads = 1;; threads = std::min(threads * 2, maxThreads))
+		{
+			timer.record();
+			wiJobSystem::Dispatch(ctx, workCount, wiJobSystem::DispatchGroupCount(workCount, threads), [](wiJobArgs args) {
+				wiHelper::Spin(1);
+			});
+			wiJobSystem::Wait(ctx);
+			double time = timer.elapsed();
+			if (threads == 1)
+			{
+				time_single = time;
+			}
+			ss << threads << " threads: " << time << " milliseconds, speedup: " << time_single / time << "x" << std::endl;
+			if (threads == maxThreads)
+			{
+				break;
+			}
+		}
+	}
+
+	static wiSpriteFont font;
+	font = wiSpriteFont(ss.str());
+	font.params.posX = GetLogicalWidth() / 2;
+	font.params.posY = GetLogicalHeight() / 2;
+	font.params.h_align = WIFALIGN_CENTER;
+	font.params.v_align = WIFALIGN_CENTER;
+	font.params.size = 24;
+	this->AddFont(&font);
+}
+void TestsRenderer::RunECSPerformanceTest()
+{
+	wiTimer timer;
+
+	// This will compare the entity lookup of ComponentManager with a hash map based lookup
+	const uint32_t entityCount = 1000000;
+	std::stringstream ss("");
+	ss << "ECS performance test:" << std::endl;
+	ss << "You can find out more in Tests.cpp, RunECSPerformanceTest() function." << std::endl << std::endl;
+
+	std::vector<Entity> entities(entityCount);
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		entities[i] = CreateEntity();
+	}
+
+	ComponentManager<TransformComponent> manager;
+	std::unordered_map<Entity, size_t> hashmap;
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		manager.Create(entities[i]);
+		hashmap[entities[i]] = i;
+	}
+
+	// Random access order, like a system looking up other components by entity:
+	std::vector<Entity> queries(entities);
+	for (uint32_t i = entityCount - 1; i > 0; --i)
+	{
+		std::swap(queries[i], queries[wiRandom::getRandom(0, (int)i)]);
+	}
+
+	ss << "Lookup of " << entityCount << " entities in random order:" << std::endl;
+
+	// std::unordered_map test:
+	{
+		size_t checksum = 0;
+		timer.record();
+		for (Entity entity : queries)
+		{
+			auto it = hashmap.find(entity);
+			if (it != hashmap.end())
+			{
+				checksum += it->second;
+			}
+		}
+		double time = timer.elapsed();
+		ss << "std::unordered_map took " << time << " milliseconds (checksum: " << checksum << ")" << std::endl;
+	}
+
+	// ComponentManager test:
+	{
+		size_t checksum = 0;
+		timer.record();
+		for (Entity entity : queries)
+		{
+			size_t index = manager.GetIndex(entity);
+			if (index != ~0ull)
+			{
+				checksum += index;
+			}
+		}
+		double time = timer.elapsed();
+		ss << "ComponentManager::GetIndex() took " << time << " milliseconds (checksum: " << checksum << ")" << std::endl;
+	}
+
+	// ComponentManager::Contains() with non-existing entities:
+	{
+		size_t found = 0;
+		timer.record();
+		for (Entity entity : queries)
+		{
+			found += manager.Contains(entity + entityCount) ? 1 : 0;
+		}
+		double time = timer.elapsed();
+		ss << "ComponentManager::Contains() of missing entities took " << time << " milliseconds" << std::endl;
+	}
+
+	static wiSpriteFont font;
+	font = wiSpriteFont(ss.str());
+	font.params.posX = GetLogicalWidth() / 2;
+	font.params.posY = GetLogicalHeight() / 2;
+	font.params.h_align = WIFALIGN_CENTER;
+	font.params.v_align = WIFALIGN_CENTER;
+	font.params.size = 24;
+	this->AddFont(&font);
+}
+void TestsRenderer::RunRenderQueueSortTest()
+{
+	wiTimer timer;
+
+	// This will compare the RenderQueue radix sort with the previous std::sort of 32-bit hashes
+	const uint32_t batchCount = 100000;
+	const uint32_t meshCount = 5000;
+	std::stringstream ss("");
+	ss << "RenderQueue sort test:" << std::endl;
+	ss << "You can find out more in Tests.cpp, RunRenderQueueSortTest() function." << std::endl << std::endl;
+
+	std::vector<RenderBatch> batches(batchCount);
+	std::vector<float> distances(batchCount);
+	for (uint32_t i = 0; i < batchCount; ++i)
+	{
+		distances[i] = wiRandom::getRandom(0, 100000) * 0.01f;
+		batches[i].Create(wiRandom::getRandom(0, (int)meshCount - 1), i, distances[i]);
+	}
+
+	ss << "Sorting " << batchCount << " batches:" << std::endl;
+
+	// Previous path: 24-bit mesh index and 8-bit truncated distance, sorted with std::sort
+	{
+		struct HashedBatch
+		{
+			uint32_t hash;
+			uint32_t instance;
+		};
+		std::vector<HashedBatch> hashed(batchCount);
+		for (uint32_t i = 0; i < batchCount; ++i)
+		{
+			const float distance = wiRandom::getRandom(0, 100000) * 0.01f;
+			hashed[i].hash = (batches[i].GetMeshIndex() & 0x00FFFFFF) | (((uint32_t)distance & 0xFF) << 24);
+			hashed[i].instance = i;
+		}
+		timer.record();
+		std::sort(hashed.begin(), hashed.end(), [](const HashedBatch& a, const HashedBatch& b) {
+			return a.hash < b.hash;
+		});
+		double time = timer.elapsed();
+		ss << "std::sort of 32-bit keys took " << time << " milliseconds" << std::endl;
+	}
+
+	// RenderQueue front to back:
+	{
+		std::vector<RenderBatch> sorted(batches);
+		RenderQueue queue;
+		queue.batchArray = sorted.data();
+		queue.batchCount = batchCount;
+		timer.record();
+		queue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+		double time = timer.elapsed();
+		ss << "RenderQueue::sort(SORT_FRONT_TO_BACK) of 64-bit keys took " << time << " milliseconds" << std::endl;
+
+		// Batches of different meshes must be ordered front to back by their depth buckets,
+		//	so a batch can only be preceded by batches that are less than 1.5x farther away (the depth bucket size):
+		bool ordered = true;
+		float max_distance = 0;
+		for (uint32_t i = 0; i < batchCount; ++i)
+		{
+			const float distance = distances[sorted[i].GetInstanceIndex()];
+			if (max_distance > std::max(distance, 0.01f) * 1.5f)
+			{
+				ordered = false;
+			}
+			max_distance = std::max(max_distance, distance);
+		}
+
+		// A near mesh with a higher index must come before a far mesh with a lower index:
+		RenderBatch pair[2];
+		pair[0].Create(0, 0, 100.0f);
+		pair[1].Create(1, 1, 10.0f);
+		RenderQueue pair_queue;
+		pair_queue.batchArray = pair;
+		pair_queue.batchCount = 2;
+		pair_queue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+		ordered &= pair[0].GetMeshIndex() == 1;
+
+		ss << "Front to back order across meshes: " << (ordered ? "passed" : "FAILED") << std::endl;
+	}
+
+	// RenderQueue back to front:
+	{
+		std::vector<RenderBatch> sorted(batches);
+		RenderQueue queue;
+		queue.batchArray = sorted.data();
+		queue.batchCount = batchCount;
+		timer.record();
+		queue.sort(RenderQueue::SORT_BACK_TO_FRONT);
+		double time = timer.elapsed();
+		ss << "RenderQueue::sort(SORT_BACK_TO_FRONT) of 64-bit keys took " << time << " milliseconds" << std::endl;
+	}
+
+	static wiSpriteFont font;
+	font = wiSpriteFont(ss.str());
+	font.params.posX = GetLogicalWidth() / 2;
+	font.params.posY = GetLogicalHeight() / 2;
+	font.params.h_align = WIFALIGN_CENTER;
+	font.params.v_align = WIFALIGN_CENTER;
+	font.params.size = 24;
+	this->AddFont(&font);
+}
+void TestsRenderer::RunArchiveLoadTest()
+{
+	wiTimer timer;
+
+	// This will compare loading an archive that is read into memory with a memory mapped and a compressed archive
+	//	The cold loads read the file from the storage device instead of the OS file cache, this is where compression can pay off
+	const size_t vertexCount = 8 * 1024 * 1024;
+	std::stringstream ss("");
+	ss << "Archive load test:" << std::endl;
+	ss << "You can find out more in Tests.cpp, RunArchiveLoadTest() function." << std::endl << std::endl;
+
+	// Peak resident memory since the last reset in megabytes, only available on Linux:
+	auto reset_peak_memory = []() {
+#ifdef PLATFORM_LINUX
+		std::ofstream("/proc/self/clear_refs") << "5";
+#endif // PLATFORM_LINUX
+	};
+	auto get_peak_memory = []() -> double {
+#ifdef PLATFORM_LINUX
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 6, "VmHWM:") == 0)
+			{
+				return std::stod(line.substr(6)) / 1024.0;
+			}
+		}
+#endif // PLATFORM_LINUX
+		return 0;
+	};
+	// Removes the file from the OS file cache, so the next load reads it from the storage device, only available on Linux:
+	auto evict_file_cache = [](const std::string& name) {
+#ifdef PLATFORM_LINUX
+		int fd = open(name.c_str(), O_RDONLY);
+		if (fd >= 0)
+		{
+			fdatasync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+#endif // PLATFORM_LINUX
+	};
+
+	const std::string fileName = (std::filesystem::temp_directory_path() / "wiArchiveLoadTest.wiscene").string();
+	const std::string fileName_compressed = (std::filesystem::temp_directory_path() / "wiArchiveLoadTest_compressed.wiscene").string();
+	for (const std::string& name : { fileName, fileName_compressed })
+	{
+		std::vector<XMFLOAT3> vertex_positions(vertexCount);
+		std::vector<XMFLOAT3> vertex_normals(vertexCount);
+		std::vector<uint32_t> indices(vertexCount * 2);
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			vertex_positions[i] = XMFLOAT3(float(i), float(i) * 0.5f, float(i) * 0.25f);
+			vertex_normals[i] = XMFLOAT3(0, 1, 0);
+		}
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			indices[i] = uint32_t(i % vertexCount);
+		}
+		wiArchive archive(name, false);
+		archive.SetCompressionEnabled(name == fileName_compressed);
+		archive.WriteBlock(vertex_positions);
+		archive.WriteBlock(vertex_normals);
+		archive.WriteBlock(indices);
+	}
+	const double fileSize = double(std::filesystem::file_size(fileName)) / (1024.0 * 1024.0);
+	const double fileSize_compressed = double(std::filesystem::file_size(fileName_compressed)) / (1024.0 * 1024.0);
+	ss << "Loading " << fileSize << " MB archive (" << fileSize_compressed << " MB compressed):" << std::endl;
+
+	auto load = [&](const std::string& name, bool memoryMapped, bool cold, const char* description) {
+		std::vector<XMFLOAT3> vertex_positions;
+		std::vector<XMFLOAT3> vertex_normals;
+		std::vector<uint32_t> indices;
+
+		if (cold)
+		{
+			evict_file_cache(name);
+		}
+		reset_peak_memory();
+		const double memory_before = get_peak_memory();
+		timer.record();
+		{
+			wiArchive archive(name, true, memoryMapped);
+			archive.ReadBlock(vertex_positions);
+			archive.ReadBlock(vertex_normals);
+			archive.ReadBlock(indices);
+		}
+		double time = timer.elapsed();
+		ss << description << ": " << time << " milliseconds";
+		ss << ", peak memory increase: " << get_peak_memory() - memory_before << " MB" << std::endl;
+	};
+	load(fileName, false, false, "Read into memory");
+	load(fileName, true, false, "Memory mapped");
+	load(fileName_compressed, true, false, "Compressed");
+#ifdef PLATFORM_LINUX
+	load(fileName, false, true, "Read into memory (cold)");
+	load(fileName, true, true, "Memory mapped (cold)");
+	load(fileName_compressed, true, true, "Compressed (cold)");
+#else
+	ss << "Cold loads are only measured on Linux" << std::endl;
+#endif // PLATFORM_LINUX
+
+	std::filesystem::remove(fileName);
+	std::filesystem::remove(fileName_compressed);
+
 	static wiSpriteFont font;
 	font = wiSpriteFont(ss.str());
 	font.params.posX = GetLogicalWidth() / 2;
@@ -16,6 +16,9 @@ public:
 	void RunFontTest();
 	void RunSpriteTest();
 	void RunNetworkTest();
+	void RunECSPerformanceTest();
+	void RunRenderQueueSortTest();
+	void RunArchiveLoadTest();
 };
 
 class Tests : public MainComponent
@@ -15,10 +15,12 @@
 #include "wiFont.h"
 #include "wiImage.h"
 #include "wiEvent.h"
+#include "wiPhysicsEngine.h"
 
 #include "wiGraphicsDevice_DX11.h"
 #include "wiGraphicsDevice_DX12.h"
 #include "wiGraphicsDevice_Vulkan.h"
+#include "wiGraphicsDevice_Null.h"
 
 #include "Utility/replace_new.h"
 
@@ -129,6 +131,9 @@ void MainComponent::Run()
 			GetActivePath()->PreUpdate();
 		}
 
+		// The asynchronous physics simulation runs at the same rate as the fixed time update:
+		wiPhysicsEngine::SetFixedTimestep(1.0f / targetFrameRate);
+
 		// Fixed time update:
 		auto range = wiProfiler::BeginRangeCPU("Fixed Update");
 		{
@@ -359,6 +364,7 @@ void MainComponent::SetWindow(wiPlatform::window_type window, bool fullscreen)
 		bool use_dx11 = wiStartupArguments::HasArgument("dx11");
 		bool use_dx12 = wiStartupArguments::HasArgument("dx12");
 		bool use_vulkan = wiStartupArguments::HasArgument("vulkan");
+		bool use_null = wiStartupArguments::HasArgument("nulldevice"); // no GPU is used, for headless CPU benchmarking
 
 #ifndef WICKEDENGINE_BUILD_DX11
 		if (use_dx11) {
@@ -379,7 +385,7 @@ void MainComponent::SetWindow(wiPlatform::window_type window, bool fullscreen)
 		}
 #endif
 
-		if (!use_dx11 && !use_dx12 && !use_vulkan)
+		if (!use_dx11 && !use_dx12 && !use_vulkan && !use_null)
 		{
 #if defined(WICKEDENGINE_BUILD_DX11)
 			use_dx11 = true;
@@ -392,9 +398,13 @@ void MainComponent::SetWindow(wiPlatform::window_type window, bool fullscreen)
 			assert(false);
 #endif
 		}
-		assert(use_dx11 || use_dx12 || use_vulkan);
+		assert(use_dx11 || use_dx12 || use_vulkan || use_null);
 
-		if (use_vulkan)
+		if (use_null)
+		{
+			wiRenderer::SetDevice(std::make_shared<GraphicsDevice_Null>());
+		}
+		else if (use_vulkan)
 		{
 #ifdef WICKEDENGINE_BUILD_VULKAN
 			wiRenderer::SetShaderPath(wiRenderer::GetShaderPath() + "spirv/");
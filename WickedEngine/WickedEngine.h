@@ -38,6 +38,7 @@
 #include "wiRawInput.h"
 #include "wiXInput.h"
 #include "wiTextureHelper.h"
+#include "wiTextureCooker.h"
 #include "wiRandom.h"
 #include "wiColor.h"
 #include "wiPhysicsEngine.h"
@@ -55,6 +56,8 @@
 #include "wiOcean.h"
 #include "wiStartupArguments.h"
 #include "wiGPUBVH.h"
+#include "wiBVH.h"
+#include "wiRenderQueue.h"
 #include "wiGPUSortLib.h"
 #include "wiJobSystem.h"
 #include "wiNetwork.h"
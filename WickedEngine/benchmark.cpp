@@ -0,0 +1,599 @@
+#include "WickedEngine.h"
+#include "wiGraphicsDevice_Null.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+using namespace wiECS;
+using namespace wiScene;
+
+// Headless benchmark of the engine CPU systems over synthetic scenes, results are written as JSON for regression tracking
+//	No window and no GPU is used, rendering resources are created by the null graphics device
+
+struct Settings
+{
+	uint32_t objects = 10000;		// object count (meshes are instanced)
+	uint32_t depth = 4;				// objects are attached in hierarchy chains of this length
+	uint32_t armatures = 64;		// armature count, each of them with a skinned mesh
+	uint32_t bones = 32;			// bone count of each armature
+	uint32_t lights = 256;			// point light count
+	uint32_t rigidbodies = 2000;	// rigid body count of the physics benchmark, the bodies are stacked on a ground plane
+	uint32_t characters = 300;		// character count of the spring and IK benchmark, each of them with hair springs and foot IK
+	uint32_t iterations = 100;		// measured iterations of each benchmark
+	uint32_t warmup = 5;			// iterations that are run before measuring
+	uint32_t rays = 64;				// rays traced in one iteration of the pick benchmark
+	uint32_t seed = 1;				// seed of the scene generator, the same seed always generates the same scene
+	std::string output = "benchmark_results.json";
+};
+Settings settings;
+
+struct Result
+{
+	std::string name;
+	std::vector<double> samples; // milliseconds
+};
+std::vector<Result> results;
+
+// Runs the function for the warmup and measured iterations, prepare is called before each iteration outside of the measurement
+void Run(const std::string& name, const std::function<void()>& func, const std::function<void()>& prepare = nullptr)
+{
+	Result result;
+	result.name = name;
+	result.samples.reserve(settings.iterations);
+
+	wiTimer timer;
+	for (uint32_t i = 0; i < settings.warmup + settings.iterations; ++i)
+	{
+		if (prepare != nullptr)
+		{
+			prepare();
+		}
+		timer.record();
+		func();
+		double time = timer.elapsed();
+		if (i >= settings.warmup)
+		{
+			result.samples.push_back(time);
+		}
+	}
+
+	double mean = 0;
+	for (double x : result.samples)
+	{
+		mean += x;
+	}
+	mean /= std::max(size_t(1), result.samples.size());
+	std::cout << "\t" << std::left << std::setw(36) << name << std::fixed << std::setprecision(4) << mean << " ms" << std::endl;
+
+	results.push_back(std::move(result));
+}
+
+// Appends a box to the mesh, all of its vertices are bound to the bone if it's a valid bone index
+void AppendBox(MeshComponent& mesh, const XMFLOAT3& center, const XMFLOAT3& extents, int bone = -1)
+{
+	static const XMFLOAT3 normals[] = {
+		XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0),
+		XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0),
+		XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1),
+	};
+	for (auto& n : normals)
+	{
+		// Two tangent axes of the face:
+		XMFLOAT3 u = n.x != 0 ? XMFLOAT3(0, 1, 0) : XMFLOAT3(1, 0, 0);
+		XMFLOAT3 v;
+		XMStoreFloat3(&v, XMVector3Cross(XMLoadFloat3(&n), XMLoadFloat3(&u)));
+
+		uint32_t base = (uint32_t)mesh.vertex_positions.size();
+		static const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+		for (auto& c : corners)
+		{
+			XMFLOAT3 pos;
+			pos.x = center.x + (n.x + u.x * c[0] + v.x * c[1]) * extents.x;
+			pos.y = center.y + (n.y + u.y * c[0] + v.y * c[1]) * extents.y;
+			pos.z = center.z + (n.z + u.z * c[0] + v.z * c[1]) * extents.z;
+			mesh.vertex_positions.push_back(pos);
+			mesh.vertex_normals.push_back(n);
+			if (bone >= 0)
+			{
+				mesh.vertex_boneindices.push_back(XMUINT4((uint32_t)bone, 0, 0, 0));
+				mesh.vertex_boneweights.push_back(XMFLOAT4(1, 0, 0, 0));
+			}
+		}
+		mesh.indices.push_back(base + 0);
+		mesh.indices.push_back(base + 1);
+		mesh.indices.push_back(base + 2);
+		mesh.indices.push_back(base + 0);
+		mesh.indices.push_back(base + 2);
+		mesh.indices.push_back(base + 3);
+	}
+}
+
+void GenerateScene(Scene& scene, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> position(-100, 100);
+	std::uniform_real_distribution<float> size(0.25f, 2);
+	std::uniform_real_distribution<float> unorm(0, 1);
+
+	Entity material = scene.Entity_CreateMaterial("material");
+
+	// A few mesh variants that are instanced by the objects:
+	static const uint32_t mesh_variants = 16;
+	std::vector<Entity> meshes;
+	for (uint32_t i = 0; i < mesh_variants; ++i)
+	{
+		Entity entity = scene.Entity_CreateMesh("mesh" + std::to_string(i));
+		MeshComponent& mesh = *scene.meshes.GetComponent(entity);
+		AppendBox(mesh, XMFLOAT3(0, 0, 0), XMFLOAT3(size(rng), size(rng), size(rng)));
+		mesh.subsets.emplace_back();
+		mesh.subsets.back().materialID = material;
+		mesh.subsets.back().indexCount = (uint32_t)mesh.indices.size();
+		mesh.CreateRenderData();
+		meshes.push_back(entity);
+	}
+
+	// Objects, the ones that are not at the start of a chain are attached to the previous one:
+	Entity parent = INVALID_ENTITY;
+	for (uint32_t i = 0; i < settings.objects; ++i)
+	{
+		Entity entity = scene.Entity_CreateObject("object" + std::to_string(i));
+		ObjectComponent& object = *scene.objects.GetComponent(entity);
+		object.meshID = meshes[i % mesh_variants];
+
+		TransformComponent& transform = *scene.transforms.GetComponent(entity);
+		if (settings.depth > 1 && (i % settings.depth) != 0)
+		{
+			transform.Translate(XMFLOAT3(position(rng) * 0.02f, position(rng) * 0.02f, position(rng) * 0.02f));
+			transform.UpdateTransform();
+			scene.Component_Attach(entity, parent, true);
+		}
+		else
+		{
+			transform.Translate(XMFLOAT3(position(rng), position(rng), position(rng)));
+			transform.UpdateTransform();
+		}
+		parent = entity;
+	}
+
+	// Armatures with bone chains and skinned meshes, bones are laid out along the Y axis:
+	for (uint32_t i = 0; i < settings.armatures; ++i)
+	{
+		Entity armature_entity = CreateEntity();
+		scene.names.Create(armature_entity) = "armature" + std::to_string(i);
+		scene.layers.Create(armature_entity);
+		TransformComponent& armature_transform = scene.transforms.Create(armature_entity);
+		armature_transform.Translate(XMFLOAT3(position(rng), position(rng), position(rng)));
+		armature_transform.UpdateTransform();
+		scene.armatures.Create(armature_entity);
+
+		std::vector<Entity> bones;
+		Entity bone_parent = armature_entity;
+		for (uint32_t j = 0; j < settings.bones; ++j)
+		{
+			Entity bone = CreateEntity();
+			scene.names.Create(bone) = "bone" + std::to_string(j);
+			TransformComponent& bone_transform = scene.transforms.Create(bone);
+			bone_transform.Translate(XMFLOAT3(0, j == 0 ? 0.0f : 1.0f, 0));
+			bone_transform.UpdateTransform();
+			scene.Component_Attach(bone, bone_parent, true);
+			bones.push_back(bone);
+			bone_parent = bone;
+		}
+
+		ArmatureComponent& armature = *scene.armatures.GetComponent(armature_entity);
+		armature.boneCollection = bones;
+		armature.inverseBindMatrices.resize(bones.size());
+		for (uint32_t j = 0; j < settings.bones; ++j)
+		{
+			XMStoreFloat4x4(&armature.inverseBindMatrices[j], XMMatrixTranslation(0, -float(j), 0));
+		}
+
+		Entity mesh_entity = scene.Entity_CreateMesh("skinnedmesh" + std::to_string(i));
+		MeshComponent& mesh = *scene.meshes.GetComponent(mesh_entity);
+		mesh.armatureID = armature_entity;
+		for (uint32_t j = 0; j < settings.bones; ++j)
+		{
+			AppendBox(mesh, XMFLOAT3(0, float(j) + 0.5f, 0), XMFLOAT3(0.3f, 0.5f, 0.3f), (int)j);
+		}
+		mesh.subsets.emplace_back();
+		mesh.subsets.back().materialID = material;
+		mesh.subsets.back().indexCount = (uint32_t)mesh.indices.size();
+		mesh.CreateRenderData();
+
+		Entity object_entity = scene.Entity_CreateObject("skinnedobject" + std::to_string(i));
+		scene.objects.GetComponent(object_entity)->meshID = mesh_entity;
+		scene.Component_Attach(object_entity, armature_entity);
+	}
+
+	for (uint32_t i = 0; i < settings.lights; ++i)
+	{
+		scene.Entity_CreateLight(
+			"light" + std::to_string(i),
+			XMFLOAT3(position(rng), position(rng), position(rng)),
+			XMFLOAT3(unorm(rng), unorm(rng), unorm(rng)),
+			2,
+			10 + unorm(rng) * 20
+		);
+	}
+}
+
+// Stacks of boxes and spheres on a static ground, bodies are touching each other from the start
+void GeneratePhysicsScene(Scene& scene)
+{
+	Entity ground = CreateEntity();
+	TransformComponent& ground_transform = scene.transforms.Create(ground);
+	ground_transform.Translate(XMFLOAT3(0, -1, 0));
+	ground_transform.UpdateTransform();
+	RigidBodyPhysicsComponent& ground_rigidbody = scene.rigidbodies.Create(ground);
+	ground_rigidbody.shape = RigidBodyPhysicsComponent::CollisionShape::BOX;
+	ground_rigidbody.box.halfextents = XMFLOAT3(1000, 1, 1000);
+	ground_rigidbody.mass = 0;
+
+	static const uint32_t stack_height = 8;
+	const uint32_t stack_count = (settings.rigidbodies + stack_height - 1) / stack_height;
+	const uint32_t grid_size = std::max(1u, (uint32_t)std::ceil(std::sqrt((float)stack_count)));
+	for (uint32_t i = 0; i < settings.rigidbodies; ++i)
+	{
+		const uint32_t stack = i / stack_height;
+		const uint32_t level = i % stack_height;
+
+		Entity entity = CreateEntity();
+		TransformComponent& transform = scene.transforms.Create(entity);
+		transform.Translate(XMFLOAT3(
+			(float(stack % grid_size) - grid_size * 0.5f) * 3,
+			0.5f + level * 1.01f,
+			(float(stack / grid_size) - grid_size * 0.5f) * 3
+		));
+		transform.UpdateTransform();
+
+		RigidBodyPhysicsComponent& rigidbody = scene.rigidbodies.Create(entity);
+		if (i % 3 == 2)
+		{
+			rigidbody.shape = RigidBodyPhysicsComponent::CollisionShape::SPHERE;
+			rigidbody.sphere.radius = 0.5f;
+		}
+		else
+		{
+			rigidbody.shape = RigidBodyPhysicsComponent::CollisionShape::BOX;
+			rigidbody.box.halfextents = XMFLOAT3(0.5f, 0.5f, 0.5f);
+		}
+	}
+}
+
+// Crowd of characters with spring chains for hair and two legs that are placed by IK
+void GenerateCharacterScene(Scene& scene)
+{
+	auto create_transform = [&](Entity parent, const XMFLOAT3& translation) {
+		Entity entity = CreateEntity();
+		TransformComponent& transform = scene.transforms.Create(entity);
+		transform.Translate(translation);
+		transform.UpdateTransform();
+		if (parent != INVALID_ENTITY)
+		{
+			scene.Component_Attach(entity, parent, true);
+		}
+		return entity;
+	};
+
+	const uint32_t grid_size = std::max(1u, (uint32_t)std::ceil(std::sqrt((float)settings.characters)));
+	for (uint32_t i = 0; i < settings.characters; ++i)
+	{
+		const XMFLOAT3 position = XMFLOAT3(float(i % grid_size) * 2, 0, float(i / grid_size) * 2);
+		Entity root = create_transform(INVALID_ENTITY, position);
+		Entity pelvis = create_transform(root, XMFLOAT3(0, 1, 0));
+		Entity spine = create_transform(pelvis, XMFLOAT3(0, 0.5f, 0));
+		Entity head = create_transform(spine, XMFLOAT3(0, 0.5f, 0));
+
+		for (uint32_t strand = 0; strand < 4; ++strand)
+		{
+			Entity parent = head;
+			for (uint32_t j = 0; j < 4; ++j)
+			{
+				parent = create_transform(parent, j == 0 ? XMFLOAT3(strand * 0.05f - 0.1f, 0.1f, -0.1f) : XMFLOAT3(0, -0.1f, -0.05f));
+				scene.springs.Create(parent).SetGravityEnabled(true);
+			}
+		}
+
+		for (uint32_t leg = 0; leg < 2; ++leg)
+		{
+			const float side = leg == 0 ? -0.2f : 0.2f;
+			Entity thigh = create_transform(pelvis, XMFLOAT3(side, 0, 0));
+			Entity shin = create_transform(thigh, XMFLOAT3(0, -0.5f, 0.05f));
+			Entity foot = create_transform(shin, XMFLOAT3(0, -0.5f, -0.05f));
+			create_transform(foot, XMFLOAT3(0, 0, 0.1f)); // toe
+
+			InverseKinematicsComponent& ik = scene.inverse_kinematics.Create(foot);
+			ik.target = create_transform(INVALID_ENTITY, XMFLOAT3(position.x + side, 0.2f, position.z + 0.3f));
+			ik.chain_length = 2;
+			ik.iteration_count = 2;
+		}
+	}
+}
+
+// Moves the roots of the object hierarchies and the bones, so that Scene::Update has to recompute everything each iteration
+void AnimateScene(Scene& scene, float angle)
+{
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(0, angle, angle * 0.5f));
+	for (size_t i = 0; i < scene.transforms.GetCount(); ++i)
+	{
+		Entity entity = scene.transforms.GetEntity(i);
+		if (scene.hierarchy.Contains(entity) && !scene.armatures.Contains(scene.hierarchy.GetComponent(entity)->parentID))
+		{
+			continue; // only the roots and the first bones are rotated, the rest follows them in the hierarchy
+		}
+		TransformComponent& transform = scene.transforms[i];
+		transform.rotation_local = rotation;
+		transform.SetDirty();
+	}
+}
+
+void WriteResults()
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(6);
+	ss << "{" << std::endl;
+	ss << "\t\"engine_version\": \"" << wiVersion::GetVersionString() << "\"," << std::endl;
+	ss << "\t\"thread_count\": " << wiJobSystem::GetThreadCount() << "," << std::endl;
+	ss << "\t\"settings\": {" << std::endl;
+	ss << "\t\t\"objects\": " << settings.objects << "," << std::endl;
+	ss << "\t\t\"depth\": " << settings.depth << "," << std::endl;
+	ss << "\t\t\"armatures\": " << settings.armatures << "," << std::endl;
+	ss << "\t\t\"bones\": " << settings.bones << "," << std::endl;
+	ss << "\t\t\"lights\": " << settings.lights << "," << std::endl;
+	ss << "\t\t\"rigidbodies\": " << settings.rigidbodies << "," << std::endl;
+	ss << "\t\t\"characters\": " << settings.characters << "," << std::endl;
+	ss << "\t\t\"iterations\": " << settings.iterations << "," << std::endl;
+	ss << "\t\t\"warmup\": " << settings.warmup << "," << std::endl;
+	ss << "\t\t\"rays\": " << settings.rays << "," << std::endl;
+	ss << "\t\t\"seed\": " << settings.seed << std::endl;
+	ss << "\t}," << std::endl;
+	ss << "\t\"results\": [" << std::endl;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		std::vector<double> samples = results[i].samples;
+		std::sort(samples.begin(), samples.end());
+		double mean = 0;
+		for (double x : samples)
+		{
+			mean += x;
+		}
+		mean /= std::max(size_t(1), samples.size());
+		double variance = 0;
+		for (double x : samples)
+		{
+			variance += (x - mean) * (x - mean);
+		}
+		variance /= std::max(size_t(1), samples.size());
+		double median = samples.empty() ? 0 : samples[samples.size() / 2];
+		double p95 = samples.empty() ? 0 : samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+
+		ss << "\t\t{" << std::endl;
+		ss << "\t\t\t\"name\": \"" << results[i].name << "\"," << std::endl;
+		ss << "\t\t\t\"iterations\": " << samples.size() << "," << std::endl;
+		ss << "\t\t\t\"mean_ms\": " << mean << "," << std::endl;
+		ss << "\t\t\t\"median_ms\": " << median << "," << std::endl;
+		ss << "\t\t\t\"min_ms\": " << (samples.empty() ? 0 : samples.front()) << "," << std::endl;
+		ss << "\t\t\t\"max_ms\": " << (samples.empty() ? 0 : samples.back()) << "," << std::endl;
+		ss << "\t\t\t\"p95_ms\": " << p95 << "," << std::endl;
+		ss << "\t\t\t\"stddev_ms\": " << std::sqrt(variance) << std::endl;
+		ss << "\t\t}" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	ss << "\t]" << std::endl;
+	ss << "}" << std::endl;
+
+	std::string json = ss.str();
+	if (wiHelper::FileWrite(settings.output, (const uint8_t*)json.c_str(), json.length()))
+	{
+		std::cout << "[Wicked Engine Benchmark] Results written to " << settings.output << std::endl;
+	}
+	else
+	{
+		std::cerr << "[Wicked Engine Benchmark] Results couldn't be written to " << settings.output << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "[Wicked Engine Benchmark]" << std::endl;
+	std::cout << "Available command arguments (key=value):" << std::endl;
+	std::cout << "\tobjects : \tObject count (default: " << settings.objects << ")" << std::endl;
+	std::cout << "\tdepth : \tLength of the object hierarchy chains (default: " << settings.depth << ")" << std::endl;
+	std::cout << "\tarmatures : \tArmature count (default: " << settings.armatures << ")" << std::endl;
+	std::cout << "\tbones : \tBone count of each armature (default: " << settings.bones << ")" << std::endl;
+	std::cout << "\tlights : \tLight count (default: " << settings.lights << ")" << std::endl;
+	std::cout << "\trigidbodies : \tRigid body count of the physics benchmark (default: " << settings.rigidbodies << ")" << std::endl;
+	std::cout << "\tcharacters : \tCharacter count of the spring and IK benchmark (default: " << settings.characters << ")" << std::endl;
+	std::cout << "\titerations : \tMeasured iterations of each benchmark (default: " << settings.iterations << ")" << std::endl;
+	std::cout << "\twarmup : \tIterations before measuring (default: " << settings.warmup << ")" << std::endl;
+	std::cout << "\trays : \tRays traced in one iteration of the pick benchmark (default: " << settings.rays << ")" << std::endl;
+	std::cout << "\tseed : \tSeed of the scene generator (default: " << settings.seed << ")" << std::endl;
+	std::cout << "\toutput : \tJSON result file (default: " << settings.output << ")" << std::endl;
+	std::cout << "Command arguments used: ";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		size_t separator = arg.find('=');
+		if (separator == std::string::npos)
+		{
+			continue;
+		}
+		std::string key = arg.substr(0, separator);
+		std::string value = arg.substr(separator + 1);
+		if (key == "output")
+		{
+			settings.output = value;
+		}
+		else
+		{
+			uint32_t number = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+			if (key == "objects") settings.objects = number;
+			else if (key == "depth") settings.depth = std::max(1u, number);
+			else if (key == "armatures") settings.armatures = number;
+			else if (key == "bones") settings.bones = std::max(1u, number);
+			else if (key == "lights") settings.lights = number;
+			else if (key == "rigidbodies") settings.rigidbodies = number;
+			else if (key == "characters") settings.characters = number;
+			else if (key == "iterations") settings.iterations = std::max(1u, number);
+			else if (key == "warmup") settings.warmup = number;
+			else if (key == "rays") settings.rays = std::max(1u, number);
+			else if (key == "seed") settings.seed = number;
+			else continue;
+		}
+		std::cout << arg << " ";
+	}
+	std::cout << std::endl;
+
+	wiRenderer::SetDevice(std::make_shared<wiGraphics::GraphicsDevice_Null>());
+	wiJobSystem::Initialize();
+	wiResourceManager::Initialize();
+	wiRenderer::Initialize();
+	wiTextureHelper::Initialize();
+	wiPhysicsEngine::Initialize();
+
+	std::mt19937 rng(settings.seed);
+
+	wiTimer timer;
+	Scene scene;
+	GenerateScene(scene, rng);
+	std::cout << "[Wicked Engine Benchmark] Scene generated in " << std::setprecision(4) << timer.elapsed_seconds() << " seconds (entities: " << scene.names.GetCount() << ")" << std::endl;
+
+	CameraComponent camera;
+	camera.CreatePerspective(1920, 1080, 0.1f, 1000);
+	camera.Eye = XMFLOAT3(0, 0, -150);
+	camera.At = XMFLOAT3(0, 0, 1);
+	camera.UpdateCamera();
+
+	const float dt = 1.0f / 60.0f;
+	float angle = 0;
+	scene.Update(dt);
+
+	std::cout << "[Wicked Engine Benchmark] Running benchmarks with " << wiJobSystem::GetThreadCount() << " threads:" << std::endl;
+
+	Run("Scene::Update", [&] {
+		scene.Update(dt);
+	}, [&] {
+		angle += 0.01f;
+		AnimateScene(scene, angle);
+	});
+
+	Run("wiRenderer::UpdateVisibility", [&] {
+		wiRenderer::Visibility vis;
+		vis.scene = &scene;
+		vis.camera = &camera;
+		vis.flags = wiRenderer::Visibility::ALLOW_EVERYTHING;
+		wiRenderer::UpdateVisibility(vis);
+	});
+
+	// Springs and IK are updated by Scene::Update, the character roots are moved every iteration:
+	{
+		Scene character_scene;
+		GenerateCharacterScene(character_scene);
+		character_scene.Update(dt);
+		Run("Scene::Update (springs and IK)", [&] {
+			character_scene.Update(dt);
+		}, [&] {
+			angle += 0.01f;
+			AnimateScene(character_scene, angle);
+		});
+	}
+
+	// Rays are generated up front, so that the same rays are traced in each iteration:
+	std::vector<RAY> rays;
+	{
+		std::uniform_real_distribution<float> position(-100, 100);
+		for (uint32_t i = 0; i < settings.rays; ++i)
+		{
+			XMVECTOR origin = XMVectorSet(position(rng), 150, position(rng), 0);
+			XMVECTOR target = XMVectorSet(position(rng), -100, position(rng), 0);
+			rays.emplace_back(origin, XMVector3Normalize(target - origin));
+		}
+	}
+	Run("wiScene::Pick", [&] {
+		for (auto& ray : rays)
+		{
+			Pick(ray, RENDERTYPE_ALL, ~0, scene);
+		}
+	});
+	Run("wiScene::Pick (batched)", [&] {
+		std::vector<PickResult> results(rays.size());
+		Pick(rays.data(), (uint32_t)rays.size(), results.data(), RENDERTYPE_ALL, ~0, scene);
+	});
+	Run("wiScene::SceneIntersectSphere", [&] {
+		for (auto& ray : rays)
+		{
+			SceneIntersectSphere(SPHERE(ray.origin, 2), RENDERTYPE_ALL, ~0, scene);
+		}
+	});
+
+	for (int chunked = 0; chunked < 2; ++chunked)
+	{
+		wiArchive archive;
+		Run(chunked ? "Scene::Serialize (write, chunked)" : "Scene::Serialize (write)", [&] {
+			scene.Serialize(archive, chunked != 0);
+		}, [&] {
+			archive = wiArchive();
+		});
+
+		Scene loaded;
+		Run(chunked ? "Scene::Serialize (load, chunked)" : "Scene::Serialize (load)", [&] {
+			loaded.Serialize(archive);
+		}, [&] {
+			loaded.Clear();
+			archive.SetReadModeAndResetPos(true);
+		});
+	}
+
+	// Many small jobs, this measures the scheduling overhead:
+	Run("wiJobSystem::Execute", [&] {
+		wiJobSystem::context ctx;
+		for (uint32_t i = 0; i < 1000; ++i)
+		{
+			wiJobSystem::Execute(ctx, [](wiJobArgs args) {});
+		}
+		wiJobSystem::Wait(ctx);
+	});
+
+	// Wide data parallel workload:
+	std::vector<XMFLOAT4X4> matrices(1000000);
+	Run("wiJobSystem::Dispatch", [&] {
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, (uint32_t)matrices.size(), 1024, [&](wiJobArgs args) {
+			XMMATRIX M = XMMatrixRotationY(float(args.jobIndex));
+			XMStoreFloat4x4(&matrices[args.jobIndex], M);
+		});
+		wiJobSystem::Wait(ctx);
+	});
+
+	// The same physics scene is simulated singlethreaded and multithreaded, for the scaling of the physics engine:
+	for (int multithreaded = 0; multithreaded < 2; ++multithreaded)
+	{
+		wiPhysicsEngine::SetMultithreadingEnabled(multithreaded != 0);
+
+		Scene physics_scene;
+		GeneratePhysicsScene(physics_scene);
+		Run(multithreaded ? "wiPhysicsEngine (multithreaded)" : "wiPhysicsEngine (singlethreaded)", [&] {
+			wiJobSystem::context ctx;
+			wiPhysicsEngine::RunPhysicsUpdateSystem(ctx, physics_scene, dt);
+			wiJobSystem::Wait(ctx);
+		});
+
+		// The bodies of a cleared scene are removed from the physics world in the next update:
+		physics_scene.Clear();
+		wiJobSystem::context ctx;
+		wiPhysicsEngine::RunPhysicsUpdateSystem(ctx, physics_scene, dt);
+		wiJobSystem::Wait(ctx);
+	}
+	wiPhysicsEngine::SetMultithreadingEnabled(false);
+
+	WriteResults();
+
+	return 0;
+}
@@ -0,0 +1,156 @@
+#include "WickedEngine.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <filesystem>
+#include <mutex>
+#include <atomic>
+
+std::mutex locker;
+std::vector<std::string> sources;
+wiTextureCooker::FORMAT format = wiTextureCooker::FORMAT_AUTO;
+bool rebuild = false;
+std::atomic<uint32_t> cooked_count{ 0 };
+std::atomic<uint32_t> skipped_count{ 0 };
+std::atomic<uint32_t> failed_count{ 0 };
+
+bool IsSourceImage(const std::filesystem::path& path)
+{
+	std::string ext = wiHelper::toUpper(wiHelper::GetExtensionFromFileName(path.string()));
+	return ext == "PNG" || ext == "JPG" || ext == "JPEG" || ext == "TGA" || ext == "BMP";
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "[Wicked Engine Offline Texture Cooker]" << std::endl;
+	std::cout << "Available command arguments:" << std::endl;
+	std::cout << "\tbc1 : \tCook all textures to BC1 format (RGB)" << std::endl;
+	std::cout << "\tbc3 : \tCook all textures to BC3 format (RGBA)" << std::endl;
+	std::cout << "\tbc5 : \tCook all textures to BC5 format (RG)" << std::endl;
+	std::cout << "\tbc7 : \tCook all textures to BC7 format (RGBA, higher quality, slower)" << std::endl;
+	std::cout << "\trebuild : \tAll textures will be cooked, even if they were already cooked" << std::endl;
+	std::cout << "\tAny other argument is a directory (searched recursively) or an image file to cook" << std::endl;
+	std::cout << "Command arguments used: ";
+
+	wiStartupArguments::Parse(argc, argv);
+
+	if (wiStartupArguments::HasArgument("bc1"))
+	{
+		format = wiTextureCooker::FORMAT_BC1;
+		std::cout << "bc1 ";
+	}
+	if (wiStartupArguments::HasArgument("bc3"))
+	{
+		format = wiTextureCooker::FORMAT_BC3;
+		std::cout << "bc3 ";
+	}
+	if (wiStartupArguments::HasArgument("bc5"))
+	{
+		format = wiTextureCooker::FORMAT_BC5;
+		std::cout << "bc5 ";
+	}
+	if (wiStartupArguments::HasArgument("bc7"))
+	{
+		format = wiTextureCooker::FORMAT_BC7;
+		std::cout << "bc7 ";
+	}
+	if (wiStartupArguments::HasArgument("rebuild"))
+	{
+		rebuild = true;
+		std::cout << "rebuild ";
+	}
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "bc1" || arg == "bc3" || arg == "bc5" || arg == "bc7" || arg == "rebuild")
+		{
+			continue;
+		}
+		std::cout << arg << " ";
+
+		std::error_code ec;
+		if (std::filesystem::is_directory(arg, ec))
+		{
+			for (auto& entry : std::filesystem::recursive_directory_iterator(arg, ec))
+			{
+				if (entry.is_regular_file() && IsSourceImage(entry.path()))
+				{
+					sources.push_back(entry.path().string());
+				}
+			}
+		}
+		else if (std::filesystem::is_regular_file(arg, ec) && IsSourceImage(arg))
+		{
+			sources.push_back(arg);
+		}
+	}
+
+	std::cout << std::endl;
+
+	if (format == wiTextureCooker::FORMAT_AUTO)
+	{
+		std::cout << "No texture format was specified, opaque images will be cooked to BC1, images with alpha to BC3" << std::endl;
+	}
+
+	if (sources.empty())
+	{
+		std::cout << "No source images were specified" << std::endl;
+		return 0;
+	}
+
+	wiJobSystem::Initialize();
+	wiJobSystem::context ctx;
+
+	std::string COOKEDPATH = wiResourceManager::GetCookedTexturePath();
+	wiHelper::DirectoryCreate(COOKEDPATH);
+
+	std::cout << "[Wicked Engine Offline Texture Cooker] Cooking " << sources.size() << " images to " << COOKEDPATH << std::endl;
+	wiTimer timer;
+
+	for (auto& source : sources)
+	{
+		wiJobSystem::Execute(ctx, [=](wiJobArgs args) {
+			std::vector<uint8_t> filedata;
+			if (!wiHelper::FileRead(source, filedata))
+			{
+				locker.lock();
+				std::cerr << "texture read FAILED: " << source << std::endl;
+				locker.unlock();
+				failed_count.fetch_add(1);
+				return;
+			}
+
+			std::string cookedfilename = COOKEDPATH + wiTextureCooker::GetCookedFileName(filedata.data(), filedata.size());
+			if (!rebuild && wiHelper::FileExists(cookedfilename))
+			{
+				skipped_count.fetch_add(1);
+				return;
+			}
+
+			std::vector<uint8_t> dds;
+			if (wiTextureCooker::Cook(filedata.data(), filedata.size(), dds, format))
+			{
+				wiHelper::FileWrite(cookedfilename, dds.data(), dds.size());
+
+				locker.lock();
+				std::cout << "texture cooked: " << source << " -> " << cookedfilename << std::endl;
+				locker.unlock();
+				cooked_count.fetch_add(1);
+			}
+			else
+			{
+				locker.lock();
+				std::cerr << "texture cook FAILED (the image can't be decoded, or its dimensions are not multiples of 4): " << source << std::endl;
+				locker.unlock();
+				failed_count.fetch_add(1);
+			}
+		});
+	}
+	wiJobSystem::Wait(ctx);
+
+	std::cout << "[Wicked Engine Offline Texture Cooker] Finished in " << std::setprecision(4) << timer.elapsed_seconds() << " seconds (cooked: " << cooked_count.load() << ", up to date: " << skipped_count.load() << ", failed: " << failed_count.load() << ")" << std::endl;
+
+	return 0;
+}
@@ -1,27 +1,61 @@
 #include "wiArchive.h"
 #include "wiHelper.h"
+#include "wiPlatform.h"
+#include "wiJobSystem.h"
 
 #include <fstream>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include "Utility/zstd/zstd.h"
+
+#ifdef PLATFORM_LINUX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // PLATFORM_LINUX
 
 // this should always be only INCREMENTED and only if a new serialization is implemeted somewhere!
-uint64_t __archiveVersion = 72;
+uint64_t __archiveVersion = 75;
 // this is the version number of which below the archive is not compatible with the current version
 uint64_t __archiveVersionBarrier = 22;
 
 // version history is logged in ArchiveVersionHistory.txt file!
 
+namespace wiArchive_Internal
+{
+	// Compressed files start with this instead of the version number, so older programs will refuse them as too new
+	//	Layout: [magic][uncompressed size: uint64][block count: uint32][compressed block sizes: uint32 * block count][blocks]
+	//	Every block is a Zstandard frame, except blocks that don't compress, those are stored without compression (their compressed size equals their uncompressed size)
+	static constexpr uint64_t COMPRESSED_MAGIC = 0x54535A4352414957ull; // "WIARCZST"
+	static constexpr size_t COMPRESSION_BLOCK_SIZE = 256 * 1024; // every block is compressed independently, in parallel
+	static constexpr size_t COMPRESSED_HEADER_SIZE = sizeof(uint64_t) * 2 + sizeof(uint32_t);
+	static constexpr int COMPRESSION_LEVEL = -1; // fast level, which decompresses about as fast as LZ4 and still compresses better
+}
+using namespace wiArchive_Internal;
+
 wiArchive::wiArchive()
 {
 	CreateEmpty();
 }
-wiArchive::wiArchive(const std::string& fileName, bool readMode) : fileName(fileName), readMode(readMode)
+wiArchive::wiArchive(const std::string& fileName, bool readMode, bool memoryMapped) : fileName(fileName), readMode(readMode)
 {
 	if (!fileName.empty())
 	{
 		directory = wiHelper::GetDirectoryFromPath(fileName);
 		if (readMode)
 		{
-			if (wiHelper::FileRead(fileName, DATA))
+			if ((memoryMapped && MapFile(fileName)) || wiHelper::FileRead(fileName, DATA))
+			{
+				if (Decompress(GetData(), read_data != nullptr ? read_size : DATA.size()))
+				{
+					compressionEnabled = true;
+				}
+			}
+			if (IsOpen())
 			{
 				(*this) >> version;
 				if (version < __archiveVersionBarrier)
@@ -55,6 +89,58 @@ void wiArchive::CreateEmpty()
 	(*this) << version;
 }
 
+bool wiArchive::MapFile(const std::string& fileName)
+{
+#ifdef PLATFORM_LINUX
+	std::string filepath = fileName;
+	std::replace(filepath.begin(), filepath.end(), '\\', '/');
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+	const size_t size = (size_t)st.st_size;
+	void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file referenced
+	if (ptr == MAP_FAILED)
+	{
+		return false;
+	}
+	madvise(ptr, size, MADV_SEQUENTIAL);
+
+	memoryMapped = true;
+	read_size = size;
+	read_data = std::shared_ptr<const uint8_t>((const uint8_t*)ptr, [size](const uint8_t* ptr) {
+		munmap((void*)ptr, size);
+	});
+	DATA.clear();
+	return true;
+#else
+	return false;
+#endif // PLATFORM_LINUX
+}
+
+void wiArchive::ReleaseMappedRange(size_t offset, size_t size)
+{
+#ifdef PLATFORM_LINUX
+	// Only whole pages inside the range can be released, the mapping stays valid and they are read again from the file if accessed:
+	static const uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+	const uintptr_t address = (uintptr_t)GetData() + offset;
+	const uintptr_t begin = (address + page_size - 1) / page_size * page_size;
+	const uintptr_t end = (address + size) / page_size * page_size;
+	if (end > begin)
+	{
+		madvise((void*)begin, end - begin, MADV_DONTNEED);
+	}
+#endif // PLATFORM_LINUX
+}
+
 void wiArchive::SetReadModeAndResetPos(bool isReadMode)
 {
 	readMode = isReadMode; 
@@ -66,6 +152,10 @@ void wiArchive::SetReadModeAndResetPos(bool isReadMode)
 	}
 	else
 	{
+		// The read-only data can't be written, writing always goes to DATA:
+		read_data.reset();
+		read_size = 0;
+		memoryMapped = false;
 		(*this) << version;
 	}
 }
@@ -73,7 +163,7 @@ void wiArchive::SetReadModeAndResetPos(bool isReadMode)
 bool wiArchive::IsOpen()
 {
 	// when it is open, DATA is not null because it contains the version number at least!
-	return !DATA.empty();
+	return !DATA.empty() || read_data != nullptr;
 }
 
 void wiArchive::Close()
@@ -83,11 +173,205 @@ void wiArchive::Close()
 		SaveFile(fileName);
 	}
 	DATA.clear();
+	read_data.reset();
+	read_size = 0;
+	memoryMapped = false;
+}
+
+wiArchive wiArchive::CreateSection() const
+{
+	// The section is not linked to the file, but it uses the same directory for relative paths:
+	wiArchive section;
+	section.directory = directory;
+	return section;
+}
+
+wiArchive wiArchive::OpenSection(size_t size)
+{
+	assert(readMode);
+
+	wiArchive section;
+	section.DATA.clear();
+	section.readMode = true;
+	section.pos = 0;
+	section.fileName = fileName;
+	section.directory = directory;
+	section.memoryMapped = memoryMapped;
+	// Aliasing the current position, the section shares ownership of a file mapping, but doesn't own the DATA of this archive:
+	section.read_data = std::shared_ptr<const uint8_t>(read_data, GetData() + pos);
+	section.read_size = size;
+	section >> section.version;
+
+	pos += size;
+	return section;
 }
 
 bool wiArchive::SaveFile(const std::string& fileName)
 {
-	return wiHelper::FileWrite(fileName, DATA.data(), pos);
+	if (!compressionEnabled)
+	{
+		return wiHelper::FileWrite(fileName, GetData(), pos);
+	}
+
+	const size_t size = pos;
+	const uint8_t* data = GetData();
+	const uint32_t block_count = uint32_t((size + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE);
+
+	// Blocks are compressed in parallel into separate buffers:
+	std::vector<std::vector<uint8_t>> blocks(block_count);
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, block_count, 1, [&](wiJobArgs args) {
+		const size_t offset = size_t(args.jobIndex) * COMPRESSION_BLOCK_SIZE;
+		const size_t block_size = std::min(COMPRESSION_BLOCK_SIZE, size - offset);
+		std::vector<uint8_t>& block = blocks[args.jobIndex];
+		block.resize(ZSTD_compressBound(block_size));
+		const size_t compressed_size = ZSTD_compress(block.data(), block.size(), data + offset, block_size, COMPRESSION_LEVEL);
+		if (!ZSTD_isError(compressed_size) && compressed_size < block_size)
+		{
+			block.resize(compressed_size);
+		}
+		else
+		{
+			block.assign(data + offset, data + offset + block_size);
+		}
+	});
+	wiJobSystem::Wait(ctx);
+
+	size_t compressed_size = COMPRESSED_HEADER_SIZE + sizeof(uint32_t) * block_count;
+	for (auto& block : blocks)
+	{
+		compressed_size += block.size();
+	}
+	std::vector<uint8_t> compressed(compressed_size);
+	uint8_t* dst = compressed.data();
+	auto write = [&](const void* src, size_t src_size) {
+		std::memcpy(dst, src, src_size);
+		dst += src_size;
+	};
+	const uint64_t magic = COMPRESSED_MAGIC;
+	const uint64_t uncompressed_size = size;
+	write(&magic, sizeof(magic));
+	write(&uncompressed_size, sizeof(uncompressed_size));
+	write(&block_count, sizeof(block_count));
+	for (auto& block : blocks)
+	{
+		const uint32_t block_size = (uint32_t)block.size();
+		write(&block_size, sizeof(block_size));
+	}
+	for (auto& block : blocks)
+	{
+		write(block.data(), block.size());
+	}
+
+	return wiHelper::FileWrite(fileName, compressed.data(), compressed.size());
+}
+
+bool wiArchive::Decompress(const uint8_t* data, size_t size)
+{
+	uint64_t magic = 0;
+	if (size < COMPRESSED_HEADER_SIZE || (std::memcpy(&magic, data, sizeof(magic)), magic != COMPRESSED_MAGIC))
+	{
+		return false;
+	}
+	uint64_t uncompressed_size;
+	uint32_t block_count;
+	std::memcpy(&uncompressed_size, data + sizeof(uint64_t), sizeof(uncompressed_size));
+	std::memcpy(&block_count, data + sizeof(uint64_t) * 2, sizeof(block_count));
+
+	// The header is validated against the file before anything is allocated:
+	//	the block count must match the uncompressed size, the block size table must be in the file,
+	//	and the blocks must exactly fill the rest of the file, with every frame declaring the size of its block
+	const uint8_t* block_sizes = data + COMPRESSED_HEADER_SIZE;
+	const size_t table_end = COMPRESSED_HEADER_SIZE + sizeof(uint32_t) * size_t(block_count);
+	bool valid =
+		uncompressed_size >= sizeof(version) &&
+		uncompressed_size <= uint64_t(block_count) * COMPRESSION_BLOCK_SIZE &&
+		uncompressed_size <= uint64_t(std::numeric_limits<size_t>::max()) &&
+		uint64_t(block_count) == (uncompressed_size + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE &&
+		table_end <= size;
+	std::vector<size_t> block_offsets;
+	size_t offset = table_end;
+	if (valid)
+	{
+		block_offsets.resize(block_count);
+	}
+	for (uint32_t i = 0; i < block_count && valid; ++i)
+	{
+		uint32_t src_size;
+		std::memcpy(&src_size, block_sizes + sizeof(uint32_t) * i, sizeof(src_size));
+		const size_t block_size = std::min(COMPRESSION_BLOCK_SIZE, size_t(uncompressed_size) - size_t(i) * COMPRESSION_BLOCK_SIZE);
+		valid = src_size > 0 && src_size <= block_size && src_size <= size - offset;
+		if (valid && src_size < block_size)
+		{
+			valid = ZSTD_getFrameContentSize(data + offset, src_size) == block_size;
+		}
+		block_offsets[i] = offset;
+		offset += src_size;
+	}
+	valid = valid && offset == size;
+	if (!valid)
+	{
+		wiHelper::messageBox("The compressed archive is corrupt!", "Error!");
+		DATA.clear();
+		read_data.reset();
+		read_size = 0;
+		memoryMapped = false;
+		return true;
+	}
+	block_offsets.push_back(offset);
+
+	// The decompressed data is not zero initialized like DATA would be, because every byte of it will be written:
+	const size_t decompressed_size = (size_t)uncompressed_size;
+	std::shared_ptr<uint8_t> decompressed;
+#if defined(PLATFORM_LINUX) && defined(MADV_HUGEPAGE)
+	// Transparent huge pages are requested, because otherwise the page faults of the first writes take a large part of the decompression time:
+	void* ptr = mmap(nullptr, decompressed_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr != MAP_FAILED)
+	{
+		madvise(ptr, decompressed_size, MADV_HUGEPAGE);
+		decompressed = std::shared_ptr<uint8_t>((uint8_t*)ptr, [decompressed_size](uint8_t* ptr) {
+			munmap(ptr, decompressed_size);
+		});
+	}
+#endif // PLATFORM_LINUX && MADV_HUGEPAGE
+	if (decompressed == nullptr)
+	{
+		decompressed = std::shared_ptr<uint8_t>(new uint8_t[decompressed_size], std::default_delete<uint8_t[]>());
+	}
+	std::atomic<bool> success{ true };
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, block_count, 1, [&](wiJobArgs args) {
+		const size_t dst_offset = size_t(args.jobIndex) * COMPRESSION_BLOCK_SIZE;
+		const size_t block_size = std::min(COMPRESSION_BLOCK_SIZE, decompressed_size - dst_offset);
+		const uint8_t* src = data + block_offsets[args.jobIndex];
+		const size_t src_size = block_offsets[args.jobIndex + 1] - block_offsets[args.jobIndex];
+		if (src_size == block_size)
+		{
+			std::memcpy(decompressed.get() + dst_offset, src, block_size);
+		}
+		else if (ZSTD_decompress(decompressed.get() + dst_offset, block_size, src, src_size) != block_size)
+		{
+			success.store(false);
+		}
+	});
+	wiJobSystem::Wait(ctx);
+
+	// The file data is not needed after decompression, the archive will be read from the decompressed data:
+	DATA.clear();
+	DATA.shrink_to_fit();
+	read_data.reset();
+	read_size = 0;
+	memoryMapped = false;
+	if (success.load())
+	{
+		read_data = std::move(decompressed);
+		read_size = decompressed_size;
+	}
+	else
+	{
+		wiHelper::messageBox("The compressed archive is corrupt!", "Error!");
+	}
+	return true;
 }
 
 const std::string& wiArchive::GetSourceDirectory() const
@@ -4,6 +4,8 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <type_traits>
 
 class wiArchive
 {
@@ -13,10 +15,21 @@ private:
 	size_t pos = 0;
 	std::vector<uint8_t> DATA;
 
+	// Read-only data that is not owned by DATA (file mapping, decompressed file, or section of an other archive), when it's valid, reading is done from this:
+	std::shared_ptr<const uint8_t> read_data;
+	size_t read_size = 0;
+	bool memoryMapped = false;
+	bool compressionEnabled = false;
+
 	std::string fileName; // save to this file on closing if not empty
 	std::string directory;
 
 	void CreateEmpty();
+	bool MapFile(const std::string& fileName);
+	// Decompresses the data of a compressed file into read_data, returns false if the data is not compressed
+	bool Decompress(const uint8_t* data, size_t size);
+	// Returns the pages of an already read range of the file mapping to the OS
+	void ReleaseMappedRange(size_t offset, size_t size);
 
 public:
 	// Create empty arhive for writing
@@ -24,16 +37,23 @@ public:
 	wiArchive(const wiArchive&) = default;
 	wiArchive(wiArchive&&) = default;
 	// Create archive and link to file
-	wiArchive(const std::string& fileName, bool readMode = true);
+	//	memoryMapped : in read mode, the file is memory mapped instead of read into memory when the platform supports it
+	wiArchive(const std::string& fileName, bool readMode = true, bool memoryMapped = true);
 	~wiArchive() { Close(); }
 
 	wiArchive& operator=(const wiArchive&) = default;
 	wiArchive& operator=(wiArchive&&) = default;
 
-	const uint8_t* GetData() const { return DATA.data(); }
+	const uint8_t* GetData() const { return read_data != nullptr ? read_data.get() : DATA.data(); }
 	size_t GetSize() const { return pos; }
 	uint64_t GetVersion() const { return version; }
 	bool IsReadMode() const { return readMode; }
+	bool IsMemoryMapped() const { return memoryMapped; }
+	// Compress the data with block compression (Zstandard) when saving to a file. Compressed files are detected and decompressed when opened for reading
+	//	The file will be smaller, but decompression makes loading slower unless reading the file is the bottleneck (slow storage, network)
+	//	The Editor enables it with the "Compress" save option, it is disabled by default
+	void SetCompressionEnabled(bool value) { compressionEnabled = value; }
+	bool IsCompressionEnabled() const { return compressionEnabled; }
 	void SetReadModeAndResetPos(bool isReadMode);
 	bool IsOpen();
 	void Close();
@@ -165,6 +185,27 @@ public:
 		return *this;
 	}
 
+	// Write a vector of trivially copyable elements as a single memory block, without converting the elements
+	//	This is much faster for large arrays than operator<<, and 32-bit integers are not widened to 64-bit
+	//	The element type must have the same layout on every platform (use fixed size types only)
+	//	Archives older than BLOCK_VERSION use the element by element format of operator<<
+	template<typename T>
+	inline wiArchive& WriteBlock(const std::vector<T>& data)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "WriteBlock() requires trivially copyable element type!");
+		if (version < BLOCK_VERSION)
+		{
+			return (*this) << data;
+		}
+		const uint64_t count = (uint64_t)data.size();
+		_write(count);
+		if (count > 0)
+		{
+			_write(*data.data(), count);
+		}
+		return *this;
+	}
+
 	// Read operations
 	inline wiArchive& operator >> (bool& data)
 	{
@@ -308,6 +349,50 @@ public:
 		}
 		return *this;
 	}
+	// Read a vector that was written with WriteBlock()
+	//	From a memory mapped archive, the data is copied directly from the mapping and the read pages are released
+	template<typename T>
+	inline wiArchive& ReadBlock(std::vector<T>& data)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "ReadBlock() requires trivially copyable element type!");
+		if (version < BLOCK_VERSION)
+		{
+			return (*this) >> data;
+		}
+		uint64_t count;
+		_read(count);
+		data.resize((size_t)count);
+		if (count > 0)
+		{
+			const size_t offset = pos;
+			_read(*data.data(), count);
+			if (memoryMapped)
+			{
+				ReleaseMappedRange(offset, pos - offset);
+			}
+		}
+		return *this;
+	}
+
+	// The first archive version that supports WriteBlock() and ReadBlock()
+	static constexpr uint64_t BLOCK_VERSION = 73;
+
+	// Create an empty archive for writing a section, that can be written into this archive with WriteSection()
+	wiArchive CreateSection() const;
+	// Write the contents of an other archive into this one, it can be read back with OpenSection()
+	inline void WriteSection(const wiArchive& section)
+	{
+		_write(*section.GetData(), section.GetSize());
+	}
+	// Open the next size bytes of this archive as a separate archive for reading, and skip them in this archive
+	//	The section references the data of this archive without copying, so this archive must be kept alive while the section is read
+	//	Sections can be read independently of each other, for example on multiple threads
+	wiArchive OpenSection(size_t size);
+	// Skip the next size bytes in read mode
+	inline void Skip(size_t size)
+	{
+		pos += size;
+	}
 
 
 
@@ -335,7 +420,7 @@ private:
 	template<typename T>
 	inline void _read(T& data, uint64_t count = 1)
 	{
-		memcpy(&data, reinterpret_cast<void*>((uint64_t)DATA.data() + (uint64_t)pos), (size_t)(sizeof(data)*count));
+		memcpy(&data, reinterpret_cast<const void*>((uint64_t)GetData() + (uint64_t)pos), (size_t)(sizeof(data)*count));
 		pos += (size_t)(sizeof(data)*count);
 	}
 };
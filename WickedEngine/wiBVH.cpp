@@ -0,0 +1,291 @@
+#include "wiBVH.h"
+
+#include <algorithm>
+
+namespace wiBVH_Internal
+{
+	static constexpr uint32_t PARALLEL_BUILD_THRESHOLD = 8192; // subtrees with more primitives than this are built in a separate job
+	static constexpr uint32_t MEDIAN_SPLIT_DEPTH = wiBVH::MAX_DEPTH - 32; // below this depth, only median split is used, so depth is bounded
+	static constexpr float REBUILD_THRESHOLD = 2.0f; // rebuild when the refitted tree's cost grows more than this compared to the built tree
+
+	inline void Merge(AABB& dst, const AABB& src)
+	{
+		// Vector min/max is used because it is branchless, boxes in random order would cause a lot of mispredictions
+		XMStoreFloat3(&dst._min, XMVectorMin(XMLoadFloat3(&dst._min), XMLoadFloat3(&src._min)));
+		XMStoreFloat3(&dst._max, XMVectorMax(XMLoadFloat3(&dst._max), XMLoadFloat3(&src._max)));
+		dst.layerMask |= src.layerMask;
+	}
+	inline float HalfSurfaceArea(const AABB& aabb)
+	{
+		const float x = aabb._max.x - aabb._min.x;
+		const float y = aabb._max.y - aabb._min.y;
+		const float z = aabb._max.z - aabb._min.z;
+		if (x < 0 || y < 0 || z < 0)
+		{
+			return 0; // empty
+		}
+		return x * y + y * z + z * x;
+	}
+	inline float GetAxis(const XMFLOAT3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+	inline AABB EmptyNodeAABB()
+	{
+		AABB aabb;
+		aabb.layerMask = 0;
+		return aabb;
+	}
+}
+using namespace wiBVH_Internal;
+
+void wiBVH::Update(wiJobSystem::context& ctx, const AABB* aabbs, uint32_t count)
+{
+	if (!IsValid(count) || refitCost > buildCost * REBUILD_THRESHOLD)
+	{
+		Build(ctx, aabbs, count);
+	}
+	else
+	{
+		Refit(ctx, aabbs);
+	}
+}
+
+void wiBVH::Build(wiJobSystem::context& ctx, const AABB* aabbs, uint32_t count)
+{
+	primitiveCount = count;
+	if (count == 0)
+	{
+		nodes.clear();
+		leaf_indices.clear();
+		leaf_bounds.resize(0);
+		buildCost = 0;
+		refitCost = 0;
+		return;
+	}
+
+	// Primitives are partitioned together with their centroids, so the build accesses memory linearly:
+	leaf_indices.resize(count);
+	leaf_bounds.resize(count);
+	primitives.resize(count);
+	wiJobSystem::Dispatch(ctx, count, 1024, [&](wiJobArgs args) {
+		const AABB& aabb = aabbs[args.jobIndex];
+		BuildPrimitive& primitive = primitives[args.jobIndex];
+		primitive.index = args.jobIndex;
+		if (aabb._min.x <= aabb._max.x && aabb._min.y <= aabb._max.y && aabb._min.z <= aabb._max.z)
+		{
+			primitive.centroid = aabb.getCenter();
+		}
+		else
+		{
+			primitive.centroid = XMFLOAT3(0, 0, 0); // empty boxes are not allowed to blow up the centroid bounds
+		}
+	});
+	wiJobSystem::Wait(ctx);
+
+	// A binary tree with at most "count" leaves has less than 2 * count nodes:
+	nodes.resize(count * 2);
+	nodeAllocator.store(1);
+	Subdivide(ctx, 0, 0, count, 0);
+	wiJobSystem::Wait(ctx);
+	nodes.resize(nodeAllocator.load());
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		leaf_indices[i] = primitives[i].index;
+	}
+	primitives.clear();
+
+	Refit(ctx, aabbs);
+	buildCost = refitCost;
+}
+
+void wiBVH::Subdivide(wiJobSystem::context& ctx, uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth)
+{
+	Node& node = nodes[nodeIndex];
+	const uint32_t count = end - begin;
+	if (count <= LEAF_SIZE)
+	{
+		node.offset = begin;
+		node.count = count;
+		return;
+	}
+
+	// Split along the longest axis of centroid bounds:
+	XMFLOAT3 _min = primitives[begin].centroid;
+	XMFLOAT3 _max = _min;
+	for (uint32_t i = begin + 1; i < end; ++i)
+	{
+		const XMFLOAT3& c = primitives[i].centroid;
+		_min = XMFLOAT3(std::min(_min.x, c.x), std::min(_min.y, c.y), std::min(_min.z, c.z));
+		_max = XMFLOAT3(std::max(_max.x, c.x), std::max(_max.y, c.y), std::max(_max.z, c.z));
+	}
+	const XMFLOAT3 extent = XMFLOAT3(_max.x - _min.x, _max.y - _min.y, _max.z - _min.z);
+	int axis = 0;
+	if (extent.y > extent.x)
+	{
+		axis = 1;
+	}
+	if (extent.z > GetAxis(extent, axis))
+	{
+		axis = 2;
+	}
+
+	BuildPrimitive* first = primitives.data() + begin;
+	BuildPrimitive* last = primitives.data() + end;
+	BuildPrimitive* mid = first;
+
+	if (depth < MEDIAN_SPLIT_DEPTH)
+	{
+		// Spatial median split is good for sparse open worlds:
+		const float pivot = GetAxis(_min, axis) + GetAxis(extent, axis) * 0.5f;
+		mid = std::partition(first, last, [&](const BuildPrimitive& primitive) {
+			return GetAxis(primitive.centroid, axis) < pivot;
+		});
+	}
+	if (mid == first || mid == last)
+	{
+		// Object median split is the fallback if spatial split failed, it is always balanced:
+		mid = first + count / 2;
+		std::nth_element(first, mid, last, [&](const BuildPrimitive& a, const BuildPrimitive& b) {
+			return GetAxis(a.centroid, axis) < GetAxis(b.centroid, axis);
+		});
+	}
+
+	const uint32_t split = begin + uint32_t(mid - first);
+	const uint32_t left = nodeAllocator.fetch_add(2);
+	node.offset = left;
+	node.count = 0;
+
+	if (count > PARALLEL_BUILD_THRESHOLD)
+	{
+		wiJobSystem::Execute(ctx, [this, &ctx, left, begin, split, depth](wiJobArgs args) {
+			Subdivide(ctx, left, begin, split, depth + 1);
+		});
+	}
+	else
+	{
+		Subdivide(ctx, left, begin, split, depth + 1);
+	}
+	Subdivide(ctx, left + 1, split, end, depth + 1);
+}
+
+void wiBVH::Refit(wiJobSystem::context& ctx, const AABB* aabbs)
+{
+	if (nodes.empty())
+	{
+		refitCost = 0;
+		return;
+	}
+
+	// Leaves are refitted in parallel, and the primitive bounds are also copied to the SoA layout:
+	wiJobSystem::Dispatch(ctx, (uint32_t)nodes.size(), 256, [&](wiJobArgs args) {
+		Node& node = nodes[args.jobIndex];
+		if (node.IsLeaf())
+		{
+			node.aabb = EmptyNodeAABB();
+			for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+			{
+				const AABB& aabb = aabbs[leaf_indices[i]];
+				leaf_bounds.set(i, aabb);
+				Merge(node.aabb, aabb);
+			}
+		}
+	});
+	wiJobSystem::Wait(ctx);
+
+	// Children are always allocated after their parent, so reverse order visits them first:
+	float cost = 0;
+	for (size_t i = nodes.size(); i > 0; --i)
+	{
+		Node& node = nodes[i - 1];
+		if (!node.IsLeaf())
+		{
+			node.aabb = nodes[node.offset].aabb;
+			Merge(node.aabb, nodes[node.offset + 1].aabb);
+			cost += HalfSurfaceArea(node.aabb);
+		}
+	}
+	refitCost = cost;
+}
+
+wiBVH& wiBVH::operator=(const wiBVH& other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+	nodes = other.nodes;
+	leaf_indices = other.leaf_indices;
+	leaf_bounds = other.leaf_bounds;
+	primitives.clear();
+	primitiveCount = other.primitiveCount;
+	buildCost = other.buildCost;
+	refitCost = other.refitCost;
+	return *this;
+}
+
+wiBVH& wiBVH::operator=(wiBVH&& other) noexcept
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+	nodes = std::move(other.nodes);
+	leaf_indices = std::move(other.leaf_indices);
+	leaf_bounds = std::move(other.leaf_bounds);
+	primitives.clear();
+	primitiveCount = other.primitiveCount;
+	buildCost = other.buildCost;
+	refitCost = other.refitCost;
+	other.Clear();
+	return *this;
+}
+
+void wiBVH::Clear()
+{
+	nodes.clear();
+	leaf_indices.clear();
+	leaf_bounds.resize(0);
+	primitives.clear();
+	primitiveCount = 0;
+	buildCost = 0;
+	refitCost = 0;
+}
+
+void wiBVH::GatherSubtrees(const Frustum& frustum, uint32_t layerMask, uint32_t targetCount, std::vector<uint32_t>& subtrees) const
+{
+	subtrees.clear();
+	if (nodes.empty())
+	{
+		return;
+	}
+	subtrees.push_back(0);
+
+	std::vector<uint32_t> next;
+	bool descend = true;
+	while (descend && subtrees.size() < targetCount)
+	{
+		descend = false;
+		next.clear();
+		for (uint32_t index : subtrees)
+		{
+			const Node& node = nodes[index];
+			if ((node.aabb.layerMask & layerMask) == 0 || !frustum.CheckBoxFast(node.aabb))
+			{
+				continue;
+			}
+			if (node.IsLeaf())
+			{
+				next.push_back(index);
+			}
+			else
+			{
+				next.push_back(node.offset);
+				next.push_back(node.offset + 1);
+				descend = true;
+			}
+		}
+		subtrees.swap(next);
+	}
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiIntersect.h"
+#include "wiJobSystem.h"
+
+#include <vector>
+
+// Bounding volume hierarchy built on the CPU over a linear array of AABBs (for example scene.aabb_objects)
+//	The leaves reference primitives by their index in the array
+//	When only the bounding boxes change, the tree is refitted. It is rebuilt when the primitive count changes or the tree quality degrades
+class wiBVH
+{
+public:
+	struct Node
+	{
+		AABB aabb; // layerMask contains the union of layers of all primitives in the subtree
+		uint32_t offset = 0; // internal node: index of left child (right child is offset + 1); leaf: first index into leaf_indices
+		uint32_t count = 0; // leaf: number of primitives; internal node: 0
+
+		constexpr bool IsLeaf() const { return count > 0; }
+	};
+	std::vector<Node> nodes; // nodes[0] is the root
+	std::vector<uint32_t> leaf_indices; // primitive indices referenced by leaf nodes
+	AABB_SoA leaf_bounds; // primitive bounds in the same order as leaf_indices, so leaves can be culled with SIMD
+
+	static constexpr uint32_t LEAF_SIZE = 8; // max primitives in a leaf (matches the AVX2 culling width)
+	static constexpr uint32_t MAX_DEPTH = 96;
+
+	// Copying and moving only transfers the tree, so the BVH can be a member of components
+	wiBVH() = default;
+	wiBVH(const wiBVH& other) { *this = other; }
+	wiBVH(wiBVH&& other) noexcept { *this = std::move(other); }
+	wiBVH& operator=(const wiBVH& other);
+	wiBVH& operator=(wiBVH&& other) noexcept;
+
+	// Refit the tree if possible, otherwise rebuild it
+	//	ctx is used to parallelize the work, and it will be waited on
+	void Update(wiJobSystem::context& ctx, const AABB* aabbs, uint32_t count);
+	// Rebuild the whole tree
+	void Build(wiJobSystem::context& ctx, const AABB* aabbs, uint32_t count);
+	// Recompute the node bounds, while keeping the tree structure
+	void Refit(wiJobSystem::context& ctx, const AABB* aabbs);
+
+	void Clear();
+
+	// Returns whether the tree was built for the specified number of primitives
+	inline bool IsValid(uint32_t count) const { return primitiveCount == count && (count == 0 || !nodes.empty()); }
+
+	// Collect the roots of subtrees that intersect the frustum and layerMask
+	//	It descends level by level until at least targetCount subtrees are found, or the leaves are reached
+	//	The resulting subtrees are disjoint, so they can be traversed in parallel with IntersectSubtree()
+	void GatherSubtrees(const Frustum& frustum, uint32_t layerMask, uint32_t targetCount, std::vector<uint32_t>& subtrees) const;
+
+	// Traverse a subtree and call callback(uint32_t primitiveIndex) for every primitive that intersects the frustum and layerMask
+	//	The primitives are tested in the same way as with Frustum::CheckBoxFast()
+	template<typename F>
+	inline void IntersectSubtree(uint32_t root, const Frustum& frustum, uint32_t layerMask, F callback) const
+	{
+		Traverse(root, layerMask,
+			[&](const AABB& aabb) { return frustum.CheckBoxFast(aabb); },
+			[&](const Node& leaf) {
+				uint32_t visible[LEAF_SIZE];
+				const uint32_t count = frustum.CheckBoxesFast(leaf_bounds, leaf.offset, leaf.offset + leaf.count, layerMask, visible);
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					callback(leaf_indices[visible[i]]);
+				}
+			}
+		);
+	}
+
+	// Call callback(uint32_t primitiveIndex) for every primitive that intersects the sphere and layerMask
+	template<typename F>
+	inline void Intersects(const SPHERE& sphere, uint32_t layerMask, F callback) const
+	{
+		if (nodes.empty())
+		{
+			return;
+		}
+		Traverse(0, layerMask,
+			[&](const AABB& aabb) { return sphere.intersects(aabb); },
+			[&](const Node& leaf) {
+				for (uint32_t i = leaf.offset; i < leaf.offset + leaf.count; ++i)
+				{
+					const AABB aabb = leaf_bounds.get(i);
+					if ((aabb.layerMask & layerMask) && sphere.intersects(aabb))
+					{
+						callback(leaf_indices[i]);
+					}
+				}
+			}
+		);
+	}
+
+	// Call callback(uint32_t primitiveIndex) for every primitive that intersects the box and layerMask
+	template<typename F>
+	inline void Intersects(const AABB& box, uint32_t layerMask, F callback) const
+	{
+		if (nodes.empty())
+		{
+			return;
+		}
+		Traverse(0, layerMask,
+			[&](const AABB& aabb) { return box.intersects(aabb) != AABB::OUTSIDE; },
+			[&](const Node& leaf) {
+				for (uint32_t i = leaf.offset; i < leaf.offset + leaf.count; ++i)
+				{
+					const AABB aabb = leaf_bounds.get(i);
+					if ((aabb.layerMask & layerMask) && box.intersects(aabb) != AABB::OUTSIDE)
+					{
+						callback(leaf_indices[i]);
+					}
+				}
+			}
+		);
+	}
+
+	// Packet traversal: call callback(uint32_t primitiveIndex, uint32_t rayMask) for every primitive that is hit by any ray of the packet and is in the layerMask
+	//	rayMask contains the rays that hit the primitive's box
+	//	The packet's tmax can be lowered by the callback (closest hit search), the subtrees that are farther will be skipped
+	template<typename F>
+	inline void Intersects(const RAY_Packet& packet, uint32_t layerMask, F callback) const
+	{
+		if (nodes.empty())
+		{
+			return;
+		}
+		Traverse(0, layerMask,
+			[&](const AABB& aabb) { return packet.intersects(aabb) != 0; },
+			[&](const Node& leaf) {
+				for (uint32_t i = leaf.offset; i < leaf.offset + leaf.count; ++i)
+				{
+					const AABB aabb = leaf_bounds.get(i);
+					if ((aabb.layerMask & layerMask) == 0)
+					{
+						continue;
+					}
+					const uint32_t rayMask = packet.intersects(aabb);
+					if (rayMask != 0)
+					{
+						callback(leaf_indices[i], rayMask);
+					}
+				}
+			}
+		);
+	}
+
+	// Depth first traversal of a subtree
+	//	node_test(const AABB&) decides whether the node is intersected
+	//	leaf(const Node&) is called for every intersected leaf node
+	template<typename NodeTest, typename LeafFunc>
+	inline void Traverse(uint32_t root, uint32_t layerMask, NodeTest node_test, LeafFunc leaf) const
+	{
+		uint32_t stack[MAX_DEPTH + 2];
+		uint32_t stackpos = 0;
+		stack[stackpos++] = root;
+		while (stackpos > 0)
+		{
+			const Node& node = nodes[stack[--stackpos]];
+			if ((node.aabb.layerMask & layerMask) == 0 || !node_test(node.aabb))
+			{
+				continue;
+			}
+			if (node.IsLeaf())
+			{
+				leaf(node);
+			}
+			else
+			{
+				assert(stackpos + 2 <= arraysize(stack));
+				stack[stackpos++] = node.offset + 1;
+				stack[stackpos++] = node.offset;
+			}
+		}
+	}
+
+private:
+	struct BuildPrimitive
+	{
+		XMFLOAT3 centroid;
+		uint32_t index;
+	};
+	std::vector<BuildPrimitive> primitives; // only used while building
+	std::atomic<uint32_t> nodeAllocator{ 0 };
+	uint32_t primitiveCount = 0;
+	float buildCost = 0; // sum of internal node surface areas after the last build
+	float refitCost = 0; // sum of internal node surface areas after the last refit
+
+	void Subdivide(wiJobSystem::context& ctx, uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth);
+};
@@ -3,12 +3,15 @@
 
 #include "wiArchive.h"
 #include "wiJobSystem.h"
+#include "wiSpinLock.h"
 
 #include <cstdint>
 #include <cassert>
 #include <vector>
 #include <unordered_map>
 #include <atomic>
+#include <memory>
+#include <algorithm>
 
 namespace wiECS
 {
@@ -25,6 +28,7 @@ namespace wiECS
 	{
 		wiJobSystem::context ctx; // allow components to spawn serialization subtasks
 		std::unordered_map<uint64_t, Entity> remap;
+		wiSpinLock locker; // remap is locked, so multiple archives can be deserialized in parallel with the same serializer
 		bool allow_remap = true;
 
 		~EntitySerializer()
@@ -43,6 +47,7 @@ namespace wiECS
 
 			if (seri.allow_remap)
 			{
+				seri.locker.lock();
 				auto it = seri.remap.find(mem);
 				if (it == seri.remap.end())
 				{
@@ -53,6 +58,7 @@ namespace wiECS
 				{
 					entity = it->second;
 				}
+				seri.locker.unlock();
 			}
 			else
 			{
@@ -65,6 +71,84 @@ namespace wiECS
 		}
 	}
 
+	// Sparse set that maps entities to component indices
+	//	Entity IDs are used to directly index into fixed size pages, so lookup is O(1) without hashing
+	//	Pages are only allocated for entity ranges that are actually used
+	class EntityIndexMap
+	{
+	public:
+		static constexpr size_t INVALID_INDEX = ~0ull;
+
+		// Retrieve the index of an entity (if not exists, returns INVALID_INDEX)
+		inline size_t get(Entity entity) const
+		{
+			const size_t page = entity >> PAGE_SHIFT;
+			if (page < pages.size() && pages[page] != nullptr)
+			{
+				const uint32_t index = pages[page][entity & PAGE_MASK];
+				if (index != INVALID_PAGE_ENTRY)
+				{
+					return index;
+				}
+			}
+			return INVALID_INDEX;
+		}
+
+		// Map an entity to an index, allocates a page if needed
+		inline void set(Entity entity, size_t index)
+		{
+			assert(index < INVALID_PAGE_ENTRY);
+			const size_t page = entity >> PAGE_SHIFT;
+			if (page >= pages.size())
+			{
+				pages.resize(page + 1);
+			}
+			if (pages[page] == nullptr)
+			{
+				pages[page].reset(new uint32_t[PAGE_SIZE]);
+				std::fill(pages[page].get(), pages[page].get() + PAGE_SIZE, INVALID_PAGE_ENTRY);
+			}
+			pages[page][entity & PAGE_MASK] = (uint32_t)index;
+		}
+
+		// Remove the mapping of an entity (the page is kept allocated)
+		inline void erase(Entity entity)
+		{
+			const size_t page = entity >> PAGE_SHIFT;
+			if (page < pages.size() && pages[page] != nullptr)
+			{
+				pages[page][entity & PAGE_MASK] = INVALID_PAGE_ENTRY;
+			}
+		}
+
+		inline void clear()
+		{
+			pages.clear();
+		}
+
+		// Perform deep copy of all the pages of "other" into this
+		inline void Copy(const EntityIndexMap& other)
+		{
+			pages.clear();
+			pages.resize(other.pages.size());
+			for (size_t i = 0; i < other.pages.size(); ++i)
+			{
+				if (other.pages[i] != nullptr)
+				{
+					pages[i].reset(new uint32_t[PAGE_SIZE]);
+					std::copy(other.pages[i].get(), other.pages[i].get() + PAGE_SIZE, pages[i].get());
+				}
+			}
+		}
+
+	private:
+		static constexpr size_t PAGE_SHIFT = 12;
+		static constexpr size_t PAGE_SIZE = 1ull << PAGE_SHIFT;
+		static constexpr size_t PAGE_MASK = PAGE_SIZE - 1;
+		static constexpr uint32_t INVALID_PAGE_ENTRY = ~0u;
+		std::vector<std::unique_ptr<uint32_t[]>> pages;
+	};
+
 	template<typename Component>
 	class ComponentManager
 	{
@@ -75,7 +159,6 @@ namespace wiECS
 		{
 			components.reserve(reservedCount);
 			entities.reserve(reservedCount);
-			lookup.reserve(reservedCount);
 		}
 
 		// Clear the whole container
@@ -92,7 +175,7 @@ namespace wiECS
 			Clear();
 			components = other.components;
 			entities = other.entities;
-			lookup = other.lookup;
+			lookup.Copy(other.lookup);
 		}
 
 		// Merge in an other component manager of the same type to this. 
@@ -102,14 +185,13 @@ namespace wiECS
 		{
 			components.reserve(GetCount() + other.GetCount());
 			entities.reserve(GetCount() + other.GetCount());
-			lookup.reserve(GetCount() + other.GetCount());
 
 			for (size_t i = 0; i < other.GetCount(); ++i)
 			{
 				Entity entity = other.entities[i];
 				assert(!Contains(entity));
 				entities.push_back(entity);
-				lookup[entity] = components.size();
+				lookup.set(entity, components.size());
 				components.push_back(std::move(other.components[i]));
 			}
 
@@ -138,7 +220,7 @@ namespace wiECS
 					Entity entity;
 					SerializeEntity(archive, entity, seri);
 					entities[i] = entity;
-					lookup[entity] = i;
+					lookup.set(entity, i);
 				}
 			}
 			else
@@ -162,14 +244,13 @@ namespace wiECS
 			assert(entity != INVALID_ENTITY);
 
 			// Only one of this component type per entity is allowed!
-			assert(lookup.find(entity) == lookup.end());
+			assert(!Contains(entity));
 
 			// Entity count must always be the same as the number of coponents!
 			assert(entities.size() == components.size());
-			assert(lookup.size() == components.size());
 
 			// Update the entity lookup table:
-			lookup[entity] = components.size();
+			lookup.set(entity, components.size());
 
 			// New components are always pushed to the end:
 			components.emplace_back();
@@ -183,13 +264,9 @@ namespace wiECS
 		// Remove a component of a certain entity if it exists
 		inline void Remove(Entity entity)
 		{
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.get(entity);
+			if (index != lookup.INVALID_INDEX)
 			{
-				// Directly index into components and entities array:
-				const size_t index = it->second;
-				const Entity entity = entities[index];
-
 				if (index < components.size() - 1)
 				{
 					// Swap out the dead element with the last one:
@@ -197,7 +274,7 @@ namespace wiECS
 					entities[index] = entities.back();
 
 					// Update the lookup table:
-					lookup[entities[index]] = index;
+					lookup.set(entities[index], index);
 				}
 
 				// Shrink the container:
@@ -210,13 +287,9 @@ namespace wiECS
 		// Remove a component of a certain entity if it exists while keeping the current ordering
 		inline void Remove_KeepSorted(Entity entity)
 		{
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.get(entity);
+			if (index != lookup.INVALID_INDEX)
 			{
-				// Directly index into components and entities array:
-				const size_t index = it->second;
-				const Entity entity = entities[index];
-
 				if (index < components.size() - 1)
 				{
 					// Move every component left by one that is after this element:
@@ -228,7 +301,7 @@ namespace wiECS
 					for (size_t i = index + 1; i < entities.size(); ++i)
 					{
 						entities[i - 1] = entities[i];
-						lookup[entities[i - 1]] = i - 1;
+						lookup.set(entities[i - 1], i - 1);
 					}
 				}
 
@@ -260,28 +333,28 @@ namespace wiECS
 				const size_t next = i + direction;
 				components[i] = std::move(components[next]);
 				entities[i] = entities[next];
-				lookup[entities[i]] = i;
+				lookup.set(entities[i], i);
 			}
 
 			// Saved entity-component moved to the required position:
 			components[index_to] = std::move(component);
 			entities[index_to] = entity;
-			lookup[entity] = index_to;
+			lookup.set(entity, index_to);
 		}
 
 		// Check if a component exists for a given entity or not
 		inline bool Contains(Entity entity) const
 		{
-			return lookup.find(entity) != lookup.end();
+			return lookup.get(entity) != lookup.INVALID_INDEX;
 		}
 
 		// Retrieve a [read/write] component specified by an entity (if it exists, otherwise nullptr)
 		inline Component* GetComponent(Entity entity)
 		{
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.get(entity);
+			if (index != lookup.INVALID_INDEX)
 			{
-				return &components[it->second];
+				return &components[index];
 			}
 			return nullptr;
 		}
@@ -289,10 +362,10 @@ namespace wiECS
 		// Retrieve a [read only] component specified by an entity (if it exists, otherwise nullptr)
 		inline const Component* GetComponent(Entity entity) const
 		{
-			const auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.get(entity);
+			if (index != lookup.INVALID_INDEX)
 			{
-				return &components[it->second];
+				return &components[index];
 			}
 			return nullptr;
 		}
@@ -300,10 +373,10 @@ namespace wiECS
 		// Retrieve component index by entity handle (if not exists, returns ~0 value)
 		inline size_t GetIndex(Entity entity) const 
 		{
-			const auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.get(entity);
+			if (index != lookup.INVALID_INDEX)
 			{
-				return it->second;
+				return index;
 			}
 			return ~0;
 		}
@@ -329,7 +402,7 @@ namespace wiECS
 		// This is a linear array of entities corresponding to each alive component
 		std::vector<Entity> entities;
 		// This is a lookup table for entities
-		std::unordered_map<Entity, size_t> lookup;
+		EntityIndexMap lookup;
 
 		// Disallow this to be copied by mistake
 		ComponentManager(const ComponentManager&) = delete;
@@ -0,0 +1,257 @@
+#include "wiGraphicsDevice_Null.h"
+#include "wiBackLog.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace wiGraphics
+{
+
+namespace Null_Internal
+{
+	struct Resource_Null
+	{
+		std::vector<uint8_t> data; // only allocated for resources that the CPU can access
+		uint32_t rowpitch = 0;
+		int subresource_counts[DSV + 1] = {}; // subresources are indexed separately for each SUBRESOURCE_TYPE
+	};
+	struct QueryHeap_Null
+	{
+		GPU_QUERY_TYPE type = GPU_QUERY_TYPE_TIMESTAMP;
+	};
+	struct Object_Null {}; // only the control-block is used for objects without state
+
+	Resource_Null* to_internal(const GPUResource* param)
+	{
+		return static_cast<Resource_Null*>(param->internal_state.get());
+	}
+	QueryHeap_Null* to_internal(const GPUQueryHeap* param)
+	{
+		return static_cast<QueryHeap_Null*>(param->internal_state.get());
+	}
+
+	inline bool IsCPUAccessible(USAGE usage, uint32_t cpuAccessFlags)
+	{
+		return usage == USAGE_DYNAMIC || usage == USAGE_STAGING || cpuAccessFlags != 0;
+	}
+}
+using namespace Null_Internal;
+
+GraphicsDevice_Null::GraphicsDevice_Null()
+{
+	// Queries always return zero for timestamps, this avoids division by zero in frequency conversions:
+	TIMESTAMP_FREQUENCY = 1000000;
+
+	wiBackLog::post("Created GraphicsDevice_Null (no rendering output)");
+}
+
+bool GraphicsDevice_Null::CreateSwapChain(const SwapChainDesc* pDesc, wiPlatform::window_type window, SwapChain* swapChain) const
+{
+	if (swapChain->internal_state == nullptr)
+	{
+		swapChain->internal_state = std::make_shared<Object_Null>();
+	}
+	swapChain->desc = *pDesc;
+	return true;
+}
+bool GraphicsDevice_Null::CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *pBuffer) const
+{
+	auto internal_state = std::make_shared<Resource_Null>();
+	pBuffer->internal_state = internal_state;
+	pBuffer->type = GPUResource::GPU_RESOURCE_TYPE::BUFFER;
+	pBuffer->desc = *pDesc;
+
+	if (IsCPUAccessible(pDesc->Usage, pDesc->CPUAccessFlags))
+	{
+		internal_state->data.resize(pDesc->ByteWidth);
+		if (pInitialData != nullptr && pInitialData->pSysMem != nullptr)
+		{
+			std::memcpy(internal_state->data.data(), pInitialData->pSysMem, pDesc->ByteWidth);
+		}
+		internal_state->rowpitch = pDesc->ByteWidth;
+	}
+
+	return true;
+}
+bool GraphicsDevice_Null::CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture) const
+{
+	auto internal_state = std::make_shared<Resource_Null>();
+	pTexture->internal_state = internal_state;
+	pTexture->type = GPUResource::GPU_RESOURCE_TYPE::TEXTURE;
+	pTexture->desc = *pDesc;
+
+	if (IsCPUAccessible(pDesc->Usage, pDesc->CPUAccessFlags))
+	{
+		// Only the first mip level is backed by memory:
+		const uint32_t blocksize = IsFormatBlockCompressed(pDesc->Format) ? 4 : 1;
+		const uint32_t width = std::max(1u, pDesc->Width / blocksize);
+		const uint32_t height = std::max(1u, pDesc->Height / blocksize);
+		internal_state->rowpitch = width * GetFormatStride(pDesc->Format);
+		internal_state->data.resize(size_t(internal_state->rowpitch) * height * std::max(1u, pDesc->Depth) * std::max(1u, pDesc->ArraySize));
+	}
+
+	return true;
+}
+bool GraphicsDevice_Null::CreateShader(SHADERSTAGE stage, const void *pShaderBytecode, size_t BytecodeLength, Shader *pShader) const
+{
+	pShader->internal_state = std::make_shared<Object_Null>();
+	pShader->stage = stage;
+	return true;
+}
+bool GraphicsDevice_Null::CreateSampler(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState) const
+{
+	pSamplerState->internal_state = std::make_shared<Object_Null>();
+	pSamplerState->desc = *pSamplerDesc;
+	return true;
+}
+bool GraphicsDevice_Null::CreateQueryHeap(const GPUQueryHeapDesc *pDesc, GPUQueryHeap *pQueryHeap) const
+{
+	auto internal_state = std::make_shared<QueryHeap_Null>();
+	internal_state->type = pDesc->type;
+	pQueryHeap->internal_state = internal_state;
+	pQueryHeap->desc = *pDesc;
+	return true;
+}
+bool GraphicsDevice_Null::CreatePipelineState(const PipelineStateDesc* pDesc, PipelineState* pso) const
+{
+	pso->internal_state = std::make_shared<Object_Null>();
+	pso->desc = *pDesc;
+	return true;
+}
+bool GraphicsDevice_Null::CreateRenderPass(const RenderPassDesc* pDesc, RenderPass* renderpass) const
+{
+	renderpass->internal_state = std::make_shared<Object_Null>();
+	renderpass->desc = *pDesc;
+	return true;
+}
+
+int GraphicsDevice_Null::CreateSubresource(Texture* texture, SUBRESOURCE_TYPE type, uint32_t firstSlice, uint32_t sliceCount, uint32_t firstMip, uint32_t mipCount) const
+{
+	return to_internal(texture)->subresource_counts[type]++;
+}
+int GraphicsDevice_Null::CreateSubresource(GPUBuffer* buffer, SUBRESOURCE_TYPE type, uint64_t offset, uint64_t size) const
+{
+	return to_internal(buffer)->subresource_counts[type]++;
+}
+
+void GraphicsDevice_Null::Map(const GPUResource* resource, Mapping* mapping) const
+{
+	auto internal_state = to_internal(resource);
+	if (internal_state->data.empty() || mapping->offset >= internal_state->data.size())
+	{
+		assert(0); // the resource must be created with CPU access
+		mapping->data = nullptr;
+		mapping->rowpitch = 0;
+		return;
+	}
+	mapping->data = internal_state->data.data() + mapping->offset;
+	mapping->rowpitch = internal_state->rowpitch;
+}
+void GraphicsDevice_Null::QueryRead(const GPUQueryHeap* heap, uint32_t index, uint32_t count, uint64_t* results) const
+{
+	// Occlusion queries report every object as visible, so culling doesn't depend on the missing GPU results:
+	const uint64_t value = to_internal(heap)->type == GPU_QUERY_TYPE_TIMESTAMP ? 0 : 1;
+	std::fill(results, results + count, value);
+}
+
+CommandList GraphicsDevice_Null::BeginCommandList(QUEUE_TYPE queue)
+{
+	CommandList cmd = cmd_count.fetch_add(1);
+	assert(cmd < COMMANDLIST_COUNT);
+
+	stats[cmd] = FrameStats();
+	stats[cmd].commandlists = 1;
+
+	return cmd;
+}
+void GraphicsDevice_Null::SubmitCommandLists()
+{
+	CommandList cmd_last = cmd_count.load();
+	cmd_count.store(0);
+
+	frame_stats = FrameStats();
+	for (CommandList cmd = 0; cmd < cmd_last; ++cmd)
+	{
+		frame_stats.Merge(stats[cmd]);
+
+		GPUAllocator& allocator = frame_allocators[cmd];
+		allocator.byteOffset = 0;
+		allocator.retired.clear();
+	}
+
+	FRAMECOUNT++;
+}
+
+Texture GraphicsDevice_Null::GetBackBuffer(const SwapChain* swapchain) const
+{
+	Texture result;
+	result.type = GPUResource::GPU_RESOURCE_TYPE::TEXTURE;
+	result.internal_state = std::make_shared<Resource_Null>();
+	result.desc.Width = swapchain->desc.width;
+	result.desc.Height = swapchain->desc.height;
+	result.desc.Format = swapchain->desc.format;
+	return result;
+}
+
+void GraphicsDevice_Null::CopyResource(const GPUResource* pDst, const GPUResource* pSrc, CommandList cmd)
+{
+	stats[cmd].copies++;
+
+	auto internal_state_dst = to_internal(pDst);
+	auto internal_state_src = to_internal(pSrc);
+	const size_t size = std::min(internal_state_dst->data.size(), internal_state_src->data.size());
+	if (size > 0)
+	{
+		std::memcpy(internal_state_dst->data.data(), internal_state_src->data.data(), size);
+	}
+}
+void GraphicsDevice_Null::UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize)
+{
+	const size_t size = dataSize < 0 ? (size_t)buffer->desc.ByteWidth : std::min((size_t)dataSize, (size_t)buffer->desc.ByteWidth);
+	stats[cmd].buffer_updates_size += size;
+
+	auto internal_state = to_internal(buffer);
+	if (!internal_state->data.empty() && size > 0)
+	{
+		std::memcpy(internal_state->data.data(), data, std::min(size, internal_state->data.size()));
+	}
+}
+
+GraphicsDevice::GPUAllocation GraphicsDevice_Null::AllocateGPU(size_t dataSize, CommandList cmd)
+{
+	GPUAllocation result;
+	if (dataSize == 0)
+	{
+		return result;
+	}
+	stats[cmd].allocated_size += dataSize;
+
+	GPUAllocator& allocator = frame_allocators[cmd];
+	if (!allocator.buffer.IsValid() || allocator.byteOffset + dataSize > allocator.buffer.desc.ByteWidth)
+	{
+		// Grow the allocator, the previous memory is kept alive until the end of the frame, because it can still be written:
+		if (allocator.buffer.IsValid())
+		{
+			allocator.retired.push_back(allocator.buffer.internal_state);
+		}
+		GPUBufferDesc desc;
+		desc.ByteWidth = uint32_t(std::max(size_t(1024 * 1024), (allocator.buffer.desc.ByteWidth + dataSize) * 2));
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_INDEX_BUFFER | BIND_VERTEX_BUFFER;
+		desc.Usage = USAGE_DYNAMIC;
+		desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		bool success = CreateBuffer(&desc, nullptr, &allocator.buffer);
+		assert(success);
+		allocator.byteOffset = 0;
+	}
+
+	auto internal_state = to_internal(&allocator.buffer);
+
+	result.buffer = &allocator.buffer;
+	result.offset = (uint32_t)allocator.byteOffset;
+	result.data = internal_state->data.data() + allocator.byteOffset;
+	allocator.byteOffset += dataSize;
+	return result;
+}
+
+}
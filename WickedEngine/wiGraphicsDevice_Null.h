@@ -0,0 +1,132 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiGraphicsDevice.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace wiGraphics
+{
+
+	// Graphics device that doesn't use any GPU, all commands are discarded
+	//	CPU visible memory (AllocateGPU, Map) is real, so the renderer can run headless, for example for CPU benchmarking on build servers
+	//	Commands are counted, see GetFrameStats()
+	class GraphicsDevice_Null : public GraphicsDevice
+	{
+	public:
+		struct FrameStats
+		{
+			uint32_t commandlists = 0;
+			uint32_t renderpasses = 0;
+			uint32_t drawcalls = 0;
+			uint32_t dispatches = 0;
+			uint32_t barriers = 0;
+			uint32_t copies = 0;
+			uint64_t buffer_updates_size = 0; // bytes written with UpdateBuffer()
+			uint64_t allocated_size = 0; // bytes allocated with AllocateGPU()
+
+			inline void Merge(const FrameStats& other)
+			{
+				commandlists += other.commandlists;
+				renderpasses += other.renderpasses;
+				drawcalls += other.drawcalls;
+				dispatches += other.dispatches;
+				barriers += other.barriers;
+				copies += other.copies;
+				buffer_updates_size += other.buffer_updates_size;
+				allocated_size += other.allocated_size;
+			}
+		};
+
+	protected:
+		FrameStats stats[COMMANDLIST_COUNT]; // the stats of command lists in the current frame
+		FrameStats frame_stats; // the stats of the last submitted frame
+
+		struct GPUAllocator
+		{
+			GPUBuffer buffer;
+			size_t byteOffset = 0;
+			std::vector<std::shared_ptr<void>> retired; // buffers that were outgrown, but might be still referenced in this frame
+		} frame_allocators[COMMANDLIST_COUNT];
+
+		std::atomic<CommandList> cmd_count{ 0 };
+
+	public:
+		GraphicsDevice_Null();
+
+		bool CreateSwapChain(const SwapChainDesc* pDesc, wiPlatform::window_type window, SwapChain* swapChain) const override;
+		bool CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *pBuffer) const override;
+		bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture) const override;
+		bool CreateShader(SHADERSTAGE stage, const void *pShaderBytecode, size_t BytecodeLength, Shader *pShader) const override;
+		bool CreateSampler(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState) const override;
+		bool CreateQueryHeap(const GPUQueryHeapDesc *pDesc, GPUQueryHeap *pQueryHeap) const override;
+		bool CreatePipelineState(const PipelineStateDesc* pDesc, PipelineState* pso) const override;
+		bool CreateRenderPass(const RenderPassDesc* pDesc, RenderPass* renderpass) const override;
+
+		int CreateSubresource(Texture* texture, SUBRESOURCE_TYPE type, uint32_t firstSlice, uint32_t sliceCount, uint32_t firstMip, uint32_t mipCount) const override;
+		int CreateSubresource(GPUBuffer* buffer, SUBRESOURCE_TYPE type, uint64_t offset, uint64_t size = ~0) const override;
+
+		void Map(const GPUResource* resource, Mapping* mapping) const override;
+		void Unmap(const GPUResource* resource) const override {}
+		void QueryRead(const GPUQueryHeap* heap, uint32_t index, uint32_t count, uint64_t* results) const override;
+
+		void SetCommonSampler(const StaticSampler* sam) override {}
+
+		void SetName(GPUResource* pResource, const char* name) override {}
+
+		void WaitForGPU() const override {}
+
+		CommandList BeginCommandList(QUEUE_TYPE queue = QUEUE_GRAPHICS) override;
+		void SubmitCommandLists() override;
+
+		Texture GetBackBuffer(const SwapChain* swapchain) const override;
+
+		// Returns the command statistics of the last submitted frame
+		const FrameStats& GetFrameStats() const { return frame_stats; }
+
+		///////////////Thread-sensitive////////////////////////
+
+		void RenderPassBegin(const SwapChain* swapchain, CommandList cmd) override { stats[cmd].renderpasses++; }
+		void RenderPassBegin(const RenderPass* renderpass, CommandList cmd) override { stats[cmd].renderpasses++; }
+		void RenderPassEnd(CommandList cmd) override {}
+		void BindScissorRects(uint32_t numRects, const Rect* rects, CommandList cmd) override {}
+		void BindViewports(uint32_t NumViewports, const Viewport* pViewports, CommandList cmd) override {}
+		void BindResource(SHADERSTAGE stage, const GPUResource* resource, uint32_t slot, CommandList cmd, int subresource = -1) override {}
+		void BindResources(SHADERSTAGE stage, const GPUResource *const* resources, uint32_t slot, uint32_t count, CommandList cmd) override {}
+		void BindUAV(SHADERSTAGE stage, const GPUResource* resource, uint32_t slot, CommandList cmd, int subresource = -1) override {}
+		void BindUAVs(SHADERSTAGE stage, const GPUResource *const* resources, uint32_t slot, uint32_t count, CommandList cmd) override {}
+		void UnbindResources(uint32_t slot, uint32_t num, CommandList cmd) override {}
+		void UnbindUAVs(uint32_t slot, uint32_t num, CommandList cmd) override {}
+		void BindSampler(SHADERSTAGE stage, const Sampler* sampler, uint32_t slot, CommandList cmd) override {}
+		void BindConstantBuffer(SHADERSTAGE stage, const GPUBuffer* buffer, uint32_t slot, CommandList cmd) override {}
+		void BindVertexBuffers(const GPUBuffer *const* vertexBuffers, uint32_t slot, uint32_t count, const uint32_t* strides, const uint32_t* offsets, CommandList cmd) override {}
+		void BindIndexBuffer(const GPUBuffer* indexBuffer, const INDEXBUFFER_FORMAT format, uint32_t offset, CommandList cmd) override {}
+		void BindStencilRef(uint32_t value, CommandList cmd) override {}
+		void BindBlendFactor(float r, float g, float b, float a, CommandList cmd) override {}
+		void BindPipelineState(const PipelineState* pso, CommandList cmd) override {}
+		void BindComputeShader(const Shader* cs, CommandList cmd) override {}
+		void Draw(uint32_t vertexCount, uint32_t startVertexLocation, CommandList cmd) override { stats[cmd].drawcalls++; }
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndexLocation, uint32_t baseVertexLocation, CommandList cmd) override { stats[cmd].drawcalls++; }
+		void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation, CommandList cmd) override { stats[cmd].drawcalls++; }
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndexLocation, uint32_t baseVertexLocation, uint32_t startInstanceLocation, CommandList cmd) override { stats[cmd].drawcalls++; }
+		void DrawInstancedIndirect(const GPUBuffer* args, uint32_t args_offset, CommandList cmd) override { stats[cmd].drawcalls++; }
+		void DrawIndexedInstancedIndirect(const GPUBuffer* args, uint32_t args_offset, CommandList cmd) override { stats[cmd].drawcalls++; }
+		void Dispatch(uint32_t threadGroupCountX, uint32_t threadGroupCountY, uint32_t threadGroupCountZ, CommandList cmd) override { stats[cmd].dispatches++; }
+		void DispatchIndirect(const GPUBuffer* args, uint32_t args_offset, CommandList cmd) override { stats[cmd].dispatches++; }
+		void DispatchMesh(uint32_t threadGroupCountX, uint32_t threadGroupCountY, uint32_t threadGroupCountZ, CommandList cmd) override { stats[cmd].dispatches++; }
+		void DispatchMeshIndirect(const GPUBuffer* args, uint32_t args_offset, CommandList cmd) override { stats[cmd].dispatches++; }
+		void CopyResource(const GPUResource* pDst, const GPUResource* pSrc, CommandList cmd) override;
+		void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1) override;
+		void QueryBegin(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override {}
+		void QueryEnd(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override {}
+		void Barrier(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override { stats[cmd].barriers += numBarriers; }
+
+		GPUAllocation AllocateGPU(size_t dataSize, CommandList cmd) override;
+
+		void EventBegin(const char* name, CommandList cmd) override {}
+		void EventEnd(CommandList cmd) override {}
+		void SetMarker(const char* name, CommandList cmd) override {}
+	};
+
+}
@@ -25,6 +25,7 @@ namespace wiInitializer
 
 		wiJobSystem::Initialize();
 		wiShaderCompiler::Initialize();
+		wiResourceManager::Initialize();
 
 		size_t shaderdump_count = wiRenderer::GetShaderDumpCount();
 		if (shaderdump_count > 0)
@@ -1,6 +1,17 @@
 #include "wiIntersect.h"
 #include "wiMath.h"
 
+#if defined(_XM_SSE_INTRINSICS_) && (defined(_M_X64) || defined(__x86_64__))
+#define FRUSTUM_CULLING_AVX2
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#include <immintrin.h>
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif // _MSC_VER
+#endif // FRUSTUM_CULLING_AVX2
+
 
 void AABB::createFromHalfWidth(const XMFLOAT3& center, const XMFLOAT3& halfwidth) 
 {
@@ -168,6 +179,25 @@ AABB AABB::Merge(const AABB& a, const AABB& b)
 {
 	return AABB(wiMath::Min(a.getMin(), b.getMin()), wiMath::Max(a.getMax(), b.getMax()));
 }
+
+void AABB_SoA::resize(size_t count)
+{
+	const size_t paddedCount = count + PADDING;
+	min_x.resize(paddedCount);
+	min_y.resize(paddedCount);
+	min_z.resize(paddedCount);
+	max_x.resize(paddedCount);
+	max_y.resize(paddedCount);
+	max_z.resize(paddedCount);
+	layerMask.resize(paddedCount);
+
+	AABB empty;
+	empty.layerMask = 0;
+	for (size_t i = count; i < paddedCount; ++i)
+	{
+		set(i, empty);
+	}
+}
 void AABB::Serialize(wiArchive& archive, wiECS::EntitySerializer& seri)
 {
 	if (archive.IsReadMode())
@@ -290,6 +320,52 @@ bool RAY::intersects(const SPHERE& b) const {
 	return b.intersects(*this);
 }
 
+RAY_Packet::RAY_Packet()
+{
+	origin_x = origin_y = origin_z = XMVectorZero();
+	direction_inverse_x = direction_inverse_y = direction_inverse_z = XMVectorZero();
+	tmax = XMVectorReplicate(-1);
+}
+void RAY_Packet::set(uint32_t lane, const XMVECTOR& origin, const XMVECTOR& direction, float tmax)
+{
+	const XMVECTOR direction_inverse = XMVectorReciprocal(direction);
+	origin_x = XMVectorSetByIndex(origin_x, XMVectorGetX(origin), lane);
+	origin_y = XMVectorSetByIndex(origin_y, XMVectorGetY(origin), lane);
+	origin_z = XMVectorSetByIndex(origin_z, XMVectorGetZ(origin), lane);
+	direction_inverse_x = XMVectorSetByIndex(direction_inverse_x, XMVectorGetX(direction_inverse), lane);
+	direction_inverse_y = XMVectorSetByIndex(direction_inverse_y, XMVectorGetY(direction_inverse), lane);
+	direction_inverse_z = XMVectorSetByIndex(direction_inverse_z, XMVectorGetZ(direction_inverse), lane);
+	set_tmax(lane, tmax);
+}
+void RAY_Packet::set_tmax(uint32_t lane, float value)
+{
+	tmax = XMVectorSetByIndex(tmax, value, lane);
+}
+uint32_t RAY_Packet::intersects(const AABB& b) const
+{
+	// Slab test of four rays against one box:
+	const XMVECTOR tx1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(b._min.x), origin_x), direction_inverse_x);
+	const XMVECTOR tx2 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(b._max.x), origin_x), direction_inverse_x);
+	const XMVECTOR ty1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(b._min.y), origin_y), direction_inverse_y);
+	const XMVECTOR ty2 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(b._max.y), origin_y), direction_inverse_y);
+	const XMVECTOR tz1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(b._min.z), origin_z), direction_inverse_z);
+	const XMVECTOR tz2 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(b._max.z), origin_z), direction_inverse_z);
+
+	XMVECTOR t_enter = XMVectorMax(XMVectorMin(tx1, tx2), XMVectorMax(XMVectorMin(ty1, ty2), XMVectorMin(tz1, tz2)));
+	XMVECTOR t_exit = XMVectorMin(XMVectorMax(tx1, tx2), XMVectorMin(XMVectorMax(ty1, ty2), XMVectorMax(tz1, tz2)));
+	t_enter = XMVectorMax(t_enter, XMVectorZero());
+	t_exit = XMVectorMin(t_exit, tmax);
+	const XMVECTOR hit = XMVectorLessOrEqual(t_enter, t_exit);
+
+#ifdef _XM_SSE_INTRINSICS_
+	return (uint32_t)_mm_movemask_ps(hit);
+#else
+	XMUINT4 lanes;
+	XMStoreUInt4(&lanes, hit);
+	return (lanes.x & 1) | ((lanes.y & 1) << 1) | ((lanes.z & 1) << 2) | ((lanes.w & 1) << 3);
+#endif // _XM_SSE_INTRINSICS_
+}
+
 
 
 
@@ -387,6 +463,194 @@ bool Frustum::CheckBoxFast(const AABB& box) const
 	return true;
 }
 
+
+// Batched frustum culling kernels:
+//	All of them perform the same test as Frustum::CheckBoxFast(): the box corner that is furthest along the plane normal must be in front of every plane
+//	The corner selection only depends on the plane, so it is made once per plane instead of per box
+namespace Frustum_Internal
+{
+	uint32_t CheckBoxesFast_Scalar(const XMFLOAT4* planes, const AABB_SoA& boxes, uint32_t begin, uint32_t end, uint32_t layerMask, uint32_t* result)
+	{
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			if ((boxes.layerMask[i] & layerMask) == 0)
+			{
+				continue;
+			}
+			bool visible = true;
+			for (int p = 0; p < 6 && visible; ++p)
+			{
+				const XMFLOAT4& plane = planes[p];
+				const float x = plane.x < 0 ? boxes.min_x[i] : boxes.max_x[i];
+				const float y = plane.y < 0 ? boxes.min_y[i] : boxes.max_y[i];
+				const float z = plane.z < 0 ? boxes.min_z[i] : boxes.max_z[i];
+				visible = x * plane.x + y * plane.y + z * plane.z + plane.w >= 0;
+			}
+			if (visible)
+			{
+				result[count++] = i;
+			}
+		}
+		return count;
+	}
+
+#ifdef _XM_SSE_INTRINSICS_
+	uint32_t CheckBoxesFast_SSE(const XMFLOAT4* planes, const AABB_SoA& boxes, uint32_t begin, uint32_t end, uint32_t layerMask, uint32_t* result)
+	{
+		__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			plane_x[p] = _mm_set1_ps(planes[p].x);
+			plane_y[p] = _mm_set1_ps(planes[p].y);
+			plane_z[p] = _mm_set1_ps(planes[p].z);
+			plane_w[p] = _mm_set1_ps(planes[p].w);
+		}
+		const __m128i layer = _mm_set1_epi32((int)layerMask);
+		const __m128i zero_int = _mm_setzero_si128();
+		const __m128 zero = _mm_setzero_ps();
+
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i += 4)
+		{
+			const __m128 min_x = _mm_loadu_ps(&boxes.min_x[i]);
+			const __m128 min_y = _mm_loadu_ps(&boxes.min_y[i]);
+			const __m128 min_z = _mm_loadu_ps(&boxes.min_z[i]);
+			const __m128 max_x = _mm_loadu_ps(&boxes.max_x[i]);
+			const __m128 max_y = _mm_loadu_ps(&boxes.max_y[i]);
+			const __m128 max_z = _mm_loadu_ps(&boxes.max_z[i]);
+			const __m128i layers = _mm_and_si128(_mm_loadu_si128((const __m128i*)&boxes.layerMask[i]), layer);
+
+			__m128 culled = _mm_castsi128_ps(_mm_cmpeq_epi32(layers, zero_int));
+			for (int p = 0; p < 6; ++p)
+			{
+				const __m128 x = planes[p].x < 0 ? min_x : max_x;
+				const __m128 y = planes[p].y < 0 ? min_y : max_y;
+				const __m128 z = planes[p].z < 0 ? min_z : max_z;
+				__m128 d = _mm_add_ps(_mm_mul_ps(x, plane_x[p]), _mm_mul_ps(y, plane_y[p]));
+				d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(z, plane_z[p]), plane_w[p]));
+				culled = _mm_or_ps(culled, _mm_cmplt_ps(d, zero));
+			}
+
+			uint32_t mask = ~(uint32_t)_mm_movemask_ps(culled) & 0xF;
+			const uint32_t remaining = end - i;
+			if (remaining < 4)
+			{
+				mask &= (1u << remaining) - 1;
+			}
+			for (uint32_t lane = 0; mask != 0; ++lane, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					result[count++] = i + lane;
+				}
+			}
+		}
+		return count;
+	}
+#endif // _XM_SSE_INTRINSICS_
+
+#ifdef FRUSTUM_CULLING_AVX2
+	AVX2_FUNCTION uint32_t CheckBoxesFast_AVX2(const XMFLOAT4* planes, const AABB_SoA& boxes, uint32_t begin, uint32_t end, uint32_t layerMask, uint32_t* result)
+	{
+		__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			plane_x[p] = _mm256_set1_ps(planes[p].x);
+			plane_y[p] = _mm256_set1_ps(planes[p].y);
+			plane_z[p] = _mm256_set1_ps(planes[p].z);
+			plane_w[p] = _mm256_set1_ps(planes[p].w);
+		}
+		const __m256i layer = _mm256_set1_epi32((int)layerMask);
+		const __m256i zero_int = _mm256_setzero_si256();
+		const __m256 zero = _mm256_setzero_ps();
+
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i += 8)
+		{
+			const __m256 min_x = _mm256_loadu_ps(&boxes.min_x[i]);
+			const __m256 min_y = _mm256_loadu_ps(&boxes.min_y[i]);
+			const __m256 min_z = _mm256_loadu_ps(&boxes.min_z[i]);
+			const __m256 max_x = _mm256_loadu_ps(&boxes.max_x[i]);
+			const __m256 max_y = _mm256_loadu_ps(&boxes.max_y[i]);
+			const __m256 max_z = _mm256_loadu_ps(&boxes.max_z[i]);
+			const __m256i layers = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)&boxes.layerMask[i]), layer);
+
+			__m256 culled = _mm256_castsi256_ps(_mm256_cmpeq_epi32(layers, zero_int));
+			for (int p = 0; p < 6; ++p)
+			{
+				const __m256 x = planes[p].x < 0 ? min_x : max_x;
+				const __m256 y = planes[p].y < 0 ? min_y : max_y;
+				const __m256 z = planes[p].z < 0 ? min_z : max_z;
+				__m256 d = _mm256_add_ps(_mm256_mul_ps(x, plane_x[p]), _mm256_mul_ps(y, plane_y[p]));
+				d = _mm256_add_ps(d, _mm256_add_ps(_mm256_mul_ps(z, plane_z[p]), plane_w[p]));
+				culled = _mm256_or_ps(culled, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+			}
+
+			uint32_t mask = ~(uint32_t)_mm256_movemask_ps(culled) & 0xFF;
+			const uint32_t remaining = end - i;
+			if (remaining < 8)
+			{
+				mask &= (1u << remaining) - 1;
+			}
+			for (uint32_t lane = 0; mask != 0; ++lane, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					result[count++] = i + lane;
+				}
+			}
+		}
+		return count;
+	}
+
+	bool IsAVX2Supported()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) // OS must also save the YMM registers
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif // _MSC_VER
+	}
+#endif // FRUSTUM_CULLING_AVX2
+
+	using CheckBoxesFastFunction = uint32_t(*)(const XMFLOAT4*, const AABB_SoA&, uint32_t, uint32_t, uint32_t, uint32_t*);
+	CheckBoxesFastFunction SelectCheckBoxesFast()
+	{
+#ifdef FRUSTUM_CULLING_AVX2
+		if (IsAVX2Supported())
+		{
+			return CheckBoxesFast_AVX2;
+		}
+#endif // FRUSTUM_CULLING_AVX2
+#ifdef _XM_SSE_INTRINSICS_
+		return CheckBoxesFast_SSE;
+#else
+		return CheckBoxesFast_Scalar;
+#endif // _XM_SSE_INTRINSICS_
+	}
+}
+uint32_t Frustum::CheckBoxesFast(const AABB_SoA& boxes, uint32_t begin, uint32_t end, uint32_t layerMask, uint32_t* result) const
+{
+	assert(end <= boxes.size());
+	static const Frustum_Internal::CheckBoxesFastFunction func = Frustum_Internal::SelectCheckBoxesFast();
+	return func(planes, boxes, begin, end, layerMask, result);
+}
+
 const XMFLOAT4& Frustum::getNearPlane() const { return planes[0]; }
 const XMFLOAT4& Frustum::getFarPlane() const { return planes[1]; }
 const XMFLOAT4& Frustum::getLeftPlane() const { return planes[2]; }
@@ -3,6 +3,8 @@
 #include "wiArchive.h"
 #include "wiECS.h"
 
+#include <vector>
+
 struct SPHERE;
 struct RAY;
 struct AABB;
@@ -61,6 +63,35 @@ struct AABB
 
 	void Serialize(wiArchive& archive, wiECS::EntitySerializer& seri);
 };
+// Bounding boxes in structure of arrays layout, for culling multiple boxes at once with SIMD
+//	The arrays are padded with empty boxes, so a full batch can always be loaded from any valid index
+struct AABB_SoA
+{
+	static constexpr uint32_t PADDING = 8;
+
+	std::vector<float> min_x, min_y, min_z;
+	std::vector<float> max_x, max_y, max_z;
+	std::vector<uint32_t> layerMask;
+
+	void resize(size_t count);
+	inline size_t size() const { return layerMask.empty() ? 0 : layerMask.size() - PADDING; }
+	inline void set(size_t index, const AABB& aabb)
+	{
+		min_x[index] = aabb._min.x;
+		min_y[index] = aabb._min.y;
+		min_z[index] = aabb._min.z;
+		max_x[index] = aabb._max.x;
+		max_y[index] = aabb._max.y;
+		max_z[index] = aabb._max.z;
+		layerMask[index] = aabb.layerMask;
+	}
+	inline AABB get(size_t index) const
+	{
+		AABB aabb(XMFLOAT3(min_x[index], min_y[index], min_z[index]), XMFLOAT3(max_x[index], max_y[index], max_z[index]));
+		aabb.layerMask = layerMask[index];
+		return aabb;
+	}
+};
 struct SPHERE 
 {
 	XMFLOAT3 center;
@@ -107,6 +138,22 @@ struct RAY
 	bool intersects(const AABB& b) const;
 	bool intersects(const SPHERE& b) const;
 };
+// Up to four rays in SoA layout, so they can be tested against a box at the same time with SIMD (packet traversal)
+//	Every ray has its own maximum distance, lanes that are not set are inactive
+struct RAY_Packet
+{
+	static constexpr uint32_t WIDTH = 4;
+
+	XMVECTOR origin_x, origin_y, origin_z;
+	XMVECTOR direction_inverse_x, direction_inverse_y, direction_inverse_z;
+	XMVECTOR tmax; // in units of the ray direction length, negative for inactive lanes
+
+	RAY_Packet();
+	void set(uint32_t lane, const XMVECTOR& origin, const XMVECTOR& direction, float tmax);
+	void set_tmax(uint32_t lane, float tmax);
+	// Returns the bit mask of rays that hit the box between distance 0 and their tmax
+	uint32_t intersects(const AABB& b) const;
+};
 
 struct Frustum
 {
@@ -125,6 +172,10 @@ struct Frustum
 	};
 	BoxFrustumIntersect CheckBox(const AABB& box) const;
 	bool CheckBoxFast(const AABB& box) const;
+	// Performs CheckBoxFast() and layer mask test for the boxes in the range [begin, end) of the SoA bounds
+	//	The indices of boxes that passed are written to result (which must have space for end - begin indices)
+	//	Returns the number of passed boxes. Uses AVX2 (8 boxes per iteration) or SSE (4 boxes per iteration) depending on CPU support
+	uint32_t CheckBoxesFast(const AABB_SoA& boxes, uint32_t begin, uint32_t end, uint32_t layerMask, uint32_t* result) const;
 
 	const XMFLOAT4& getNearPlane() const;
 	const XMFLOAT4& getFarPlane() const;
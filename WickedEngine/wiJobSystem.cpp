@@ -1,58 +1,298 @@
 #include "wiJobSystem.h"
 #include "wiSpinLock.h"
 #include "wiBackLog.h"
-#include "wiContainers.h"
 #include "wiPlatform.h"
+#include "wiProfiler.h"
 
 #include <thread>
 #include <condition_variable>
 #include <string>
 #include <algorithm>
+#include <deque>
+#include <memory>
 
 namespace wiJobSystem
 {
-	struct Job
+	// Shared state of one Execute() or Dispatch() call
+	struct Task
 	{
+		std::function<void(wiJobArgs)> func;
 		context* ctx;
-		std::function<void(wiJobArgs)> task;
-		uint32_t groupID;
-		uint32_t groupJobOffset;
-		uint32_t groupJobEnd;
+		uint32_t jobCount;
+		uint32_t groupSize;
 		uint32_t sharedmemory_size;
+		std::atomic<uint32_t> remaining; // number of groups not yet finished, the last one deletes the task
+	};
+
+	// A contiguous range of groups of a task. Ranges are split lazily by the thread that runs them, so idle threads can steal the other half
+	struct Job
+	{
+		Task* task;
+		uint32_t groupBegin;
+		uint32_t groupEnd;
+	};
+
+	// Fixed size lock-free work stealing deque (Chase-Lev)
+	//	Only the owner thread can push() and pop() from the bottom, any thread can steal() from the top
+	//	Based on: "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013)
+	class JobQueue
+	{
+	public:
+		static constexpr int64_t capacity = 1024; // must be power of two
+
+		// Returns false if the queue is full
+		inline bool push(const Job& job)
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed);
+			int64_t t = top.load(std::memory_order_acquire);
+			if (b - t >= capacity)
+			{
+				return false;
+			}
+			Slot& slot = slots[b & (capacity - 1)];
+			slot.task.store(job.task, std::memory_order_relaxed);
+			slot.range.store(((uint64_t)job.groupEnd << 32ull) | (uint64_t)job.groupBegin, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Take the most recently pushed job, owner only
+		inline bool pop(Job& job)
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b)
+			{
+				// empty
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return false;
+			}
+			read(b, job);
+			if (t == b)
+			{
+				// last item, race against thieves:
+				bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return won;
+			}
+			return true;
+		}
+
+		// Take the oldest job, any thread
+		inline bool steal(Job& job)
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b)
+			{
+				return false;
+			}
+			read(t, job);
+			return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+	private:
+		struct Slot
+		{
+			std::atomic<Task*> task;
+			std::atomic<uint64_t> range;
+		};
+		inline void read(int64_t index, Job& job) const
+		{
+			const Slot& slot = slots[index & (capacity - 1)];
+			job.task = slot.task.load(std::memory_order_relaxed);
+			uint64_t range = slot.range.load(std::memory_order_relaxed);
+			job.groupBegin = uint32_t(range & 0xFFFFFFFF);
+			job.groupEnd = uint32_t(range >> 32ull);
+		}
+
+		alignas(64) std::atomic<int64_t> top{ 0 };
+		alignas(64) std::atomic<int64_t> bottom{ 0 };
+		alignas(64) Slot slots[capacity];
+	};
+
+	// Unbounded queue for jobs that don't fit into a deque or are pushed by threads that don't own a deque
+	class OverflowQueue
+	{
+	public:
+		inline void push(const Job& job)
+		{
+			lock.lock();
+			jobs.push_back(job);
+			count.store((uint32_t)jobs.size(), std::memory_order_release);
+			lock.unlock();
+		}
+		inline bool pop(Job& job)
+		{
+			if (count.load(std::memory_order_acquire) == 0)
+			{
+				return false;
+			}
+			bool result = false;
+			lock.lock();
+			if (!jobs.empty())
+			{
+				job = jobs.front();
+				jobs.pop_front();
+				count.store((uint32_t)jobs.size(), std::memory_order_release);
+				result = true;
+			}
+			lock.unlock();
+			return result;
+		}
+
+	private:
+		std::deque<Job> jobs;
+		std::atomic<uint32_t> count{ 0 };
+		wiSpinLock lock;
 	};
 
 	uint32_t numThreads = 0;
-	wiContainers::ThreadSafeRingBuffer<Job, 256> jobQueue;
+	uint32_t numQueues = 0;
+	std::unique_ptr<JobQueue[]> queues; // [0] is owned by the thread that called Initialize(), the rest by worker threads
+	OverflowQueue overflowQueue;
+	OverflowQueue lowPriorityQueue;
 	std::condition_variable wakeCondition;
 	std::mutex wakeMutex;
+	std::atomic<uint64_t> wakeEpoch{ 0 };
+	std::atomic<uint32_t> sleepingThreads{ 0 };
+	std::atomic_bool alive{ true };
 
-	// This function executes the next item from the job queue. Returns true if successful, false if there was no job available
-	inline bool work()
+	// The worker threads are stopped and joined at exit, before the wake condition is destroyed (it can't be destroyed while threads are waiting on it)
+	struct Workers
 	{
-		Job job;
-		if (jobQueue.pop_front(job))
+		std::vector<std::thread> threads;
+		~Workers()
 		{
-			wiJobArgs args;
-			args.groupID = job.groupID;
-			if (job.sharedmemory_size > 0)
+			wakeMutex.lock();
+			alive.store(false);
+			wakeMutex.unlock();
+			wakeCondition.notify_all();
+			for (auto& thread : threads)
 			{
-				args.sharedmemory = alloca(job.sharedmemory_size);
+				thread.join();
+			}
+		}
+	} workers;
+
+	thread_local JobQueue* localQueue = nullptr;
+	thread_local uint32_t localQueueIndex = 0;
+
+	inline void push(const Job& job)
+	{
+		if (job.task->ctx->priority == Priority::Low)
+		{
+			lowPriorityQueue.push(job);
+			return;
+		}
+		if (localQueue == nullptr || !localQueue->push(job))
+		{
+			overflowQueue.push(job);
+		}
+	}
+
+	// Signal that new jobs are available. Sleeping threads are only woken (and the mutex only locked) if there are any
+	inline void wake(bool all)
+	{
+		wakeEpoch.fetch_add(1);
+		if (sleepingThreads.load() > 0)
+		{
+			// Locking ensures that a thread which is about to sleep either sees the new epoch or is already waiting:
+			wakeMutex.lock();
+			wakeMutex.unlock();
+			if (all)
+			{
+				wakeCondition.notify_all();
 			}
 			else
 			{
-				args.sharedmemory = nullptr;
+				wakeCondition.notify_one();
 			}
+		}
+	}
 
-			for (uint32_t i = job.groupJobOffset; i < job.groupJobEnd; ++i)
+	inline void execute(Job& job)
+	{
+		Task* task = job.task;
+
+		// Keep the first group, leave the rest to be stolen in progressively halved ranges:
+		if (job.groupEnd - job.groupBegin > 1)
+		{
+			while (job.groupEnd - job.groupBegin > 1)
 			{
-				args.jobIndex = i;
-				args.groupIndex = i - job.groupJobOffset;
-				args.isFirstJobInGroup = (i == job.groupJobOffset);
-				args.isLastJobInGroup = (i == job.groupJobEnd - 1);
-				job.task(args);
+				Job other = job;
+				other.groupBegin = job.groupBegin + (job.groupEnd - job.groupBegin) / 2;
+				job.groupEnd = other.groupBegin;
+				push(other);
 			}
+			wake(true);
+		}
 
-			job.ctx->counter.fetch_sub(1);
+		const uint32_t groupJobOffset = job.groupBegin * task->groupSize;
+		const uint32_t groupJobEnd = std::min(groupJobOffset + task->groupSize, task->jobCount);
+
+		wiJobArgs args;
+		args.groupID = job.groupBegin;
+		if (task->sharedmemory_size > 0)
+		{
+			args.sharedmemory = alloca(task->sharedmemory_size);
+		}
+		else
+		{
+			args.sharedmemory = nullptr;
+		}
+
+		wiProfiler::BeginEvent(task->jobCount > 1 ? "wiJobSystem::Dispatch" : "wiJobSystem::Execute");
+		for (uint32_t i = groupJobOffset; i < groupJobEnd; ++i)
+		{
+			args.jobIndex = i;
+			args.groupIndex = i - groupJobOffset;
+			args.isFirstJobInGroup = (i == groupJobOffset);
+			args.isLastJobInGroup = (i == groupJobEnd - 1);
+			task->func(args);
+		}
+		wiProfiler::EndEvent();
+
+		context* ctx = task->ctx;
+		if (task->remaining.fetch_sub(1) == 1)
+		{
+			delete task;
+		}
+		ctx->counter.fetch_sub(1);
+	}
+
+	// This function executes the next available job: first from the own queue, then from the overflow queue, then tries to steal from other threads.
+	//	Low priority jobs are only executed if there was no other job and lowPriority is true
+	//	Returns true if successful, false if there was no job available
+	inline bool work(bool lowPriority)
+	{
+		Job job;
+		if (localQueue != nullptr && localQueue->pop(job))
+		{
+			execute(job);
+			return true;
+		}
+		if (overflowQueue.pop(job))
+		{
+			execute(job);
+			return true;
+		}
+		for (uint32_t i = 1; i <= numQueues; ++i)
+		{
+			JobQueue& victim = queues[(localQueueIndex + i) % numQueues];
+			if (&victim != localQueue && victim.steal(job))
+			{
+				execute(job);
+				return true;
+			}
+		}
+		if (lowPriority && lowPriorityQueue.pop(job))
+		{
+			execute(job);
 			return true;
 		}
 		return false;
@@ -66,17 +306,30 @@ namespace wiJobSystem
 		// Calculate the actual number of worker threads we want (-1 main thread):
 		numThreads = std::max(1u, numCores - 1);
 
+		// One queue for each worker and one for the calling thread:
+		numQueues = numThreads + 1;
+		queues.reset(new JobQueue[numQueues]);
+		localQueue = &queues[0];
+		localQueueIndex = 0;
+
 		for (uint32_t threadID = 0; threadID < numThreads; ++threadID)
 		{
-			std::thread worker([] {
+			std::thread worker([threadID] {
 
-				while (true)
+				localQueueIndex = threadID + 1;
+				localQueue = &queues[localQueueIndex];
+				wiProfiler::SetThreadName(("wiJobSystem_" + std::to_string(threadID)).c_str());
+
+				while (alive.load())
 				{
-					if (!work())
+					const uint64_t epoch = wakeEpoch.load();
+					if (!work(true))
 					{
-						// no job, put thread to sleep
+						// no job, put thread to sleep until new jobs are pushed
 						std::unique_lock<std::mutex> lock(wakeMutex);
-						wakeCondition.wait(lock);
+						sleepingThreads.fetch_add(1);
+						wakeCondition.wait(lock, [epoch] { return wakeEpoch.load() != epoch || !alive.load(); });
+						sleepingThreads.fetch_sub(1);
 					}
 				}
 
@@ -101,7 +354,7 @@ namespace wiJobSystem
 			assert(SUCCEEDED(hr));
 #endif // _WIN32
 
-			worker.detach();
+			workers.threads.push_back(std::move(worker));
 		}
 
 		wiBackLog::post(("wiJobSystem Initialized with [" + std::to_string(numCores) + " cores] [" + std::to_string(numThreads) + " threads]").c_str());
@@ -118,18 +371,19 @@ namespace wiJobSystem
 		ctx.counter.fetch_add(1);
 
 		Job job;
-		job.ctx = &ctx;
-		job.task = task;
-		job.groupID = 0;
-		job.groupJobOffset = 0;
-		job.groupJobEnd = 1;
-		job.sharedmemory_size = 0;
-
-		// Try to push a new job until it is pushed successfully:
-		while (!jobQueue.push_back(job)) { wakeCondition.notify_all(); work(); }
+		job.task = new Task;
+		job.task->func = task;
+		job.task->ctx = &ctx;
+		job.task->jobCount = 1;
+		job.task->groupSize = 1;
+		job.task->sharedmemory_size = 0;
+		job.task->remaining.store(1);
+		job.groupBegin = 0;
+		job.groupEnd = 1;
+		push(job);
 
 		// Wake any one thread that might be sleeping:
-		wakeCondition.notify_one();
+		wake(false);
 	}
 
 	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(wiJobArgs)>& task, size_t sharedmemory_size)
@@ -144,24 +398,21 @@ namespace wiJobSystem
 		// Context state is updated:
 		ctx.counter.fetch_add(groupCount);
 
+		// All groups are pushed as a single range, it will be split up by the threads picking it up:
 		Job job;
-		job.ctx = &ctx;
-		job.task = task;
-		job.sharedmemory_size = (uint32_t)sharedmemory_size;
-
-		for (uint32_t groupID = 0; groupID < groupCount; ++groupID)
-		{
-			// For each group, generate one real job:
-			job.groupID = groupID;
-			job.groupJobOffset = groupID * groupSize;
-			job.groupJobEnd = std::min(job.groupJobOffset + groupSize, jobCount);
-
-			// Try to push a new job until it is pushed successfully:
-			while (!jobQueue.push_back(job)) { wakeCondition.notify_all(); work(); }
-		}
+		job.task = new Task;
+		job.task->func = task;
+		job.task->ctx = &ctx;
+		job.task->jobCount = jobCount;
+		job.task->groupSize = groupSize;
+		job.task->sharedmemory_size = (uint32_t)sharedmemory_size;
+		job.task->remaining.store(groupCount);
+		job.groupBegin = 0;
+		job.groupEnd = groupCount;
+		push(job);
 
 		// Wake any threads that might be sleeping:
-		wakeCondition.notify_all();
+		wake(true);
 	}
 
 	uint32_t DispatchGroupCount(uint32_t jobCount, uint32_t groupSize)
@@ -179,9 +430,87 @@ namespace wiJobSystem
 	void Wait(const context& ctx)
 	{
 		// Wake any threads that might be sleeping:
-		wakeCondition.notify_all();
+		wake(true);
 
 		// Waiting will also put the current thread to good use by working on an other job if it can:
-		while (IsBusy(ctx)) { work(); }
+		//	Low priority jobs are only picked up when waiting for low priority work, so they don't delay the waiting thread otherwise
+		while (IsBusy(ctx)) { work(ctx.priority == Priority::Low); }
+	}
+
+	void TaskGraph::AddTask(
+		const std::function<void(context&)>& task,
+		std::initializer_list<const void*> reads,
+		std::initializer_list<const void*> writes
+	)
+	{
+		const uint32_t nodeIndex = (uint32_t)nodes.size();
+		nodes.emplace_back();
+		Node& node = nodes.back();
+		node.task = task;
+		node.reads = reads;
+		node.writes = writes;
+
+		auto overlaps = [](const std::vector<const void*>& a, const std::vector<const void*>& b) {
+			for (const void* x : a)
+			{
+				if (std::find(b.begin(), b.end(), x) != b.end())
+				{
+					return true;
+				}
+			}
+			return false;
+		};
+
+		for (uint32_t i = 0; i < nodeIndex; ++i)
+		{
+			Node& prev = nodes[i];
+			if (overlaps(node.reads, prev.writes) || overlaps(node.writes, prev.writes) || overlaps(node.writes, prev.reads))
+			{
+				prev.dependents.push_back(nodeIndex);
+				node.dependencyCount++;
+			}
+		}
+	}
+
+	void TaskGraph::Run(context& ctx)
+	{
+		remaining.reset(new std::atomic<uint32_t>[nodes.size()]);
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			remaining[i].store(nodes[i].dependencyCount);
+		}
+		for (uint32_t i = 0; i < (uint32_t)nodes.size(); ++i)
+		{
+			if (nodes[i].dependencyCount == 0)
+			{
+				Schedule(ctx, i);
+			}
+		}
+	}
+
+	void TaskGraph::Clear()
+	{
+		nodes.clear();
+		remaining.reset();
+	}
+
+	void TaskGraph::Schedule(context& ctx, uint32_t nodeIndex)
+	{
+		Execute(ctx, [this, &ctx, nodeIndex](wiJobArgs args) {
+			const Node& node = nodes[nodeIndex];
+
+			context node_ctx;
+			node.task(node_ctx);
+			Wait(node_ctx);
+
+			// Dependents are scheduled before this job finishes, so ctx can't become idle in between:
+			for (uint32_t dependent : node.dependents)
+			{
+				if (remaining[dependent].fetch_sub(1) == 1)
+				{
+					Schedule(ctx, dependent);
+				}
+			}
+		});
 	}
 }
@@ -2,6 +2,9 @@
 
 #include <functional>
 #include <atomic>
+#include <vector>
+#include <memory>
+#include <initializer_list>
 
 struct wiJobArgs
 {
@@ -19,10 +22,21 @@ namespace wiJobSystem
 
 	uint32_t GetThreadCount();
 
+	// Priority of the jobs that are added to a context
+	//	High	: the jobs can be executed by any thread, including the threads that are waiting for other contexts
+	//	Low		: for long running background work. The jobs are only executed by idle worker threads, or by the thread that waits for this context,
+	//				so they will not hold up threads that are waiting for high priority work
+	enum class Priority
+	{
+		High,
+		Low,
+	};
+
 	// Defines a state of execution, can be waited on
 	struct context
 	{
 		std::atomic<uint32_t> counter{ 0 };
+		Priority priority = Priority::High;
 	};
 
 	// Add a task to execute asynchronously. Any idle thread will execute this.
@@ -42,4 +56,43 @@ namespace wiJobSystem
 
 	// Wait until all threads become idle
 	void Wait(const context& ctx);
+
+	// Graph of tasks, where dependencies are derived from the resources that each task reads and writes.
+	//	A task will depend on every previously added task that writes a resource that it reads or writes,
+	//	or reads a resource that it writes. Independent tasks will execute concurrently, without global barriers.
+	//	Resources are identified by address, for example a ComponentManager.
+	class TaskGraph
+	{
+	public:
+		// Add a task and declare its resource accesses
+		//	task	: receives a context that it can put its own subtasks into. The task is only finished when those also finished.
+		//	reads	: resources that are only read by the task
+		//	writes	: resources that are modified by the task
+		void AddTask(
+			const std::function<void(context&)>& task,
+			std::initializer_list<const void*> reads,
+			std::initializer_list<const void*> writes
+		);
+
+		// Start executing the graph asynchronously. The ctx will be busy until all tasks finished.
+		//	The graph must not be modified or destroyed while it is executing
+		void Run(context& ctx);
+
+		// Remove all tasks
+		void Clear();
+
+	private:
+		struct Node
+		{
+			std::function<void(context&)> task;
+			std::vector<const void*> reads;
+			std::vector<const void*> writes;
+			std::vector<uint32_t> dependents;
+			uint32_t dependencyCount = 0;
+		};
+		std::vector<Node> nodes;
+		std::unique_ptr<std::atomic<uint32_t>[]> remaining;
+
+		void Schedule(context& ctx, uint32_t nodeIndex);
+	};
 }
@@ -21,6 +21,30 @@ namespace wiPhysicsEngine
 	void SetDebugDrawEnabled(bool value);
 	bool IsDebugDrawEnabled();
 
+	// Enable/disable multithreaded simulation
+	//	Collision detection, motion prediction and constraint solving will be distributed among the wiJobSystem threads
+	void SetMultithreadingEnabled(bool value);
+	bool IsMultithreadingEnabled();
+
+	// Enable/disable deterministic multithreaded simulation
+	//	The results will only depend on the simulated state, not on the thread count or the job scheduling
+	//	Collision detection will not be multithreaded in this mode
+	void SetDeterministic(bool value);
+	bool IsDeterministic();
+
+	// Enable/disable asynchronous simulation
+	//	The simulation will run in fixed timesteps as a low priority job, overlapped with the rest of the frame until the next physics update
+	//	The transforms of simulated rigid bodies will be interpolated between the last two simulated states, so they are displayed with some latency
+	//	Forces and impulses will be applied when the running simulation has finished
+	void SetAsyncEnabled(bool value);
+	bool IsAsyncEnabled();
+
+	// Set the timestep of the asynchronous simulation in seconds
+	//	MainComponent sets this to the rate of its FixedUpdate() loop
+	//	Default is 1/60
+	void SetFixedTimestep(float value);
+	float GetFixedTimestep();
+
 	// Set the accuracy of the simulation
 	//	This value corresponds to maximum simulation step count
 	//	Higher values will be slower but more accurate
@@ -28,6 +52,11 @@ namespace wiPhysicsEngine
 	void SetAccuracy(int value);
 	int GetAccuracy();
 
+	// Compute a simplified convex hull for the mesh and store it in MeshComponent::convexhull_positions
+	//	This hull will be used by the CONVEX_HULL rigid bodies of the mesh, so it doesn't need to be computed when they are created
+	//	maxVertexCount : the maximum number of vertices in the hull
+	void CookConvexHull(wiScene::MeshComponent& mesh, uint32_t maxVertexCount = 64);
+
 	// Update the physics state, run simulation, etc.
 	void RunPhysicsUpdateSystem(
 		wiJobSystem::context& ctx,
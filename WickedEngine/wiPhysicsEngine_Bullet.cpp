@@ -4,15 +4,22 @@
 #include "wiBackLog.h"
 #include "wiJobSystem.h"
 #include "wiRenderer.h"
+#include "wiHelper.h"
 
 #include "btBulletDynamicsCommon.h"
 #include "BulletSoftBody/btSoftBodyHelpers.h"
 #include "BulletSoftBody/btDefaultSoftBodySolver.h"
 #include "BulletSoftBody/btSoftRigidDynamicsWorld.h"
 #include "BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h"
+#include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
 
 #include <mutex>
+#include <algorithm>
 #include <memory>
+#include <vector>
+#include <unordered_map>
+#include <limits>
+#include <functional>
 
 using namespace wiECS;
 using namespace wiScene;
@@ -23,16 +30,300 @@ namespace wiPhysicsEngine
 	bool ENABLED = true;
 	bool SIMULATION_ENABLED = true;
 	bool DEBUGDRAW_ENABLED = false;
+	bool MULTITHREADING_ENABLED = false;
+	bool DETERMINISTIC = false;
+	bool ASYNC_ENABLED = false;
+	float FIXED_TIMESTEP = 1.0f / 60.0f;
 	int ACCURACY = 10;
 	std::mutex physicsLock;
 
+	// Motion state that also keeps the transform from before the last simulation step, for interpolation
+	struct MotionState : public btDefaultMotionState
+	{
+		btTransform previousTransform;
+
+		MotionState(const btTransform& transform) : btDefaultMotionState(transform), previousTransform(transform) {}
+	};
+
+	// Collision dispatcher that can compute the contacts of the overlapping pairs in parallel
+	//	The manifold and collision algorithm pools are shared by all pairs, so they are accessed under a lock
+	class CollisionDispatcher : public btCollisionDispatcher
+	{
+	public:
+		CollisionDispatcher(btCollisionConfiguration* collisionConfiguration) : btCollisionDispatcher(collisionConfiguration) {}
+
+		btPersistentManifold* getNewManifold(const btCollisionObject* b0, const btCollisionObject* b1) override
+		{
+			std::lock_guard<std::mutex> lock(locker);
+			return btCollisionDispatcher::getNewManifold(b0, b1);
+		}
+		void releaseManifold(btPersistentManifold* manifold) override
+		{
+			std::lock_guard<std::mutex> lock(locker);
+			btCollisionDispatcher::releaseManifold(manifold);
+		}
+		void* allocateCollisionAlgorithm(int size) override
+		{
+			std::lock_guard<std::mutex> lock(locker);
+			return btCollisionDispatcher::allocateCollisionAlgorithm(size);
+		}
+		void freeCollisionAlgorithm(void* ptr) override
+		{
+			std::lock_guard<std::mutex> lock(locker);
+			btCollisionDispatcher::freeCollisionAlgorithm(ptr);
+		}
+
+		void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo, btDispatcher* dispatcher) override
+		{
+			// The order of the contact manifolds depends on which pair creates its manifold first, and the solver result depends on that order.
+			//	Continuous collision detection writes the time of impact into the shared dispatch info.
+			//	In these cases the pairs are processed in order on this thread:
+			const int pairCount = pairCache->getNumOverlappingPairs();
+			if (!MULTITHREADING_ENABLED || DETERMINISTIC || dispatchInfo.m_dispatchFunc != btDispatcherInfo::DISPATCH_DISCRETE || pairCount < 2)
+			{
+				btCollisionDispatcher::dispatchAllCollisionPairs(pairCache, dispatchInfo, dispatcher);
+				return;
+			}
+
+			btBroadphasePair* pairs = pairCache->getOverlappingPairArrayPtr();
+			btNearCallback nearCallback = getNearCallback();
+
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, (uint32_t)pairCount, 64, [&](wiJobArgs args) {
+				btBroadphasePair& pair = pairs[args.jobIndex];
+				if (!IsSoftBodyPair(pair))
+				{
+					nearCallback(pair, *this, dispatchInfo);
+				}
+			});
+
+			// Soft body collisions modify the contact lists of the soft body, which can be in multiple pairs:
+			for (int i = 0; i < pairCount; ++i)
+			{
+				if (IsSoftBodyPair(pairs[i]))
+				{
+					nearCallback(pairs[i], *this, dispatchInfo);
+				}
+			}
+
+			wiJobSystem::Wait(ctx);
+		}
+
+	private:
+		std::mutex locker;
+
+		static bool IsSoftBodyPair(const btBroadphasePair& pair)
+		{
+			const btCollisionObject* colObj0 = (const btCollisionObject*)pair.m_pProxy0->m_clientObject;
+			const btCollisionObject* colObj1 = (const btCollisionObject*)pair.m_pProxy1->m_clientObject;
+			return colObj0->getInternalType() == btCollisionObject::CO_SOFT_BODY || colObj1->getInternalType() == btCollisionObject::CO_SOFT_BODY;
+		}
+	};
+
+	// Dynamics world that can distribute the rigid body motion prediction and the constraint solving among the job system threads
+	//	Simulation islands don't share dynamic bodies, so batches of islands are solved in parallel, each by its own constraint solver
+	class DynamicsWorld : public btSoftRigidDynamicsWorld
+	{
+	public:
+		DynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btConstraintSolver* constraintSolver, btCollisionConfiguration* collisionConfiguration, btSoftBodySolver* softBodySolver)
+			: btSoftRigidDynamicsWorld(dispatcher, pairCache, constraintSolver, collisionConfiguration, softBodySolver), softBodySolver(softBodySolver)
+		{
+		}
+
+		// Simulate exactly stepCount steps of fixedTimeStep
+		//	The time is rounded to the middle of the last step, so the step count doesn't depend on floating point errors
+		void StepFixed(int stepCount, btScalar fixedTimeStep)
+		{
+			m_localTime = 0;
+			stepSimulation((btScalar(stepCount) + btScalar(0.5)) * fixedTimeStep, stepCount, fixedTimeStep);
+			m_localTime = 0;
+		}
+
+	protected:
+		void internalSingleStepSimulation(btScalar timeStep) override
+		{
+			for (int i = 0; i < m_nonStaticRigidBodies.size(); ++i)
+			{
+				btRigidBody* body = m_nonStaticRigidBodies[i];
+				((MotionState*)body->getMotionState())->previousTransform = body->getWorldTransform();
+			}
+
+			btSoftRigidDynamicsWorld::internalSingleStepSimulation(timeStep);
+		}
+
+		void predictUnconstraintMotion(btScalar timeStep) override
+		{
+			if (!MULTITHREADING_ENABLED)
+			{
+				btSoftRigidDynamicsWorld::predictUnconstraintMotion(timeStep);
+				return;
+			}
+
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, (uint32_t)m_nonStaticRigidBodies.size(), 256, [&](wiJobArgs args) {
+				btRigidBody* body = m_nonStaticRigidBodies[args.jobIndex];
+				if (!body->isStaticOrKinematicObject())
+				{
+					body->applyDamping(timeStep);
+					body->predictIntegratedTransform(timeStep, body->getInterpolationWorldTransform());
+				}
+			});
+			wiJobSystem::Wait(ctx);
+
+			softBodySolver->predictMotion(timeStep);
+		}
+
+		void solveConstraints(btContactSolverInfo& solverInfo) override
+		{
+			if (!MULTITHREADING_ENABLED || !m_islandManager->getSplitIslands())
+			{
+				btSoftRigidDynamicsWorld::solveConstraints(solverInfo);
+				return;
+			}
+
+			// Constraints are sorted by island like in btDiscreteDynamicsWorld:
+			m_sortedConstraints.resize(m_constraints.size());
+			for (int i = 0; i < m_constraints.size(); ++i)
+			{
+				m_sortedConstraints[i] = m_constraints[i];
+			}
+			m_sortedConstraints.quickSort(SortConstraintOnIsland());
+
+			// Islands are gathered into batches, then the batches are solved in parallel:
+			for (auto& batch : batches)
+			{
+				batch.Clear();
+			}
+			batchCount = 1;
+			IslandGatherer gatherer;
+			gatherer.world = this;
+			gatherer.minimumBatchSize = std::max(1, solverInfo.m_minimumSolverBatchSize);
+			m_islandManager->buildAndProcessIslands(getDispatcher(), this, &gatherer);
+			batchCount = std::min((uint32_t)batches.size(), batchCount + 1); // the last batch is included even if it's not full
+
+			// Each solver gets a seed that only depends on the step and the batch (for SOLVER_RANDMIZE_ORDER), so results don't depend on scheduling:
+			stepCount++;
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, batchCount, 1, [&](wiJobArgs args) {
+				Batch& batch = batches[args.jobIndex];
+				if (batch.manifolds.empty() && batch.constraints.empty())
+				{
+					return;
+				}
+				batch.solver->setRandSeed((unsigned long)(stepCount * 0x9E3779B9u + args.jobIndex));
+				batch.solver->solveGroup(
+					batch.bodies.data(), (int)batch.bodies.size(),
+					batch.manifolds.data(), (int)batch.manifolds.size(),
+					batch.constraints.data(), (int)batch.constraints.size(),
+					solverInfo, getDebugDrawer(), getDispatcher()
+				);
+			});
+			wiJobSystem::Wait(ctx);
+		}
+
+	private:
+		btSoftBodySolver* softBodySolver = nullptr;
+
+		struct Batch
+		{
+			std::vector<btCollisionObject*> bodies;
+			std::vector<btPersistentManifold*> manifolds;
+			std::vector<btTypedConstraint*> constraints;
+			std::unique_ptr<btSequentialImpulseConstraintSolver> solver = std::make_unique<btSequentialImpulseConstraintSolver>();
+
+			void Clear()
+			{
+				bodies.clear();
+				manifolds.clear();
+				constraints.clear();
+			}
+		};
+		std::vector<Batch> batches; // [0] is for the islands that are touching kinematic bodies
+		uint32_t batchCount = 0;
+		uint32_t stepCount = 0;
+
+		static int GetConstraintIslandId(const btTypedConstraint* constraint)
+		{
+			const btCollisionObject& colObj0 = constraint->getRigidBodyA();
+			const btCollisionObject& colObj1 = constraint->getRigidBodyB();
+			return colObj0.getIslandTag() >= 0 ? colObj0.getIslandTag() : colObj1.getIslandTag();
+		}
+		struct SortConstraintOnIsland
+		{
+			bool operator()(const btTypedConstraint* lhs, const btTypedConstraint* rhs) const
+			{
+				return GetConstraintIslandId(lhs) < GetConstraintIslandId(rhs);
+			}
+		};
+
+		struct IslandGatherer : public btSimulationIslandManager::IslandCallback
+		{
+			DynamicsWorld* world = nullptr;
+			int minimumBatchSize = 1;
+			int constraintOffset = 0;
+
+			void processIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, int islandId) override
+			{
+				// Islands are processed in increasing id order, so the constraints of the island are found by advancing in the sorted list:
+				const btAlignedObjectArray<btTypedConstraint*>& sortedConstraints = world->m_sortedConstraints;
+				while (constraintOffset < sortedConstraints.size() && GetConstraintIslandId(sortedConstraints[constraintOffset]) < islandId)
+				{
+					constraintOffset++;
+				}
+				const int constraintBegin = constraintOffset;
+				while (constraintOffset < sortedConstraints.size() && GetConstraintIslandId(sortedConstraints[constraintOffset]) == islandId)
+				{
+					constraintOffset++;
+				}
+
+				// Kinematic bodies are not part of islands, but they can touch multiple islands and the solver modifies them, so all of those islands are solved in the same batch:
+				bool kinematic = false;
+				for (int i = 0; i < numManifolds && !kinematic; ++i)
+				{
+					kinematic = manifolds[i]->getBody0()->isKinematicObject() || manifolds[i]->getBody1()->isKinematicObject();
+				}
+				for (int i = constraintBegin; i < constraintOffset && !kinematic; ++i)
+				{
+					kinematic = sortedConstraints[i]->getRigidBodyA().isKinematicObject() || sortedConstraints[i]->getRigidBodyB().isKinematicObject();
+				}
+
+				auto& batches = world->batches;
+				const uint32_t batchIndex = kinematic ? 0 : world->batchCount;
+				if (batches.size() <= batchIndex)
+				{
+					batches.resize(batchIndex + 1);
+				}
+				Batch& batch = batches[batchIndex];
+				batch.bodies.insert(batch.bodies.end(), bodies, bodies + numBodies);
+				batch.manifolds.insert(batch.manifolds.end(), manifolds, manifolds + numManifolds);
+				for (int i = constraintBegin; i < constraintOffset; ++i)
+				{
+					batch.constraints.push_back(sortedConstraints[i]);
+				}
+
+				// Small islands are combined until the batch is large enough to be worth a job:
+				if (!kinematic && int(batch.manifolds.size() + batch.constraints.size()) >= minimumBatchSize)
+				{
+					world->batchCount++;
+				}
+			}
+		};
+	};
+
 	btVector3 gravity(0, -10, 0);
 	int softbodyIterationCount = 5;
 	btSoftBodyRigidBodyCollisionConfiguration collisionConfiguration;
 	btDbvtBroadphase overlappingPairCache;
 	btSequentialImpulseConstraintSolver solver;
-	std::unique_ptr<btCollisionDispatcher> dispatcher;
-	std::unique_ptr<btDynamicsWorld> dynamicsWorld;
+	btDefaultSoftBodySolver softBodySolver;
+	std::unique_ptr<CollisionDispatcher> dispatcher;
+	std::unique_ptr<DynamicsWorld> dynamicsWorld;
+
+	// Asynchronous simulation state:
+	wiJobSystem::context simulationCtx;
+	float simulationAccumulator = 0;
+	float interpolationAlpha = 1;
+	std::vector<std::function<void()>> deferredCommands; // commands that modify the simulation are deferred while it is running
 
 	class DebugDraw : public btIDebugDraw
 	{
@@ -66,8 +357,8 @@ namespace wiPhysicsEngine
 
 	void Initialize()
 	{
-		dispatcher = std::make_unique<btCollisionDispatcher>(&collisionConfiguration);
-		dynamicsWorld = std::make_unique<btSoftRigidDynamicsWorld>(dispatcher.get(), &overlappingPairCache, &solver, &collisionConfiguration);
+		dispatcher = std::make_unique<CollisionDispatcher>(&collisionConfiguration);
+		dynamicsWorld = std::make_unique<DynamicsWorld>(dispatcher.get(), &overlappingPairCache, &solver, &collisionConfiguration, &softBodySolver);
 
 		dynamicsWorld->getSolverInfo().m_solverMode |= SOLVER_RANDMIZE_ORDER;
 		dynamicsWorld->getDispatchInfo().m_enableSatConvex = true;
@@ -75,6 +366,9 @@ namespace wiPhysicsEngine
 
 		dynamicsWorld->setGravity(gravity);
 
+		// The asynchronous simulation is background work, other threads shouldn't wait for it:
+		simulationCtx.priority = wiJobSystem::Priority::Low;
+
 		btSoftRigidDynamicsWorld* softRigidWorld = (btSoftRigidDynamicsWorld*)dynamicsWorld.get();
 		btSoftBodyWorldInfo& softWorldInfo = softRigidWorld->getWorldInfo();
 		softWorldInfo.air_density = btScalar(1.2f);
@@ -98,10 +392,227 @@ namespace wiPhysicsEngine
 	bool IsDebugDrawEnabled() { return DEBUGDRAW_ENABLED; }
 	void SetDebugDrawEnabled(bool value) { DEBUGDRAW_ENABLED = value; }
 
+	bool IsMultithreadingEnabled() { return MULTITHREADING_ENABLED; }
+	void SetMultithreadingEnabled(bool value) { MULTITHREADING_ENABLED = value; }
+
+	bool IsDeterministic() { return DETERMINISTIC; }
+	void SetDeterministic(bool value) { DETERMINISTIC = value; }
+
+	bool IsAsyncEnabled() { return ASYNC_ENABLED; }
+	void SetAsyncEnabled(bool value) { ASYNC_ENABLED = value; }
+
+	float GetFixedTimestep() { return FIXED_TIMESTEP; }
+	void SetFixedTimestep(float value) { FIXED_TIMESTEP = std::max(0.0001f, value); }
+
 	int GetAccuracy() { return ACCURACY; }
 	void SetAccuracy(int value) { ACCURACY = value; }
 
-	void AddRigidBody(Entity entity, wiScene::RigidBodyPhysicsComponent& physicscomponent, const wiScene::TransformComponent& transform, const wiScene::MeshComponent* mesh)
+	// Simplified convex hull of a mesh, with at most maxVertexCount vertices
+	//	The hull is made of the extreme vertices of the mesh in evenly distributed directions (on a fibonacci sphere)
+	void ComputeConvexHull(const MeshComponent& mesh, uint32_t maxVertexCount, std::vector<XMFLOAT3>& result)
+	{
+		result.clear();
+		maxVertexCount = std::max(4u, maxVertexCount);
+		if (mesh.vertex_positions.size() <= maxVertexCount)
+		{
+			result = mesh.vertex_positions;
+			return;
+		}
+
+		std::vector<uint8_t> selected(mesh.vertex_positions.size(), 0);
+		const float goldenAngle = XM_PI * (3 - std::sqrt(5.0f));
+		for (uint32_t i = 0; i < maxVertexCount; ++i)
+		{
+			const float y = 1 - (i + 0.5f) / maxVertexCount * 2;
+			const float radius = std::sqrt(1 - y * y);
+			const float theta = goldenAngle * i;
+			const XMVECTOR D = XMVectorSet(std::cos(theta) * radius, y, std::sin(theta) * radius, 0);
+
+			size_t support = 0;
+			float maxDistance = std::numeric_limits<float>::lowest();
+			for (size_t j = 0; j < mesh.vertex_positions.size(); ++j)
+			{
+				const float distance = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&mesh.vertex_positions[j]), D));
+				if (distance > maxDistance)
+				{
+					maxDistance = distance;
+					support = j;
+				}
+			}
+			if (!selected[support])
+			{
+				selected[support] = 1;
+				result.push_back(mesh.vertex_positions[support]);
+			}
+		}
+	}
+
+	void CookConvexHull(MeshComponent& mesh, uint32_t maxVertexCount)
+	{
+		ComputeConvexHull(mesh, maxVertexCount, mesh.convexhull_positions);
+		mesh.revision++;
+	}
+
+	// Collision shapes that are created from meshes are shared by the rigid bodies that use the same mesh:
+	//	Triangle meshes are shared regardless of scale, and every rigid body references them through its own btScaledBvhTriangleMeshShape
+	//	Convex hulls are shared by the rigid bodies that have the same scale
+	//	The mesh revision is part of the key, so new rigid bodies don't get the shapes of a mesh that was cooked or edited since
+	//	The shared shapes are accessed under the physicsLock
+	struct ShapeCacheKey
+	{
+		Entity mesh = INVALID_ENTITY;
+		RigidBodyPhysicsComponent::CollisionShape shape = RigidBodyPhysicsComponent::CollisionShape::BOX;
+		XMFLOAT3 scale = XMFLOAT3(1, 1, 1);
+		uint32_t revision = 0;
+
+		bool operator==(const ShapeCacheKey& other) const
+		{
+			return mesh == other.mesh && revision == other.revision && shape == other.shape && scale.x == other.scale.x && scale.y == other.scale.y && scale.z == other.scale.z;
+		}
+	};
+	struct ShapeCacheKeyHasher
+	{
+		size_t operator()(const ShapeCacheKey& key) const
+		{
+			size_t hash = 0;
+			wiHelper::hash_combine(hash, key.mesh);
+			wiHelper::hash_combine(hash, key.revision);
+			wiHelper::hash_combine(hash, (int)key.shape);
+			wiHelper::hash_combine(hash, key.scale.x);
+			wiHelper::hash_combine(hash, key.scale.y);
+			wiHelper::hash_combine(hash, key.scale.z);
+			return hash;
+		}
+	};
+	struct ShapeCacheEntry
+	{
+		ShapeCacheKey key;
+		uint32_t refCount = 0;
+		std::unique_ptr<btCollisionShape> shape;
+
+		// Triangle mesh data that is referenced by the shape:
+		std::vector<btVector3> vertices;
+		std::vector<int> indices;
+		std::unique_ptr<btTriangleIndexVertexArray> indexVertexArray;
+	};
+	std::unordered_map<ShapeCacheKey, std::unique_ptr<ShapeCacheEntry>, ShapeCacheKeyHasher> shapeCache;
+
+	btCollisionShape* AcquireMeshShape(const ShapeCacheKey& key, const MeshComponent& mesh)
+	{
+		auto& entry = shapeCache[key];
+		if (entry == nullptr)
+		{
+			entry = std::make_unique<ShapeCacheEntry>();
+			entry->key = key;
+
+			if (key.shape == RigidBodyPhysicsComponent::CollisionShape::CONVEX_HULL)
+			{
+				// The cooked convex hull is used if it's available, otherwise it is computed now:
+				std::vector<XMFLOAT3> hull;
+				if (mesh.convexhull_positions.empty())
+				{
+					ComputeConvexHull(mesh, 256, hull);
+				}
+				const std::vector<XMFLOAT3>& points = mesh.convexhull_positions.empty() ? hull : mesh.convexhull_positions;
+
+				btConvexHullShape* convexhull = new btConvexHullShape();
+				for (auto& pos : points)
+				{
+					convexhull->addPoint(btVector3(pos.x, pos.y, pos.z), false);
+				}
+				convexhull->setLocalScaling(btVector3(key.scale.x, key.scale.y, key.scale.z));
+				entry->shape.reset(convexhull);
+			}
+			else
+			{
+				entry->vertices.reserve(mesh.vertex_positions.size());
+				for (auto& pos : mesh.vertex_positions)
+				{
+					entry->vertices.push_back(btVector3(pos.x, pos.y, pos.z));
+				}
+				entry->indices.assign(mesh.indices.begin(), mesh.indices.end());
+
+				entry->indexVertexArray = std::make_unique<btTriangleIndexVertexArray>(
+					(int)entry->indices.size() / 3,
+					entry->indices.data(),
+					3 * sizeof(int),
+					(int)entry->vertices.size(),
+					(btScalar*)entry->vertices.data(),
+					sizeof(btVector3)
+				);
+
+				bool useQuantizedAabbCompression = true;
+				entry->shape = std::make_unique<btBvhTriangleMeshShape>(entry->indexVertexArray.get(), useQuantizedAabbCompression);
+			}
+
+			entry->shape->setUserPointer(entry.get());
+		}
+		entry->refCount++;
+		return entry->shape.get();
+	}
+	void ReleaseShape(btCollisionShape* shape)
+	{
+		btCollisionShape* sharedShape = shape;
+		if (shape->getShapeType() == SCALED_TRIANGLE_MESH_SHAPE_PROXYTYPE)
+		{
+			sharedShape = ((btScaledBvhTriangleMeshShape*)shape)->getChildShape();
+			delete shape;
+		}
+
+		ShapeCacheEntry* entry = (ShapeCacheEntry*)sharedShape->getUserPointer();
+		if (entry == nullptr)
+		{
+			// Not shared:
+			delete sharedShape;
+			return;
+		}
+
+		assert(entry->refCount > 0);
+		entry->refCount--;
+		if (entry->refCount == 0)
+		{
+			shapeCache.erase(entry->key);
+		}
+	}
+	void UpdateScaling(const Scene& scene, btRigidBody* rigidbody, const XMFLOAT3& scale)
+	{
+		btCollisionShape* shape = rigidbody->getCollisionShape();
+		const btVector3 S(scale.x, scale.y, scale.z);
+		if (shape->getLocalScaling() == S)
+		{
+			return;
+		}
+
+		const ShapeCacheEntry* entry = (const ShapeCacheEntry*)shape->getUserPointer();
+		if (entry != nullptr && entry->key.shape == RigidBodyPhysicsComponent::CollisionShape::CONVEX_HULL)
+		{
+			// The shared convex hull can't be scaled, it is replaced by the one with the new scale:
+			std::lock_guard<std::mutex> lock(physicsLock);
+			const MeshComponent* mesh = scene.meshes.GetComponent(entry->key.mesh);
+			if (mesh == nullptr)
+			{
+				return;
+			}
+			ShapeCacheKey key = entry->key;
+			key.scale = scale;
+			key.revision = mesh->revision;
+			rigidbody->setCollisionShape(AcquireMeshShape(key, *mesh));
+			ReleaseShape(shape);
+		}
+		else
+		{
+			shape->setLocalScaling(S);
+		}
+	}
+	void RemoveRigidBody(btRigidBody* rigidbody)
+	{
+		dynamicsWorld->removeRigidBody(rigidbody);
+		ReleaseShape(rigidbody->getCollisionShape());
+		delete rigidbody->getMotionState();
+		delete rigidbody;
+	}
+
+	void AddRigidBody(Entity entity, wiScene::RigidBodyPhysicsComponent& physicscomponent, const wiScene::TransformComponent& transform, Entity meshID, const wiScene::MeshComponent* mesh)
 	{
 		btCollisionShape* shape = nullptr;
 
@@ -126,13 +637,12 @@ namespace wiPhysicsEngine
 		case RigidBodyPhysicsComponent::CollisionShape::CONVEX_HULL:
 			if(mesh != nullptr)
 			{
-				shape = new btConvexHullShape();
-				for (auto& pos : mesh->vertex_positions)
-				{
-					((btConvexHullShape*)shape)->addPoint(btVector3(pos.x, pos.y, pos.z));
-				}
-				btVector3 S(transform.scale_local.x, transform.scale_local.y, transform.scale_local.z);
-				shape->setLocalScaling(S);
+				ShapeCacheKey key;
+				key.mesh = meshID;
+				key.shape = physicscomponent.shape;
+				key.scale = transform.scale_local;
+				key.revision = mesh->revision;
+				shape = AcquireMeshShape(key, *mesh);
 			}
 			else
 			{
@@ -144,39 +654,14 @@ namespace wiPhysicsEngine
 		case RigidBodyPhysicsComponent::CollisionShape::TRIANGLE_MESH:
 			if(mesh != nullptr)
 			{
-				int totalVerts = (int)mesh->vertex_positions.size();
-				int totalTriangles = (int)mesh->indices.size() / 3;
-
-				btVector3* btVerts = new btVector3[totalVerts];
-				size_t i = 0;
-				for (auto& pos : mesh->vertex_positions)
-				{
-					btVerts[i++] = btVector3(pos.x, pos.y, pos.z);
-				}
-
-				int* btInd = new int[mesh->indices.size()];
-				i = 0;
-				for (auto& ind : mesh->indices)
-				{
-					btInd[i++] = ind;
-				}
+				ShapeCacheKey key;
+				key.mesh = meshID;
+				key.shape = physicscomponent.shape;
+				key.revision = mesh->revision;
+				btBvhTriangleMeshShape* trianglemesh = (btBvhTriangleMeshShape*)AcquireMeshShape(key, *mesh);
 
-				int vertStride = sizeof(btVector3);
-				int indexStride = 3 * sizeof(int);
-
-				btTriangleIndexVertexArray* indexVertexArrays = new btTriangleIndexVertexArray(
-					totalTriangles,
-					btInd,
-					indexStride,
-					totalVerts,
-					(btScalar*)&btVerts[0].x(),
-					vertStride
-				);
-
-				bool useQuantizedAabbCompression = true;
-				shape = new btBvhTriangleMeshShape(indexVertexArrays, useQuantizedAabbCompression);
 				btVector3 S(transform.scale_local.x, transform.scale_local.y, transform.scale_local.z);
-				shape->setLocalScaling(S);
+				shape = new btScaledBvhTriangleMeshShape(trianglemesh, S);
 			}
 			else
 			{
@@ -210,7 +695,7 @@ namespace wiPhysicsEngine
 			shapeTransform.setIdentity();
 			shapeTransform.setOrigin(btVector3(transform.translation_local.x, transform.translation_local.y, transform.translation_local.z));
 			shapeTransform.setRotation(btQuaternion(transform.rotation_local.x, transform.rotation_local.y, transform.rotation_local.z, transform.rotation_local.w));
-			btDefaultMotionState* myMotionState = new btDefaultMotionState(shapeTransform);
+			MotionState* myMotionState = new MotionState(shapeTransform);
 
 			btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, myMotionState, shape, localInertia);
 			//rbInfo.m_friction = physicscomponent.friction;
@@ -342,10 +827,26 @@ namespace wiPhysicsEngine
 
 		auto range = wiProfiler::BeginRangeCPU("Physics");
 
+		// The asynchronous simulation that was started in the previous update must finish before the physics state can be accessed:
+		wiJobSystem::Wait(simulationCtx);
+
+		physicsLock.lock();
+		std::vector<std::function<void()>> commands = std::move(deferredCommands);
+		deferredCommands.clear();
+		physicsLock.unlock();
+		for (auto& command : commands)
+		{
+			command();
+		}
+
 		btVector3 wind = btVector3(scene.weather.windDirection.x, scene.weather.windDirection.y, scene.weather.windDirection.z);
 
+		// The order of the collision objects in the world affects the simulation, so in deterministic mode the bodies are registered in component order by single jobs:
+		const uint32_t rigidbodyGroupSize = IsDeterministic() ? std::max(1u, (uint32_t)scene.rigidbodies.GetCount()) : 256;
+		const uint32_t softbodyGroupSize = IsDeterministic() ? std::max(1u, (uint32_t)scene.softbodies.GetCount()) : 1;
+
 		// System will register rigidbodies to objects, and update physics engine state for kinematics:
-		wiJobSystem::Dispatch(ctx, (uint32_t)scene.rigidbodies.GetCount(), 256, [&](wiJobArgs args) {
+		wiJobSystem::Dispatch(ctx, (uint32_t)scene.rigidbodies.GetCount(), rigidbodyGroupSize, [&](wiJobArgs args) {
 
 			RigidBodyPhysicsComponent& physicscomponent = scene.rigidbodies[args.jobIndex];
 			Entity entity = scene.rigidbodies.GetEntity(args.jobIndex);
@@ -354,13 +855,15 @@ namespace wiPhysicsEngine
 			{
 				TransformComponent& transform = *scene.transforms.GetComponent(entity);
 				const ObjectComponent* object = scene.objects.GetComponent(entity);
+				Entity meshID = INVALID_ENTITY;
 				const MeshComponent* mesh = nullptr;
 				if (object != nullptr)
 				{
-					mesh = scene.meshes.GetComponent(object->meshID);
+					meshID = object->meshID;
+					mesh = scene.meshes.GetComponent(meshID);
 				}
 				physicsLock.lock();
-				AddRigidBody(entity, physicscomponent, transform, mesh);
+				AddRigidBody(entity, physicscomponent, transform, meshID, mesh);
 				physicsLock.unlock();
 			}
 
@@ -408,16 +911,18 @@ namespace wiPhysicsEngine
 						rigidbody->setWorldTransform(physicsTransform);
 					}
 
-					btCollisionShape* shape = rigidbody->getCollisionShape();
-					XMFLOAT3 scale = transform.GetScale();
-					btVector3 S(scale.x, scale.y, scale.z);
-					shape->setLocalScaling(S);
+					UpdateScaling(scene, rigidbody, transform.GetScale());
 				}
 			}
 		});
 
+		if (IsDeterministic())
+		{
+			wiJobSystem::Wait(ctx);
+		}
+
 		// System will register softbodies to meshes and update physics engine state:
-		wiJobSystem::Dispatch(ctx, (uint32_t)scene.softbodies.GetCount(), 1, [&](wiJobArgs args) {
+		wiJobSystem::Dispatch(ctx, (uint32_t)scene.softbodies.GetCount(), softbodyGroupSize, [&](wiJobArgs args) {
 
 			SoftBodyPhysicsComponent& physicscomponent = scene.softbodies[args.jobIndex];
 			Entity entity = scene.softbodies.GetEntity(args.jobIndex);
@@ -484,7 +989,8 @@ namespace wiPhysicsEngine
 		wiJobSystem::Wait(ctx);
 
 		// Perform internal simulation step:
-		if (IsSimulationEnabled())
+		//	In asynchronous mode, the results of the previous update's simulation are used and the next simulation will be started at the end
+		if (IsSimulationEnabled() && !IsAsyncEnabled())
 		{
 			dynamicsWorld->stepSimulation(dt, ACCURACY);
 		}
@@ -501,7 +1007,7 @@ namespace wiPhysicsEngine
 				RigidBodyPhysicsComponent* physicscomponent = scene.rigidbodies.GetComponent(entity);
 				if (physicscomponent == nullptr || physicscomponent->physicsobject != rigidbody)
 				{
-					dynamicsWorld->removeRigidBody(rigidbody);
+					RemoveRigidBody(rigidbody);
 					i--;
 					continue;
 				}
@@ -512,11 +1018,24 @@ namespace wiPhysicsEngine
 					TransformComponent& transform = *scene.transforms.GetComponent(entity);
 
 					btMotionState* motionState = rigidbody->getMotionState();
-					btTransform physicsTransform;
+					btVector3 T;
+					btQuaternion R;
 
-					motionState->getWorldTransform(physicsTransform);
-					btVector3 T = physicsTransform.getOrigin();
-					btQuaternion R = physicsTransform.getRotation();
+					if (IsAsyncEnabled())
+					{
+						// Interpolate between the last two simulated states:
+						const btTransform& previousTransform = ((MotionState*)motionState)->previousTransform;
+						const btTransform& currentTransform = rigidbody->getWorldTransform();
+						T = previousTransform.getOrigin().lerp(currentTransform.getOrigin(), interpolationAlpha);
+						R = previousTransform.getRotation().slerp(currentTransform.getRotation(), interpolationAlpha);
+					}
+					else
+					{
+						btTransform physicsTransform;
+						motionState->getWorldTransform(physicsTransform);
+						T = physicsTransform.getOrigin();
+						R = physicsTransform.getRotation();
+					}
 
 					transform.translation_local = XMFLOAT3(T.x(), T.y(), T.z());
 					transform.rotation_local = XMFLOAT4(R.x(), R.y(), R.z(), R.w());
@@ -644,11 +1163,56 @@ namespace wiPhysicsEngine
 			dynamicsWorld->debugDrawWorld();
 		}
 
+		// Start the asynchronous simulation with the steps that fit into the elapsed time, it will run until the next update:
+		if (IsSimulationEnabled() && IsAsyncEnabled())
+		{
+			const float timestep = GetFixedTimestep();
+			simulationAccumulator += dt;
+			int stepCount = int(simulationAccumulator / timestep);
+			if (stepCount > ACCURACY)
+			{
+				// Simulation can't keep up, the rest of the time is dropped:
+				stepCount = ACCURACY;
+				simulationAccumulator = stepCount * timestep;
+			}
+			simulationAccumulator -= stepCount * timestep;
+			interpolationAlpha = std::min(1.0f, simulationAccumulator / timestep);
+
+			if (stepCount > 0)
+			{
+				wiJobSystem::Execute(simulationCtx, [stepCount, timestep](wiJobArgs args) {
+					auto range = wiProfiler::BeginRangeCPU("Physics Simulation");
+					dynamicsWorld->StepFixed(stepCount, timestep);
+					wiProfiler::EndRange(range);
+				});
+			}
+		}
+		else
+		{
+			simulationAccumulator = 0;
+			interpolationAlpha = 1;
+		}
+
 		wiProfiler::EndRange(range); // Physics
 	}
 
 
 
+	// Executes a command that modifies the simulation, or defers it until the asynchronous simulation is finished
+	template<typename T>
+	void Command(T command)
+	{
+		if (IsAsyncEnabled() || wiJobSystem::IsBusy(simulationCtx))
+		{
+			std::lock_guard<std::mutex> lock(physicsLock);
+			deferredCommands.push_back(command);
+		}
+		else
+		{
+			command();
+		}
+	}
+
 	void ApplyForce(
 		const wiScene::RigidBodyPhysicsComponent& physicscomponent,
 		const XMFLOAT3& force
@@ -657,7 +1221,7 @@ namespace wiPhysicsEngine
 		if (physicscomponent.physicsobject != nullptr)
 		{
 			btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
-			rigidbody->applyCentralForce(btVector3(force.x, force.y, force.z));
+			Command([=] { rigidbody->applyCentralForce(btVector3(force.x, force.y, force.z)); });
 		}
 	}
 	void ApplyForceAt(
@@ -669,7 +1233,7 @@ namespace wiPhysicsEngine
 		if (physicscomponent.physicsobject != nullptr)
 		{
 			btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
-			rigidbody->applyForce(btVector3(force.x, force.y, force.z), btVector3(at.x, at.y, at.z));
+			Command([=] { rigidbody->applyForce(btVector3(force.x, force.y, force.z), btVector3(at.x, at.y, at.z)); });
 		}
 	}
 
@@ -681,7 +1245,7 @@ namespace wiPhysicsEngine
 		if (physicscomponent.physicsobject != nullptr)
 		{
 			btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
-			rigidbody->applyCentralImpulse(btVector3(impulse.x, impulse.y, impulse.z));
+			Command([=] { rigidbody->applyCentralImpulse(btVector3(impulse.x, impulse.y, impulse.z)); });
 		}
 	}
 	void ApplyImpulseAt(
@@ -693,7 +1257,7 @@ namespace wiPhysicsEngine
 		if (physicscomponent.physicsobject != nullptr)
 		{
 			btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
-			rigidbody->applyImpulse(btVector3(impulse.x, impulse.y, impulse.z), btVector3(at.x, at.y, at.z));
+			Command([=] { rigidbody->applyImpulse(btVector3(impulse.x, impulse.y, impulse.z), btVector3(at.x, at.y, at.z)); });
 		}
 	}
 
@@ -6,6 +6,7 @@
 #include "wiTimer.h"
 #include "wiTextureHelper.h"
 #include "wiHelper.h"
+#include "wiBackLog.h"
 
 #include <string>
 #include <unordered_map>
@@ -13,6 +14,9 @@
 #include <mutex>
 #include <atomic>
 #include <sstream>
+#include <chrono>
+#include <memory>
+#include <cstdio>
 
 using namespace wiGraphics;
 
@@ -39,6 +43,7 @@ namespace wiProfiler
 		CommandList cmd = COMMANDLIST_COUNT;
 
 		wiTimer cpuBegin, cpuEnd;
+		const char* trace_name = nullptr; // the name that was given to BeginRangeCPU(), referred by trace events
 
 		int gpuBegin[arraysize(queryHeap)];
 		int gpuEnd[arraysize(queryHeap)];
@@ -47,8 +52,238 @@ namespace wiProfiler
 	};
 	std::unordered_map<size_t, Range> ranges;
 
+	namespace Trace
+	{
+		using clock = std::chrono::high_resolution_clock; // the same as wiTimer, so profiling ranges can be recorded as events
+		static constexpr uint64_t EVENT_CAPACITY = 1 << 16; // the number of events that a thread can record in one frame
+		static constexpr uint32_t MAX_DEPTH = 64;
+
+		struct Event
+		{
+			const char* name;
+			clock::time_point begin;
+			clock::time_point end;
+		};
+
+		// Events of one thread: only the owner thread writes them, and the main thread collects them at the end of the frame
+		struct ThreadEvents
+		{
+			uint32_t tid = 0;
+			std::string name;
+			std::atomic<uint64_t> head{ 0 }; // number of events written (ring buffer)
+			uint64_t tail = 0; // number of events collected
+
+			struct OpenEvent
+			{
+				const char* name; // nullptr if the event was started while not recording
+				clock::time_point begin;
+			};
+			OpenEvent stack[MAX_DEPTH];
+			uint32_t depth = 0;
+
+			Event events[EVENT_CAPACITY];
+		};
+
+		std::atomic<bool> recording{ false };
+		std::mutex locker; // locked when a thread records its first event, and when events are collected
+		std::vector<std::unique_ptr<ThreadEvents>> threads;
+		thread_local ThreadEvents* thread_events = nullptr;
+		thread_local std::string thread_name;
+
+		// Capture state, only accessed on the main thread:
+		std::string filename;
+		uint32_t frames_requested = 0;
+		uint32_t frames_remaining = 0;
+		uint64_t frame_index = 0;
+		bool frame_event = false;
+		clock::time_point start;
+		std::string json;
+
+		ThreadEvents* GetThreadEvents()
+		{
+			if (thread_events == nullptr)
+			{
+				auto events = std::make_unique<ThreadEvents>();
+				locker.lock();
+				events->tid = (uint32_t)threads.size();
+				events->name = thread_name.empty() ? "Thread " + std::to_string(events->tid) : thread_name;
+				thread_events = events.get();
+				threads.push_back(std::move(events));
+				locker.unlock();
+			}
+			return thread_events;
+		}
+
+		inline void Write(ThreadEvents* events, const char* name, clock::time_point begin, clock::time_point end)
+		{
+			const uint64_t head = events->head.load(std::memory_order_relaxed);
+			Event& event = events->events[head % EVENT_CAPACITY];
+			event.name = name;
+			event.begin = begin;
+			event.end = end;
+			events->head.store(head + 1, std::memory_order_release);
+		}
+
+		inline double Microseconds(clock::time_point time)
+		{
+			return std::chrono::duration<double, std::micro>(time - start).count();
+		}
+
+		void AppendEvent(std::string& dest, const char* str)
+		{
+			if (!dest.empty())
+			{
+				dest += ",\n";
+			}
+			dest += str;
+		}
+
+		std::string Escape(const char* name)
+		{
+			std::string result;
+			for (const char* c = name; *c != 0; ++c)
+			{
+				if (*c == '"' || *c == '\\')
+				{
+					result += '\\';
+				}
+				result += *c;
+			}
+			return result;
+		}
+
+		// Moves the recorded events of all threads into the JSON, called on the main thread
+		void Collect()
+		{
+			std::vector<Event> collected;
+			char str[512];
+
+			locker.lock();
+			for (auto& events : threads)
+			{
+				const uint64_t head = events->head.load(std::memory_order_acquire);
+				const uint64_t first = std::max(events->tail, head > EVENT_CAPACITY ? head - EVENT_CAPACITY : 0);
+				collected.clear();
+				for (uint64_t i = first; i < head; ++i)
+				{
+					collected.push_back(events->events[i % EVENT_CAPACITY]);
+				}
+				events->tail = head;
+
+				// If the thread wrapped around the ring buffer while copying, the overwritten events are dropped:
+				const uint64_t head_after = events->head.load(std::memory_order_acquire);
+				if (head_after >= EVENT_CAPACITY && head_after - EVENT_CAPACITY >= first)
+				{
+					const size_t overwritten = size_t(head_after - EVENT_CAPACITY + 1 - first);
+					collected.erase(collected.begin(), collected.begin() + std::min(overwritten, collected.size()));
+				}
+
+				for (auto& event : collected)
+				{
+					if (event.end < start)
+					{
+						continue; // ended before the capture
+					}
+					const double begin = std::max(0.0, Microseconds(event.begin));
+					const double end = Microseconds(event.end);
+					snprintf(str, sizeof(str), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						Escape(event.name).c_str(), events->tid, begin, std::max(0.0, end - begin));
+					AppendEvent(json, str);
+				}
+			}
+			locker.unlock();
+		}
+
+		void BeginFrame()
+		{
+			if (frames_requested > 0 && !recording.load())
+			{
+				// Start capturing, the events that were recorded before are discarded:
+				locker.lock();
+				for (auto& events : threads)
+				{
+					events->tail = events->head.load(std::memory_order_acquire);
+				}
+				locker.unlock();
+
+				json.clear();
+				start = clock::now();
+				frames_remaining = frames_requested;
+				frames_requested = 0;
+				recording.store(true);
+			}
+			if (!recording.load())
+			{
+				return;
+			}
+
+			if (thread_name.empty())
+			{
+				SetThreadName("Main Thread");
+			}
+
+			char str[256];
+			snprintf(str, sizeof(str), "{\"name\":\"Frame %llu\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+				(unsigned long long)frame_index, GetThreadEvents()->tid, Microseconds(clock::now()));
+			AppendEvent(json, str);
+
+			wiProfiler::BeginEvent("Frame");
+			frame_event = true;
+		}
+
+		void EndFrame()
+		{
+			frame_index++;
+			if (!recording.load())
+			{
+				return;
+			}
+			if (frame_event)
+			{
+				wiProfiler::EndEvent();
+				frame_event = false;
+			}
+
+			Collect();
+
+			frames_remaining--;
+			if (frames_remaining > 0)
+			{
+				return;
+			}
+			recording.store(false);
+
+			std::string output = "{\"traceEvents\":[\n";
+			std::string metadata;
+			char str[512];
+			locker.lock();
+			for (auto& events : threads)
+			{
+				snprintf(str, sizeof(str), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+					events->tid, Escape(events->name.c_str()).c_str());
+				AppendEvent(metadata, str);
+			}
+			locker.unlock();
+			AppendEvent(metadata, json.c_str());
+			output += metadata;
+			output += "\n],\"displayTimeUnit\":\"ms\"}\n";
+			json.clear();
+
+			if (wiHelper::FileWrite(filename, (const uint8_t*)output.data(), output.size()))
+			{
+				wiBackLog::post(("wiProfiler trace captured: " + filename).c_str());
+			}
+			else
+			{
+				wiBackLog::post(("wiProfiler trace capture could not be written: " + filename).c_str());
+			}
+		}
+	}
+
 	void BeginFrame()
 	{
+		Trace::BeginFrame();
+
 		if (!ENABLED)
 			return;
 
@@ -78,7 +313,10 @@ namespace wiProfiler
 	void EndFrame(CommandList cmd)
 	{
 		if (!ENABLED || !initialized)
+		{
+			Trace::EndFrame();
 			return;
+		}
 
 		GraphicsDevice* device = wiRenderer::GetDevice();
 
@@ -137,6 +375,9 @@ namespace wiProfiler
 
 			range.in_use = false;
 		}
+
+		// The trace is collected after the frame ranges ended:
+		Trace::EndFrame();
 	}
 
 	range_id BeginRangeCPU(const char* name)
@@ -156,6 +397,7 @@ namespace wiProfiler
 		}
 		ranges[id].in_use = true;
 		ranges[id].name = name;
+		ranges[id].trace_name = name;
 
 		ranges[id].cpuBegin.record();
 
@@ -203,6 +445,10 @@ namespace wiProfiler
 			if (it->second.IsCPURange())
 			{
 				it->second.cpuEnd.record();
+				if (Trace::recording.load(std::memory_order_relaxed))
+				{
+					Trace::Write(Trace::GetThreadEvents(), it->second.trace_name, it->second.cpuBegin.timestamp, it->second.cpuEnd.timestamp);
+				}
 			}
 			else
 			{
@@ -317,4 +563,72 @@ namespace wiProfiler
 		return ENABLED;
 	}
 
+	void BeginEvent(const char* name)
+	{
+		Trace::ThreadEvents* events = Trace::thread_events;
+		const bool recording = Trace::recording.load(std::memory_order_relaxed);
+		if (events == nullptr)
+		{
+			if (!recording)
+			{
+				return;
+			}
+			events = Trace::GetThreadEvents();
+		}
+		if (events->depth < Trace::MAX_DEPTH)
+		{
+			// The nesting is always tracked once the thread has recorded, so that events started before a capture are ended correctly:
+			Trace::ThreadEvents::OpenEvent& event = events->stack[events->depth];
+			event.name = recording ? name : nullptr;
+			if (recording)
+			{
+				event.begin = Trace::clock::now();
+			}
+		}
+		events->depth++;
+	}
+	void EndEvent()
+	{
+		Trace::ThreadEvents* events = Trace::thread_events;
+		if (events == nullptr || events->depth == 0)
+		{
+			return;
+		}
+		events->depth--;
+		if (events->depth < Trace::MAX_DEPTH)
+		{
+			const Trace::ThreadEvents::OpenEvent& event = events->stack[events->depth];
+			if (event.name != nullptr && Trace::recording.load(std::memory_order_relaxed))
+			{
+				Trace::Write(events, event.name, event.begin, Trace::clock::now());
+			}
+		}
+	}
+
+	void SetThreadName(const char* name)
+	{
+		Trace::thread_name = name;
+		if (Trace::thread_events != nullptr)
+		{
+			Trace::locker.lock();
+			Trace::thread_events->name = name;
+			Trace::locker.unlock();
+		}
+	}
+
+	void CaptureTrace(const std::string& filename, uint32_t frame_count)
+	{
+		if (frame_count == 0 || Trace::recording.load())
+		{
+			return;
+		}
+		Trace::filename = filename;
+		Trace::frames_requested = frame_count;
+	}
+
+	bool IsCapturingTrace()
+	{
+		return Trace::frames_requested > 0 || Trace::recording.load();
+	}
+
 }
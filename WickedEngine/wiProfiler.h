@@ -2,6 +2,8 @@
 #include "wiGraphicsDevice.h"
 #include "wiCanvas.h"
 
+#include <string>
+
 namespace wiProfiler
 {
 	typedef size_t range_id;
@@ -13,6 +15,7 @@ namespace wiProfiler
 	void EndFrame(wiGraphics::CommandList cmd);
 
 	// Start a CPU profiling range
+	//	name : must remain valid until the end of the frame (for example a string literal), because trace captures refer to it
 	range_id BeginRangeCPU(const char* name);
 
 	// Start a GPU profiling range
@@ -28,5 +31,31 @@ namespace wiProfiler
 	void SetEnabled(bool value);
 
 	bool IsEnabled();
+
+	// Start a CPU event on the current thread, it is only recorded while a trace is captured (see CaptureTrace())
+	//	Events are recorded into per-thread buffers without locking, events on the same thread can be nested
+	//	name : must remain valid until the end of the frame (for example a string literal)
+	void BeginEvent(const char* name);
+
+	// End the last CPU event that was started on the current thread
+	void EndEvent();
+
+	// CPU event that lasts until the end of the scope
+	struct ScopedEvent
+	{
+		ScopedEvent(const char* name) { BeginEvent(name); }
+		~ScopedEvent() { EndEvent(); }
+	};
+
+	// Set the name of the current thread that is displayed in captured traces
+	void SetThreadName(const char* name);
+
+	// Capture the CPU events of all threads for frame_count frames starting with the next frame, and write them to a Chrome trace JSON file
+	//	The file can be opened with chrome://tracing or https://ui.perfetto.dev
+	//	wiJobSystem jobs and frames are recorded, and also the CPU profiling ranges when the profiler is enabled
+	void CaptureTrace(const std::string& filename, uint32_t frame_count = 1);
+
+	// Returns true if a trace capture is requested or in progress
+	bool IsCapturingTrace();
 };
 
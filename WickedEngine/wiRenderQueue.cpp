@@ -0,0 +1,166 @@
+#include "wiRenderQueue.h"
+#include "wiJobSystem.h"
+
+#include <vector>
+
+namespace wiRenderQueue_Internal
+{
+	static constexpr uint32_t RADIX_SORT_THRESHOLD = 256; // below this batch count, comparison sort is faster
+	static constexpr uint32_t PARALLEL_SORT_THRESHOLD = 32768; // above this batch count, radix sort passes are parallelized
+	static constexpr uint32_t RADIX_BITS = 8;
+	static constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+	static constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	inline uint32_t GetDigit(uint64_t key, uint32_t pass)
+	{
+		return uint32_t(key >> uint64_t(pass * RADIX_BITS)) & (RADIX_SIZE - 1);
+	}
+
+	// Stable counting sort by one digit, src and dst are disjoint:
+	void RadixPass(const SortEntry* src, SortEntry* dst, uint32_t count, uint32_t pass)
+	{
+		uint32_t offsets[RADIX_SIZE] = {};
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			offsets[GetDigit(src[i].key, pass)]++;
+		}
+		uint32_t sum = 0;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+		{
+			const uint32_t digitCount = offsets[digit];
+			offsets[digit] = sum;
+			sum += digitCount;
+		}
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			dst[offsets[GetDigit(src[i].key, pass)]++] = src[i];
+		}
+	}
+
+	// The same as RadixPass(), but every group of entries is counted and scattered in a separate job
+	//	Groups write to disjoint ranges of every digit bucket in group order, so the pass stays stable
+	void RadixPassParallel(wiJobSystem::context& ctx, const SortEntry* src, SortEntry* dst, uint32_t count, uint32_t pass, uint32_t groupSize)
+	{
+		const uint32_t groupCount = wiJobSystem::DispatchGroupCount(count, groupSize);
+		std::vector<uint32_t> histograms(groupCount * RADIX_SIZE); // [group][digit]
+
+		wiJobSystem::Dispatch(ctx, groupCount, 1, [&](wiJobArgs args) {
+			uint32_t* histogram = histograms.data() + args.jobIndex * RADIX_SIZE;
+			std::fill(histogram, histogram + RADIX_SIZE, 0);
+			const uint32_t begin = args.jobIndex * groupSize;
+			const uint32_t end = std::min(begin + groupSize, count);
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				histogram[GetDigit(src[i].key, pass)]++;
+			}
+		});
+		wiJobSystem::Wait(ctx);
+
+		// Exclusive prefix sum in digit major, group minor order:
+		uint32_t sum = 0;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+		{
+			for (uint32_t group = 0; group < groupCount; ++group)
+			{
+				uint32_t& offset = histograms[group * RADIX_SIZE + digit];
+				const uint32_t digitCount = offset;
+				offset = sum;
+				sum += digitCount;
+			}
+		}
+
+		wiJobSystem::Dispatch(ctx, groupCount, 1, [&](wiJobArgs args) {
+			uint32_t* offsets = histograms.data() + args.jobIndex * RADIX_SIZE;
+			const uint32_t begin = args.jobIndex * groupSize;
+			const uint32_t end = std::min(begin + groupSize, count);
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				dst[offsets[GetDigit(src[i].key, pass)]++] = src[i];
+			}
+		});
+		wiJobSystem::Wait(ctx);
+	}
+}
+using namespace wiRenderQueue_Internal;
+
+void RenderQueue::sort(RenderQueueSortType sortType)
+{
+	if (batchCount <= 1)
+	{
+		return;
+	}
+
+	if (batchCount < RADIX_SORT_THRESHOLD)
+	{
+		if (sortType == SORT_FRONT_TO_BACK)
+		{
+			std::sort(batchArray, batchArray + batchCount, [](const RenderBatch& a, const RenderBatch& b) {
+				return a.GetSortKeyFrontToBack() < b.GetSortKeyFrontToBack();
+			});
+		}
+		else
+		{
+			std::sort(batchArray, batchArray + batchCount, [](const RenderBatch& a, const RenderBatch& b) {
+				return a.GetSortKeyBackToFront() < b.GetSortKeyBackToFront();
+			});
+		}
+		return;
+	}
+
+	const bool parallel = batchCount >= PARALLEL_SORT_THRESHOLD;
+	const uint32_t groupSize = std::max(4096u, batchCount / std::max(1u, wiJobSystem::GetThreadCount() * 2));
+	wiJobSystem::context ctx;
+
+	// Scratch memory is not reused between calls, because the wait inside a parallel sort can start sorting an other queue on the same thread:
+	std::vector<SortEntry> entries(batchCount);
+	std::vector<SortEntry> entries_temp(batchCount);
+
+	for (uint32_t i = 0; i < batchCount; ++i)
+	{
+		SortEntry& entry = entries[i];
+		entry.key = sortType == SORT_FRONT_TO_BACK ? batchArray[i].GetSortKeyFrontToBack() : batchArray[i].GetSortKeyBackToFront();
+		entry.index = i;
+	}
+
+	// Digits that are the same for every key don't need a pass:
+	uint64_t key_and = ~0ull;
+	uint64_t key_or = 0;
+	for (const SortEntry& entry : entries)
+	{
+		key_and &= entry.key;
+		key_or |= entry.key;
+	}
+	const uint64_t varying_bits = key_and ^ key_or;
+
+	SortEntry* src = entries.data();
+	SortEntry* dst = entries_temp.data();
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		if (GetDigit(varying_bits, pass) == 0)
+		{
+			continue;
+		}
+		if (parallel)
+		{
+			RadixPassParallel(ctx, src, dst, batchCount, pass, groupSize);
+		}
+		else
+		{
+			RadixPass(src, dst, batchCount, pass);
+		}
+		std::swap(src, dst);
+	}
+
+	// Reorder the batches by the sorted entries:
+	std::vector<RenderBatch> batches_temp(batchArray, batchArray + batchCount);
+	for (uint32_t i = 0; i < batchCount; ++i)
+	{
+		batchArray[i] = batches_temp[src[i].index];
+	}
+}
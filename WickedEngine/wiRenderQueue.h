@@ -0,0 +1,78 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+// Direct reference to a renderable instance:
+struct RenderBatch
+{
+	uint32_t meshIndex;
+	uint32_t instanceIndex;
+	uint16_t distance; // quantized distance, see Create()
+
+	inline void Create(size_t meshIndex, size_t instanceIndex, float distance)
+	{
+		assert(meshIndex < 0x00FFFFFF);
+		this->meshIndex = (uint32_t)meshIndex;
+		this->instanceIndex = (uint32_t)instanceIndex;
+
+		// Non-negative floats are ordered the same as their bit patterns, the upper 16 bits keep the exponent and 7 bits of mantissa:
+		distance = std::max(0.0f, distance);
+		uint32_t bits;
+		std::memcpy(&bits, &distance, sizeof(bits));
+		this->distance = uint16_t(bits >> 16u);
+	}
+
+	inline uint32_t GetMeshIndex() const
+	{
+		return meshIndex;
+	}
+	inline uint32_t GetInstanceIndex() const
+	{
+		return instanceIndex;
+	}
+
+	// 64-bit sort key for front to back ordering: [depth bucket: 10][meshIndex: 24][fine distance: 6][unused: 24]
+	//	The depth bucket is the upper 10 bits of the quantized distance (half of a power of two distance range)
+	//	Batches are ordered front to back by the depth bucket (for early depth rejection), and grouped by mesh inside a bucket (for instancing and less state changes)
+	inline uint64_t GetSortKeyFrontToBack() const
+	{
+		return (uint64_t(distance >> 6u) << 54ull) | (uint64_t(meshIndex & 0x00FFFFFF) << 30ull) | (uint64_t(distance & 0x3F) << 24ull);
+	}
+	// 64-bit sort key for back to front ordering: [inverted distance: 16][meshIndex: 24][unused: 24]
+	//	Batches are ordered by distance first (for blending), then grouped by mesh
+	inline uint64_t GetSortKeyBackToFront() const
+	{
+		return (uint64_t(uint16_t(~distance)) << 48ull) | (uint64_t(meshIndex & 0x00FFFFFF) << 24ull);
+	}
+};
+
+// This is just a utility that points to a linear array of render batches:
+struct RenderQueue
+{
+	RenderBatch* batchArray = nullptr;
+	uint32_t batchCount = 0;
+
+	enum RenderQueueSortType
+	{
+		SORT_FRONT_TO_BACK,
+		SORT_BACK_TO_FRONT,
+	};
+
+	inline bool empty() const { return batchArray == nullptr || batchCount == 0; }
+	inline void add(RenderBatch* item)
+	{
+		assert(item != nullptr);
+		if (empty())
+		{
+			batchArray = item;
+		}
+		batchCount++;
+	}
+
+	// Sort the batches by their 64-bit sort keys
+	//	Small queues use comparison sort, larger ones use LSD radix sort, which is parallelized with wiJobSystem for very large queues
+	void sort(RenderQueueSortType sortType = SORT_FRONT_TO_BACK);
+};
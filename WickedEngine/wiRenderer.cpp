@@ -14,6 +14,7 @@
 #include "wiGPUSortLib.h"
 #include "wiAllocators.h"
 #include "wiGPUBVH.h"
+#include "wiRenderQueue.h"
 #include "wiJobSystem.h"
 #include "wiSpinLock.h"
 #include "wiEvent.h"
@@ -30,6 +31,7 @@
 
 #include <algorithm>
 #include <array>
+#include <unordered_map>
 
 using namespace wiGraphics;
 using namespace wiScene;
@@ -274,83 +276,6 @@ GraphicsDevice* GetDevice()
 	return device.get();
 }
 
-// Direct reference to a renderable instance:
-struct RenderBatch
-{
-	uint32_t hash;
-	uint32_t instance;
-
-	inline void Create(size_t meshIndex, size_t instanceIndex, float distance)
-	{
-		hash = 0;
-
-		assert(meshIndex < 0x00FFFFFF);
-		hash |= (uint32_t)(meshIndex & 0x00FFFFFF);
-		hash |= ((uint32_t)distance & 0xFF) << 24;
-
-		instance = (uint32_t)instanceIndex;
-	}
-
-	inline uint32_t GetMeshIndex() const
-	{
-		return hash & 0x00FFFFFF;
-	}
-	inline uint32_t GetInstanceIndex() const
-	{
-		return instance;
-	}
-};
-
-// This is just a utility that points to a linear array of render batches:
-struct RenderQueue
-{
-	RenderBatch* batchArray = nullptr;
-	uint32_t batchCount = 0;
-
-	enum RenderQueueSortType
-	{
-		SORT_FRONT_TO_BACK,
-		SORT_BACK_TO_FRONT,
-	};
-
-	inline bool empty() const { return batchArray == nullptr || batchCount == 0; }
-	inline void add(RenderBatch* item) 
-	{ 
-		assert(item != nullptr); 
-		if (empty())
-		{
-			batchArray = item;
-		}
-		batchCount++; 
-	}
-	inline void sort(RenderQueueSortType sortType = SORT_FRONT_TO_BACK)
-	{
-		if (batchCount > 1)
-		{
-			std::sort(batchArray, batchArray + batchCount, [sortType](const RenderBatch& a, const RenderBatch& b) -> bool {
-				return ((sortType == SORT_FRONT_TO_BACK) ? (a.hash < b.hash) : (a.hash > b.hash));
-			});
-
-			//for (size_t i = 0; i < batchCount - 1; ++i)
-			//{
-			//	for (size_t j = i + 1; j < batchCount; ++j)
-			//	{
-			//		bool swap = false;
-			//		swap = sortType == SORT_FRONT_TO_BACK && batchArray[i].hash > batchArray[j].hash;
-			//		swap = sortType == SORT_BACK_TO_FRONT && batchArray[i].hash < batchArray[j].hash;
-
-			//		if (swap)
-			//		{
-			//			RenderBatch tmp = batchArray[i];
-			//			batchArray[i] = batchArray[j];
-			//			batchArray[j] = tmp;
-			//		}
-			//	}
-			//}
-		}
-	}
-};
-
 struct Instance
 {
 	XMFLOAT4 mat0;
@@ -894,6 +819,12 @@ size_t GetShaderDumpCount()
 
 bool LoadShader(SHADERSTAGE stage, Shader& shader, const std::string& filename, SHADERMODEL minshadermodel)
 {
+	if (device->GetShaderFormat() == SHADERFORMAT_NONE)
+	{
+		// The device doesn't consume shader bytecode (GraphicsDevice_Null), so shaders are not compiled or loaded:
+		return device->CreateShader(stage, nullptr, 0, &shader);
+	}
+
 	std::string shaderbinaryfilename = SHADERPATH + filename;
 
 #ifdef SHADERDUMP_ENABLED
@@ -3235,6 +3166,153 @@ void ProcessDeferredMipGenRequests(CommandList cmd)
 	deferredMIPGenLock.unlock();
 }
 
+// Frustum culling of bounding boxes that are organized into a BVH
+//	The BVH subtrees that intersect the frustum are traversed in parallel, the boxes in the intersected leaves are tested with SIMD
+//	If the BVH is not up to date with the bounding boxes, then the boxes are tested linearly
+//	Visible items are collected into a small local batch first, then written out to the global list, which reduces atomics
+//	make_item	: receives the index of a visible bounding box, returns the element to write into the list
+template<typename T, typename F>
+void CullBoundingBoxes(
+	wiJobSystem::context& ctx,
+	const wiBVH& bvh,
+	const ComponentManager<AABB>& aabbs,
+	const Visibility& vis,
+	T* list,
+	std::atomic<uint32_t>& counter,
+	F make_item
+)
+{
+	static const uint32_t groupSize = 64;
+	const uint32_t count = (uint32_t)aabbs.GetCount();
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::vector<uint32_t> subtrees;
+	const bool use_bvh = bvh.IsValid(count);
+	uint32_t jobCount = 0;
+	if (use_bvh)
+	{
+		bvh.GatherSubtrees(vis.frustum, vis.layerMask, wiJobSystem::GetThreadCount() * 4, subtrees);
+		jobCount = (uint32_t)subtrees.size();
+	}
+	else
+	{
+		jobCount = wiJobSystem::DispatchGroupCount(count, groupSize);
+	}
+
+	wiJobSystem::Dispatch(ctx, jobCount, 1, [=, &bvh, &aabbs, &vis, &counter](wiJobArgs args) {
+
+		T batch[groupSize];
+		uint32_t batch_count = 0;
+		auto flush = [&]() {
+			uint32_t prev_count = counter.fetch_add(batch_count);
+			for (uint32_t i = 0; i < batch_count; ++i)
+			{
+				list[prev_count + i] = batch[i];
+			}
+			batch_count = 0;
+		};
+		auto add = [&](uint32_t index) {
+			batch[batch_count++] = make_item(index);
+			if (batch_count == groupSize)
+			{
+				flush();
+			}
+		};
+
+		if (use_bvh)
+		{
+			bvh.IntersectSubtree(subtrees[args.jobIndex], vis.frustum, vis.layerMask, add);
+		}
+		else
+		{
+			const uint32_t begin = args.jobIndex * groupSize;
+			const uint32_t end = std::min(begin + groupSize, count);
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const AABB& aabb = aabbs[i];
+				if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+				{
+					add(i);
+				}
+			}
+		}
+
+		if (batch_count > 0)
+		{
+			flush();
+		}
+	});
+}
+
+// Gathers the indices of objects that intersect the frustum and layerMask, in ascending order
+//	The scene BVH is used if it is up to date, otherwise every object is tested
+void CullObjects(const Scene& scene, const Frustum& frustum, uint32_t layerMask, std::vector<uint32_t>& result)
+{
+	result.clear();
+	const uint32_t count = (uint32_t)scene.aabb_objects.GetCount();
+	if (count > 0 && scene.bvh_objects.IsValid(count))
+	{
+		scene.bvh_objects.IntersectSubtree(0, frustum, layerMask, [&](uint32_t index) {
+			result.push_back(index);
+		});
+		std::sort(result.begin(), result.end());
+	}
+	else
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const AABB& aabb = scene.aabb_objects[i];
+			if ((aabb.layerMask & layerMask) && frustum.CheckBoxFast(aabb))
+			{
+				result.push_back(i);
+			}
+		}
+	}
+}
+
+// Gathers the indices of objects that intersect the sphere and layerMask, in ascending order
+void CullObjects(const Scene& scene, const SPHERE& sphere, uint32_t layerMask, std::vector<uint32_t>& result)
+{
+	result.clear();
+	const uint32_t count = (uint32_t)scene.aabb_objects.GetCount();
+	if (count > 0 && scene.bvh_objects.IsValid(count))
+	{
+		scene.bvh_objects.Intersects(sphere, layerMask, [&](uint32_t index) {
+			result.push_back(index);
+		});
+		std::sort(result.begin(), result.end());
+	}
+	else
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const AABB& aabb = scene.aabb_objects[i];
+			if ((aabb.layerMask & layerMask) && sphere.intersects(aabb))
+			{
+				result.push_back(i);
+			}
+		}
+	}
+}
+
+// Texture streaming feedback: requests the resolution that the textures of the material are displayed with
+//	pixels : the screen space size of the geometry that uses the material
+void RequestTextureResolution(const MaterialComponent& material, float pixels)
+{
+	const float tiling = std::max(std::abs(material.texMulAdd.x), std::abs(material.texMulAdd.y));
+	const uint32_t resolution = std::max(1u, uint32_t(std::min(pixels * tiling, 65536.0f)));
+	for (auto& x : material.textures)
+	{
+		if (x.resource != nullptr && x.resource->streaming_texture != nullptr)
+		{
+			x.resource->streaming_texture->RequestResolution(resolution);
+		}
+	}
+}
+
 void UpdateVisibility(Visibility& vis)
 {
 	// Perform parallel frustum culling and obtain closest reflector:
@@ -3245,13 +3323,6 @@ void UpdateVisibility(Visibility& vis)
 	assert(vis.scene != nullptr); // User must provide a scene!
 	assert(vis.camera != nullptr); // User must provide a camera!
 
-	// The parallel frustum culling is first performed in shared memory, 
-	//	then each group writes out it's local list to global memory
-	//	The shared memory approach reduces atomics and helps the list to remain
-	//	more coherent (less randomly organized compared to original order)
-	static const uint32_t groupSize = 64;
-	static const size_t sharedmemory_size = (groupSize + 1) * sizeof(uint32_t); // list + counter per group
-
 	// Initialize visible indices:
 	vis.Clear();
 
@@ -3264,154 +3335,89 @@ void UpdateVisibility(Visibility& vis)
 	{
 		// Cull lights:
 		vis.visibleLights.resize(vis.scene->aabb_lights.GetCount());
-		wiJobSystem::Dispatch(ctx_lights, (uint32_t)vis.scene->aabb_lights.GetCount(), groupSize, [&](wiJobArgs args) {
+		CullBoundingBoxes(ctx_lights, vis.scene->bvh_lights, vis.scene->aabb_lights, vis, vis.visibleLights.data(), vis.light_counter, [&](uint32_t index) {
 
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			Visibility::VisibleLight* group_list = (Visibility::VisibleLight*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
+			// Also compute light distance for shadow priority sorting:
+			assert(index < 0xFFFF);
+			Visibility::VisibleLight visibleLight;
+			visibleLight.index = (uint16_t)index;
+			const LightComponent& lightcomponent = vis.scene->lights[index];
+			float distance = 0;
+			if (lightcomponent.type != LightComponent::DIRECTIONAL)
 			{
-				group_count = 0; // first thread initializes local counter
+				distance = wiMath::DistanceEstimated(lightcomponent.position, vis.camera->Eye);
 			}
-
-			const AABB& aabb = vis.scene->aabb_lights[args.jobIndex];
-
-			if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+			visibleLight.distance = uint16_t(distance * 10);
+			if (lightcomponent.IsVolumetricsEnabled())
 			{
-				// Local stream compaction:
-				//	(also compute light distance for shadow priority sorting)
-				assert(args.jobIndex < 0xFFFF);
-				group_list[group_count].index = (uint16_t)args.jobIndex;
-				const LightComponent& lightcomponent = vis.scene->lights[args.jobIndex];
-				float distance = 0;
-				if (lightcomponent.type != LightComponent::DIRECTIONAL)
-				{
-					distance = wiMath::DistanceEstimated(lightcomponent.position, vis.camera->Eye);
-				}
-				group_list[group_count].distance = uint16_t(distance * 10);
-				group_count++;
-				if (lightcomponent.IsVolumetricsEnabled())
-				{
-					vis.volumetriclight_request.store(true);
-				}
-			}
-
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
-			{
-				uint32_t prev_count = vis.light_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
-				{
-					vis.visibleLights[prev_count + i] = group_list[i];
-				}
+				vis.volumetriclight_request.store(true);
 			}
-
-			}, sharedmemory_size);
+			return visibleLight;
+		});
 	}
 
 	if (vis.flags & Visibility::ALLOW_OBJECTS)
 	{
 		// Cull objects:
 		vis.visibleObjects.resize(vis.scene->aabb_objects.GetCount());
-		wiJobSystem::Dispatch(ctx, (uint32_t)vis.scene->aabb_objects.GetCount(), groupSize, [&](wiJobArgs args) {
-
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
-			{
-				group_count = 0; // first thread initializes local counter
-			}
+		CullBoundingBoxes(ctx, vis.scene->bvh_objects, vis.scene->aabb_objects, vis, vis.visibleObjects.data(), vis.object_counter, [&](uint32_t index) {
 
-			const AABB& aabb = vis.scene->aabb_objects[args.jobIndex];
-
-			if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+			if (vis.flags & Visibility::ALLOW_REQUEST_REFLECTION)
 			{
-				// Local stream compaction:
-				group_list[group_count++] = args.jobIndex;
-
-				if (vis.flags & Visibility::ALLOW_REQUEST_REFLECTION)
+				const ObjectComponent& object = vis.scene->objects[index];
+				if (object.IsRequestPlanarReflection())
 				{
-					const ObjectComponent& object = vis.scene->objects[args.jobIndex];
-					if (object.IsRequestPlanarReflection())
+					float dist = wiMath::DistanceEstimated(vis.camera->Eye, object.center);
+					vis.locker.lock();
+					if (dist < vis.closestRefPlane)
 					{
-						float dist = wiMath::DistanceEstimated(vis.camera->Eye, object.center);
-						vis.locker.lock();
-						if (dist < vis.closestRefPlane)
-						{
-							vis.closestRefPlane = dist;
-							const TransformComponent& transform = vis.scene->transforms[object.transform_index];
-							XMVECTOR P = transform.GetPositionV();
-							XMVECTOR N = XMVectorSet(0, 1, 0, 0);
-							N = XMVector3TransformNormal(N, XMLoadFloat4x4(&transform.world));
-							XMVECTOR _refPlane = XMPlaneFromPointNormal(P, N);
-							XMStoreFloat4(&vis.reflectionPlane, _refPlane);
-
-							vis.planar_reflection_visible = true;
-						}
-						vis.locker.unlock();
+						vis.closestRefPlane = dist;
+						const TransformComponent& transform = vis.scene->transforms[object.transform_index];
+						XMVECTOR P = transform.GetPositionV();
+						XMVECTOR N = XMVectorSet(0, 1, 0, 0);
+						N = XMVector3TransformNormal(N, XMLoadFloat4x4(&transform.world));
+						XMVECTOR _refPlane = XMPlaneFromPointNormal(P, N);
+						XMStoreFloat4(&vis.reflectionPlane, _refPlane);
+
+						vis.planar_reflection_visible = true;
 					}
+					vis.locker.unlock();
 				}
 			}
-
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
-			{
-				uint32_t prev_count = vis.object_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
-				{
-					vis.visibleObjects[prev_count + i] = group_list[i];
-				}
-			}
-
-			}, sharedmemory_size);
+			return index;
+		});
 	}
 
 	if (vis.flags & Visibility::ALLOW_DECALS)
 	{
 		vis.visibleDecals.resize(vis.scene->aabb_decals.GetCount());
-		wiJobSystem::Dispatch(ctx, (uint32_t)vis.scene->aabb_decals.GetCount(), groupSize, [&](wiJobArgs args) {
-
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
-			{
-				group_count = 0; // first thread initializes local counter
-			}
-
-			const AABB& aabb = vis.scene->aabb_decals[args.jobIndex];
-
-			if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
-			{
-				// Local stream compaction:
-				group_list[group_count++] = args.jobIndex;
-			}
-
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
-			{
-				uint32_t prev_count = vis.decal_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
-				{
-					vis.visibleDecals[prev_count + i] = group_list[i];
-				}
-			}
-
-			}, sharedmemory_size);
+		CullBoundingBoxes(ctx, vis.scene->bvh_decals, vis.scene->aabb_decals, vis, vis.visibleDecals.data(), vis.decal_counter, [&](uint32_t index) {
+			return index;
+		});
 	}
 
 	if (vis.flags & Visibility::ALLOW_ENVPROBES)
 	{
 		wiJobSystem::Execute(ctx, [&](wiJobArgs args) {
 			// Cull probes:
-			for (size_t i = 0; i < vis.scene->aabb_probes.GetCount(); ++i)
+			const uint32_t count = (uint32_t)vis.scene->aabb_probes.GetCount();
+			if (count > 0 && vis.scene->bvh_probes.IsValid(count))
 			{
-				const AABB& aabb = vis.scene->aabb_probes[i];
-
-				if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+				vis.scene->bvh_probes.IntersectSubtree(0, vis.frustum, vis.layerMask, [&](uint32_t i) {
+					vis.visibleEnvProbes.push_back(i);
+				});
+				std::sort(vis.visibleEnvProbes.begin(), vis.visibleEnvProbes.end()); // the order is important for blending
+			}
+			else
+			{
+				for (uint32_t i = 0; i < count; ++i)
 				{
-					vis.visibleEnvProbes.push_back((uint32_t)i);
+					const AABB& aabb = vis.scene->aabb_probes[i];
+
+					if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+					{
+						vis.visibleEnvProbes.push_back(i);
+					}
 				}
 			}
 			});
@@ -3467,6 +3473,74 @@ void UpdateVisibility(Visibility& vis)
 	vis.visibleObjects.resize((size_t)vis.object_counter.load());
 	vis.visibleDecals.resize((size_t)vis.decal_counter.load());
 
+	if (wiResourceManager::IsTextureStreamingEnabled())
+	{
+		// Request texture resolutions based on the screen space size of the visible bounding boxes:
+		const float projection_scale = vis.camera->height / std::tan(vis.camera->fov * 0.5f);
+		auto GetScreenSize = [&](const AABB& aabb) {
+			const float radius = aabb.getRadius();
+			const float distance = std::max(vis.camera->zNearP, wiMath::Distance(vis.camera->Eye, aabb.getCenter()) - radius);
+			return radius * projection_scale / distance;
+		};
+
+		wiJobSystem::Dispatch(ctx, (uint32_t)vis.visibleObjects.size(), 64, [&](wiJobArgs args) {
+			const uint32_t objectIndex = vis.visibleObjects[args.jobIndex];
+			const ObjectComponent& object = vis.scene->objects[objectIndex];
+			const MeshComponent* mesh = vis.scene->meshes.GetComponent(object.meshID);
+			if (mesh == nullptr)
+			{
+				return;
+			}
+			const float pixels = GetScreenSize(vis.scene->aabb_objects[objectIndex]);
+			for (auto& subset : mesh->subsets)
+			{
+				const MaterialComponent* material = vis.scene->materials.GetComponent(subset.materialID);
+				if (material != nullptr)
+				{
+					RequestTextureResolution(*material, pixels);
+				}
+			}
+			for (Entity entity : { mesh->terrain_material1, mesh->terrain_material2, mesh->terrain_material3 })
+			{
+				const MaterialComponent* material = vis.scene->materials.GetComponent(entity);
+				if (material != nullptr)
+				{
+					RequestTextureResolution(*material, pixels);
+				}
+			}
+		});
+
+		wiJobSystem::Execute(ctx, [&](wiJobArgs args) {
+			for (uint32_t decalIndex : vis.visibleDecals)
+			{
+				const MaterialComponent* material = vis.scene->materials.GetComponent(vis.scene->decals.GetEntity(decalIndex));
+				if (material != nullptr)
+				{
+					RequestTextureResolution(*material, GetScreenSize(vis.scene->aabb_decals[decalIndex]));
+				}
+			}
+			// Particles are not sized by bounding boxes, they request full resolution:
+			for (uint32_t emitterIndex : vis.visibleEmitters)
+			{
+				const MaterialComponent* material = vis.scene->materials.GetComponent(vis.scene->emitters.GetEntity(emitterIndex));
+				if (material != nullptr)
+				{
+					RequestTextureResolution(*material, 65536.0f);
+				}
+			}
+			for (uint32_t hairIndex : vis.visibleHairs)
+			{
+				const MaterialComponent* material = vis.scene->materials.GetComponent(vis.scene->hairs.GetEntity(hairIndex));
+				if (material != nullptr)
+				{
+					RequestTextureResolution(*material, 65536.0f);
+				}
+			}
+		});
+
+		wiJobSystem::Wait(ctx);
+	}
+
 	if ((vis.flags & Visibility::ALLOW_REQUEST_REFLECTION) && vis.scene->weather.IsOceanEnabled())
 	{
 		// Ocean will override any current reflectors
@@ -5045,6 +5119,88 @@ void SetShadowPropsCube(int resolution, int count)
 	}
 
 }
+// Shadow casters of every shadow pass are cached, keyed by (light entity << 32 | cascade)
+//	The cached result is reused while the shadow volume is unchanged and no object bounds moved inside it
+struct ShadowCasterCache
+{
+	const Scene* scene = nullptr;
+	uint64_t version = 0; // scene.object_bounds_version of the last validation
+	uint64_t frame = 0; // last frame when the cache was used
+	uint32_t layerMask = 0;
+	size_t objectCount = 0;
+	bool sphere_volume = false;
+	Frustum frustum;
+	SPHERE sphere;
+	std::vector<uint32_t> objects; // indices of objects inside the volume, in ascending order
+	std::vector<Entity> entities; // entity of every cached object, to detect when components were reordered
+};
+std::unordered_map<uint64_t, ShadowCasterCache> shadowCasterCaches;
+static const uint64_t SHADOWCASTERCACHE_LIFETIME = 60; // frames
+
+// Validate the cache against the volume (either frustum or sphere must be provided), and gather the objects if it is invalid
+void UpdateShadowCasterCache(ShadowCasterCache& cache, const Scene& scene, uint32_t layerMask, const Frustum* frustum, const SPHERE* sphere)
+{
+	const size_t objectCount = scene.aabb_objects.GetCount();
+
+	bool valid =
+		cache.scene == &scene &&
+		cache.layerMask == layerMask &&
+		cache.objectCount == objectCount &&
+		cache.sphere_volume == (sphere != nullptr);
+	if (valid)
+	{
+		if (sphere != nullptr)
+		{
+			valid = memcmp(&cache.sphere.center, &sphere->center, sizeof(XMFLOAT3)) == 0 && cache.sphere.radius == sphere->radius;
+		}
+		else
+		{
+			valid = memcmp(cache.frustum.planes, frustum->planes, sizeof(frustum->planes)) == 0;
+		}
+	}
+	if (valid && cache.version != scene.object_bounds_version)
+	{
+		// Only the objects that moved in the last update are checked, if the cache is older than that, it is discarded:
+		const uint32_t moved_count = scene.moved_object_count.load();
+		valid = cache.version + 1 == scene.object_bounds_version && moved_count <= scene.moved_object_bounds_capacity;
+		for (uint32_t i = 0; valid && i < moved_count; ++i)
+		{
+			const AABB& aabb = scene.moved_object_bounds[i];
+			if ((aabb.layerMask & layerMask) == 0)
+				continue;
+			valid = sphere != nullptr ? !sphere->intersects(aabb) : !frustum->CheckBoxFast(aabb);
+		}
+	}
+	for (size_t i = 0; valid && i < cache.objects.size(); ++i)
+	{
+		valid = scene.aabb_objects.GetEntity(cache.objects[i]) == cache.entities[i];
+	}
+
+	if (!valid)
+	{
+		if (sphere != nullptr)
+		{
+			CullObjects(scene, *sphere, layerMask, cache.objects);
+			cache.sphere = *sphere;
+		}
+		else
+		{
+			CullObjects(scene, *frustum, layerMask, cache.objects);
+			cache.frustum = *frustum;
+		}
+		cache.entities.resize(cache.objects.size());
+		for (size_t i = 0; i < cache.objects.size(); ++i)
+		{
+			cache.entities[i] = scene.aabb_objects.GetEntity(cache.objects[i]);
+		}
+		cache.scene = &scene;
+		cache.layerMask = layerMask;
+		cache.objectCount = objectCount;
+		cache.sphere_volume = sphere != nullptr;
+	}
+	cache.version = scene.object_bounds_version;
+}
+
 void DrawShadowmaps(
 	const Visibility& vis,
 	CommandList cmd
@@ -5073,6 +5229,30 @@ void DrawShadowmaps(
 		uint32_t shadowCounter_2D = SHADOWRES_2D > 0 ? 0 : SHADOWCOUNT_2D;
 		uint32_t shadowCounter_Cube = SHADOWRES_CUBE > 0 ? 0 : SHADOWCOUNT_CUBE;
 
+		// The shadow passes are collected first (the slice allocation must match UpdatePerFrameData()),
+		//	then the shadow casters are gathered for every pass in parallel, finally the passes are rendered in order:
+		struct ShadowPass
+		{
+			const LightComponent* light = nullptr;
+			uint32_t slice = 0;
+			uint32_t cascade = 0;
+			SHCAM shcam;
+			ShadowCasterCache* cache = nullptr;
+		};
+		std::vector<ShadowPass> shadowPasses;
+
+		const uint64_t frame = device->GetFrameCount();
+		auto add_pass = [&](uint16_t lightIndex, uint32_t slice, uint32_t cascade, const SHCAM& shcam) {
+			ShadowPass& pass = shadowPasses.emplace_back();
+			pass.light = &vis.scene->lights[lightIndex];
+			pass.slice = slice;
+			pass.cascade = cascade;
+			pass.shcam = shcam;
+			const uint64_t key = (uint64_t(vis.scene->lights.GetEntity(lightIndex)) << 32ull) | uint64_t(cascade);
+			pass.cache = &shadowCasterCaches[key];
+			pass.cache->frame = frame;
+		};
+
 		for (const auto& visibleLight : vis.visibleLights)
 		{
 			if (shadowCounter_2D >= SHADOWCOUNT_2D && shadowCounter_Cube >= SHADOWCOUNT_CUBE)
@@ -5103,57 +5283,7 @@ void DrawShadowmaps(
 
 				for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
 				{
-					RenderQueue renderQueue;
-					bool transparentShadowsRequested = false;
-					for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
-					{
-						const AABB& aabb = vis.scene->aabb_objects[i];
-						if ((aabb.layerMask & vis.layerMask) && shcams[cascade].frustum.CheckBoxFast(aabb))
-						{
-							const ObjectComponent& object = vis.scene->objects[i];
-							if (object.IsRenderable() && object.IsCastingShadow() && (cascade < (CASCADE_COUNT - object.cascadeMask)))
-							{
-								Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
-
-								RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
-								size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
-								batch->Create(meshIndex, i, 0);
-								renderQueue.add(batch);
-
-								if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
-								{
-									transparentShadowsRequested = true;
-								}
-							}
-						}
-					}
-
-					device->RenderPassBegin(&renderpasses_shadow2D[slice + cascade], cmd);
-					if (!renderQueue.empty())
-					{
-						CameraCB cb;
-						XMStoreFloat4x4(&cb.g_xCamera_VP, shcams[cascade].VP);
-						device->UpdateBuffer(&constantBuffers[CBTYPE_CAMERA], &cb, cmd);
-
-						Viewport vp;
-						vp.TopLeftX = 0;
-						vp.TopLeftY = 0;
-						vp.Width = (float)SHADOWRES_2D;
-						vp.Height = (float)SHADOWRES_2D;
-						vp.MinDepth = 0.0f;
-						vp.MaxDepth = 1.0f;
-						device->BindViewports(1, &vp, cmd);
-
-						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
-						if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
-						{
-							RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
-						}
-
-						GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
-					}
-					device->RenderPassEnd(cmd);
-
+					add_pass(lightIndex, slice, cascade, shcams[cascade]);
 				}
 			}
 			break;
@@ -5169,34 +5299,91 @@ void DrawShadowmaps(
 				if (!cam_frustum.Intersects(shcam.boundingfrustum))
 					break;
 
-				RenderQueue renderQueue;
-				bool transparentShadowsRequested = false;
-				for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
+				add_pass(lightIndex, slice, 0, shcam);
+			}
+			break;
+			case LightComponent::POINT:
+			{
+				if (shadowCounter_Cube >= SHADOWCOUNT_CUBE)
+					break;
+				uint32_t slice = shadowCounter_Cube;
+				shadowCounter_Cube += 1;
+
+				add_pass(lightIndex, slice, 0, SHCAM());
+			}
+			break;
+			} // terminate switch
+		}
+
+		// Caches of lights that were not rendered for a while are removed:
+		for (auto it = shadowCasterCaches.begin(); it != shadowCasterCaches.end();)
+		{
+			if (it->second.frame + SHADOWCASTERCACHE_LIFETIME < frame)
+			{
+				it = shadowCasterCaches.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, (uint32_t)shadowPasses.size(), 1, [&](wiJobArgs args) {
+			const ShadowPass& pass = shadowPasses[args.jobIndex];
+			if (pass.light->GetType() == LightComponent::POINT)
+			{
+				const SPHERE boundingsphere = SPHERE(pass.light->position, pass.light->GetRange());
+				UpdateShadowCasterCache(*pass.cache, *vis.scene, vis.layerMask, nullptr, &boundingsphere);
+			}
+			else
+			{
+				UpdateShadowCasterCache(*pass.cache, *vis.scene, vis.layerMask, &pass.shcam.frustum, nullptr);
+			}
+		});
+		wiJobSystem::Wait(ctx);
+
+		for (const ShadowPass& pass : shadowPasses)
+		{
+			const LightComponent& light = *pass.light;
+			const uint32_t slice = pass.slice;
+
+			RenderQueue renderQueue;
+			bool transparentShadowsRequested = false;
+			for (uint32_t i : pass.cache->objects)
+			{
+				const ObjectComponent& object = vis.scene->objects[i];
+				if (!object.IsRenderable() || !object.IsCastingShadow())
 				{
-					const AABB& aabb = vis.scene->aabb_objects[i];
-					if ((aabb.layerMask & vis.layerMask) && shcam.frustum.CheckBoxFast(aabb))
-					{
-						const ObjectComponent& object = vis.scene->objects[i];
-						if (object.IsRenderable() && object.IsCastingShadow())
-						{
-							Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
+					continue;
+				}
+				if (light.GetType() == LightComponent::DIRECTIONAL && pass.cascade >= (CASCADE_COUNT - object.cascadeMask))
+				{
+					continue;
+				}
 
-							RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
-							size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
-							batch->Create(meshIndex, i, 0);
-							renderQueue.add(batch);
+				RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
+				size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
+				batch->Create(meshIndex, i, 0);
+				renderQueue.add(batch);
 
-							if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
-							{
-								transparentShadowsRequested = true;
-							}
-						}
-					}
+				if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
+				{
+					transparentShadowsRequested = true;
 				}
+			}
+
+			switch (light.GetType())
+			{
+			case LightComponent::DIRECTIONAL:
+			{
+				const uint32_t cascade = pass.cascade;
+
+				device->RenderPassBegin(&renderpasses_shadow2D[slice + cascade], cmd);
 				if (!renderQueue.empty())
 				{
 					CameraCB cb;
-					XMStoreFloat4x4(&cb.g_xCamera_VP, shcam.VP);
+					XMStoreFloat4x4(&cb.g_xCamera_VP, pass.shcam.VP);
 					device->UpdateBuffer(&constantBuffers[CBTYPE_CAMERA], &cb, cmd);
 
 					Viewport vp;
@@ -5208,52 +5395,48 @@ void DrawShadowmaps(
 					vp.MaxDepth = 1.0f;
 					device->BindViewports(1, &vp, cmd);
 
-					device->RenderPassBegin(&renderpasses_shadow2D[slice], cmd);
 					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
 					if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
 					{
 						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
 					}
-					device->RenderPassEnd(cmd);
 
 					GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
 				}
-
+				device->RenderPassEnd(cmd);
 			}
 			break;
-			case LightComponent::POINT:
+			case LightComponent::SPOT:
 			{
-				if (shadowCounter_Cube >= SHADOWCOUNT_CUBE)
-					break;
-				uint32_t slice = shadowCounter_Cube;
-				shadowCounter_Cube += 1;
-
-				SPHERE boundingsphere = SPHERE(light.position, light.GetRange());
-
-				RenderQueue renderQueue;
-				bool transparentShadowsRequested = false;
-				for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
+				if (!renderQueue.empty())
 				{
-					const AABB& aabb = vis.scene->aabb_objects[i];
-					if ((aabb.layerMask & vis.layerMask) && boundingsphere.intersects(aabb))
-					{
-						const ObjectComponent& object = vis.scene->objects[i];
-						if (object.IsRenderable() && object.IsCastingShadow())
-						{
-							Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
+					CameraCB cb;
+					XMStoreFloat4x4(&cb.g_xCamera_VP, pass.shcam.VP);
+					device->UpdateBuffer(&constantBuffers[CBTYPE_CAMERA], &cb, cmd);
 
-							RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
-							size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
-							batch->Create(meshIndex, i, 0);
-							renderQueue.add(batch);
+					Viewport vp;
+					vp.TopLeftX = 0;
+					vp.TopLeftY = 0;
+					vp.Width = (float)SHADOWRES_2D;
+					vp.Height = (float)SHADOWRES_2D;
+					vp.MinDepth = 0.0f;
+					vp.MaxDepth = 1.0f;
+					device->BindViewports(1, &vp, cmd);
 
-							if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
-							{
-								transparentShadowsRequested = true;
-							}
-						}
+					device->RenderPassBegin(&renderpasses_shadow2D[slice], cmd);
+					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
+					if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+					{
+						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
 					}
+					device->RenderPassEnd(cmd);
+
+					GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
 				}
+			}
+			break;
+			case LightComponent::POINT:
+			{
 				if (!renderQueue.empty())
 				{
 					MiscCB miscCb;
@@ -2,20 +2,135 @@
 #include "wiRenderer.h"
 #include "wiHelper.h"
 #include "wiTextureHelper.h"
+#include "wiEvent.h"
+#include "wiTextureCooker.h"
 
 #include "Utility/stb_image.h"
 #include "Utility/tinyddsloader.h"
 
 #include <algorithm>
+#include <queue>
+#include <filesystem>
+#include <condition_variable>
 
 using namespace wiGraphics;
 
 namespace wiResourceManager
 {
-	std::mutex locker;
-	std::unordered_map<std::string, std::weak_ptr<wiResource>> resources;
 	MODE mode = MODE_DISCARD_FILEDATA_AFTER_LOAD;
 
+	// The resource cache is split into shards by the hash of the resource name,
+	//	so loading different resources from multiple threads (for example in scene serialization) rarely waits on the same lock
+	namespace Cache
+	{
+		static constexpr size_t SHARD_COUNT = 64;
+		static constexpr size_t MIN_SWEEP_THRESHOLD = 64; // expired entries are removed when a shard grows over its threshold
+
+		struct Entry
+		{
+			std::string name;
+			std::weak_ptr<wiResource> resource;
+			bool loading = false; // Load() is importing the resource on a thread, it's not ready yet
+		};
+		struct Shard
+		{
+			std::mutex locker;
+			std::condition_variable loaded; // notified when a resource of this shard finished loading
+			std::unordered_multimap<size_t, Entry> entries; // key: hash of the resource name
+			size_t sweep_threshold = MIN_SWEEP_THRESHOLD;
+		};
+		Shard shards[SHARD_COUNT];
+
+		inline size_t Hash(const std::string& name)
+		{
+			return std::hash<std::string>()(name);
+		}
+		inline Shard& GetShard(size_t hash)
+		{
+			// The high bits of the fibonacci hash select the shard, so the entries of a shard still spread over its own buckets:
+			return shards[(uint64_t(hash) * 0x9E3779B97F4A7C15ull) >> 58];
+		}
+		static_assert(SHARD_COUNT == 64, "GetShard() must be updated");
+
+		// Returns the entry of the name or nullptr, the shard must be locked
+		Entry* Find(Shard& shard, size_t hash, const std::string& name)
+		{
+			auto range = shard.entries.equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				if (it->second.name == name)
+				{
+					return &it->second;
+				}
+			}
+			return nullptr;
+		}
+
+		// Returns the entry of the name or nullptr, if the resource is being loaded by an other thread, then waits until it's finished
+		//	So concurrent loads of the same resource only import it once
+		Entry* FindLoaded(Shard& shard, size_t hash, const std::string& name, std::unique_lock<std::mutex>& lock)
+		{
+			while (true)
+			{
+				Entry* entry = Find(shard, hash, name);
+				if (entry == nullptr || !entry->loading)
+				{
+					return entry;
+				}
+				shard.loaded.wait(lock);
+			}
+		}
+
+		// Adds a new entry, the shard must be locked
+		Entry& Insert(Shard& shard, size_t hash, const std::string& name)
+		{
+			if (shard.entries.size() >= shard.sweep_threshold)
+			{
+				for (auto it = shard.entries.begin(); it != shard.entries.end();)
+				{
+					if (!it->second.loading && it->second.resource.expired())
+					{
+						it = shard.entries.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+				shard.sweep_threshold = std::max(MIN_SWEEP_THRESHOLD, shard.entries.size() * 2);
+			}
+
+			Entry& entry = shard.entries.emplace(hash, Entry())->second;
+			entry.name = name;
+			return entry;
+		}
+
+		// Ends the loading state of the resource that was started in Load(), and wakes up the threads waiting for it
+		void FinishLoading(Shard& shard, size_t hash, const std::string& name, const wiResource* resource, bool success)
+		{
+			shard.locker.lock();
+			auto range = shard.entries.equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				// The entry could have been removed by Clear() and replaced by an other load in the meantime:
+				if (it->second.name == name && it->second.resource.lock().get() == resource)
+				{
+					if (success)
+					{
+						it->second.loading = false;
+					}
+					else
+					{
+						shard.entries.erase(it);
+					}
+					break;
+				}
+			}
+			shard.locker.unlock();
+			shard.loaded.notify_all();
+		}
+	}
+
 	void SetMode(MODE param)
 	{
 		mode = param;
@@ -36,40 +151,434 @@ namespace wiResourceManager
 		std::make_pair("OGG", wiResource::SOUND),
 	};
 
-	std::shared_ptr<wiResource> Load(const std::string& name, uint32_t flags, const uint8_t* filedata, size_t filesize)
+	// Creates a texture from the DDS mip levels, starting from first_mip as the most detailed mip
+	bool CreateTextureDDS(const tinyddsloader::DDSFile& dds, uint32_t first_mip, Texture* texture)
 	{
-		if (mode == MODE_DISCARD_FILEDATA_AFTER_LOAD)
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		TextureDesc desc;
+		desc.ArraySize = 1;
+		desc.BindFlags = BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
+		desc.Width = std::max(1u, dds.GetWidth() >> first_mip);
+		desc.Height = std::max(1u, dds.GetHeight() >> first_mip);
+		desc.Depth = std::max(1u, dds.GetDepth() >> first_mip);
+		desc.MipLevels = dds.GetMipCount() - first_mip;
+		desc.ArraySize = dds.GetArraySize();
+		desc.MiscFlags = 0;
+		desc.Usage = USAGE_IMMUTABLE;
+		desc.Format = FORMAT_R8G8B8A8_UNORM;
+		desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE;
+
+		if (dds.IsCubemap())
 		{
-			flags &= ~IMPORT_RETAIN_FILEDATA;
+			desc.MiscFlags |= RESOURCE_MISC_TEXTURECUBE;
 		}
 
-		locker.lock();
-		std::weak_ptr<wiResource>& weak_resource = resources[name];
-		std::shared_ptr<wiResource> resource = weak_resource.lock();
+		auto ddsFormat = dds.GetFormat();
 
-		if (resource == nullptr)
+		switch (ddsFormat)
 		{
-			resource = std::make_shared<wiResource>();
-			resources[name] = resource;
-			locker.unlock();
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32B32A32_Float: desc.Format = FORMAT_R32G32B32A32_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32B32A32_UInt: desc.Format = FORMAT_R32G32B32A32_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32B32A32_SInt: desc.Format = FORMAT_R32G32B32A32_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32B32_Float: desc.Format = FORMAT_R32G32B32_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32B32_UInt: desc.Format = FORMAT_R32G32B32_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32B32_SInt: desc.Format = FORMAT_R32G32B32_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_Float: desc.Format = FORMAT_R16G16B16A16_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_UNorm: desc.Format = FORMAT_R16G16B16A16_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_UInt: desc.Format = FORMAT_R16G16B16A16_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_SNorm: desc.Format = FORMAT_R16G16B16A16_SNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_SInt: desc.Format = FORMAT_R16G16B16A16_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32_Float: desc.Format = FORMAT_R32G32_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32_UInt: desc.Format = FORMAT_R32G32_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32G32_SInt: desc.Format = FORMAT_R32G32_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R10G10B10A2_UNorm: desc.Format = FORMAT_R10G10B10A2_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R10G10B10A2_UInt: desc.Format = FORMAT_R10G10B10A2_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R11G11B10_Float: desc.Format = FORMAT_R11G11B10_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::B8G8R8A8_UNorm: desc.Format = FORMAT_B8G8R8A8_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::B8G8R8A8_UNorm_SRGB: desc.Format = FORMAT_B8G8R8A8_UNORM_SRGB; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_UNorm: desc.Format = FORMAT_R8G8B8A8_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_UNorm_SRGB: desc.Format = FORMAT_R8G8B8A8_UNORM_SRGB; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_UInt: desc.Format = FORMAT_R8G8B8A8_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_SNorm: desc.Format = FORMAT_R8G8B8A8_SNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_SInt: desc.Format = FORMAT_R8G8B8A8_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16_Float: desc.Format = FORMAT_R16G16_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16_UNorm: desc.Format = FORMAT_R16G16_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16_UInt: desc.Format = FORMAT_R16G16_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16_SNorm: desc.Format = FORMAT_R16G16_SNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16G16_SInt: desc.Format = FORMAT_R16G16_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::D32_Float: desc.Format = FORMAT_D32_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32_Float: desc.Format = FORMAT_R32_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32_UInt: desc.Format = FORMAT_R32_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R32_SInt: desc.Format = FORMAT_R32_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8_UNorm: desc.Format = FORMAT_R8G8_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8_UInt: desc.Format = FORMAT_R8G8_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8_SNorm: desc.Format = FORMAT_R8G8_SNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8G8_SInt: desc.Format = FORMAT_R8G8_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16_Float: desc.Format = FORMAT_R16_FLOAT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::D16_UNorm: desc.Format = FORMAT_D16_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16_UNorm: desc.Format = FORMAT_R16_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16_UInt: desc.Format = FORMAT_R16_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16_SNorm: desc.Format = FORMAT_R16_SNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R16_SInt: desc.Format = FORMAT_R16_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8_UNorm: desc.Format = FORMAT_R8_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8_UInt: desc.Format = FORMAT_R8_UINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8_SNorm: desc.Format = FORMAT_R8_SNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::R8_SInt: desc.Format = FORMAT_R8_SINT; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC1_UNorm: desc.Format = FORMAT_BC1_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC1_UNorm_SRGB: desc.Format = FORMAT_BC1_UNORM_SRGB; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC2_UNorm: desc.Format = FORMAT_BC2_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC2_UNorm_SRGB: desc.Format = FORMAT_BC2_UNORM_SRGB; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC3_UNorm: desc.Format = FORMAT_BC3_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC3_UNorm_SRGB: desc.Format = FORMAT_BC3_UNORM_SRGB; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC4_UNorm: desc.Format = FORMAT_BC4_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC4_SNorm: desc.Format = FORMAT_BC4_SNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC5_UNorm: desc.Format = FORMAT_BC5_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC5_SNorm: desc.Format = FORMAT_BC5_SNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC7_UNorm: desc.Format = FORMAT_BC7_UNORM; break;
+		case tinyddsloader::DDSFile::DXGIFormat::BC7_UNorm_SRGB: desc.Format = FORMAT_BC7_UNORM_SRGB; break;
+		default:
+			assert(0); // incoming format is not supported 
+			break;
 		}
-		else
+
+		std::vector<SubresourceData> InitData;
+		for (uint32_t arrayIndex = 0; arrayIndex < desc.ArraySize; ++arrayIndex)
 		{
-			locker.unlock();
-			return resource;
+			for (uint32_t mip = first_mip; mip < dds.GetMipCount(); ++mip)
+			{
+				auto imageData = dds.GetImageData(mip, arrayIndex);
+				SubresourceData subresourceData;
+				subresourceData.pSysMem = imageData->m_mem;
+				subresourceData.SysMemPitch = imageData->m_memPitch;
+				subresourceData.SysMemSlicePitch = imageData->m_memSlicePitch;
+				InitData.push_back(subresourceData);
+			}
 		}
 
-		if (filedata == nullptr || filesize == 0)
+		auto dim = dds.GetTextureDimension();
+		switch (dim)
 		{
-			if (!wiHelper::FileRead(name, resource->filedata))
+		case tinyddsloader::DDSFile::TextureDimension::Texture1D:
+		{
+			desc.type = TextureDesc::TEXTURE_1D;
+		}
+		break;
+		case tinyddsloader::DDSFile::TextureDimension::Texture2D:
+		{
+			desc.type = TextureDesc::TEXTURE_2D;
+		}
+		break;
+		case tinyddsloader::DDSFile::TextureDimension::Texture3D:
+		{
+			desc.type = TextureDesc::TEXTURE_3D;
+		}
+		break;
+		default:
+			assert(0);
+			break;
+		}
+
+		if (device->IsFormatBlockCompressed(desc.Format))
+		{
+			desc.Width = std::max(4u, desc.Width);
+			desc.Height = std::max(4u, desc.Height);
+		}
+
+		return device->CreateTexture(&desc, InitData.data(), texture);
+	}
+
+	namespace TextureStreaming
+	{
+		static constexpr uint32_t MIN_RESOLUTION = 128; // the mips with this resolution or lower are always resident
+		static constexpr uint32_t MAX_INFLIGHT_COUNT = 4; // the number of textures that can be recreated at the same time
+
+		struct Result
+		{
+			std::weak_ptr<wiResource> resource;
+			Texture texture;
+			uint32_t mip = 0;
+			bool success = false;
+		};
+
+		bool enabled = false;
+		std::mutex locker;
+		std::vector<std::weak_ptr<wiResource>> textures;
+		std::vector<Result> results; // finished mip level changes, they are applied at the thread safe point
+		size_t memory_budget = 512ull * 1024ull * 1024ull;
+		size_t memory_usage = 0;
+		uint64_t frame = 0;
+		wiJobSystem::context ctx;
+
+		// Creates the streaming state if the texture can be streamed, otherwise returns nullptr
+		//	filedata : if the DDS was not loaded from the file by name, then the file data is copied, because higher mips will be created from it
+		std::shared_ptr<wiResource::StreamingTexture> Create(const tinyddsloader::DDSFile& dds, const std::string& name, const uint8_t* filedata, size_t filesize)
+		{
+			const uint32_t mip_count = dds.GetMipCount();
+			if (dds.GetTextureDimension() != tinyddsloader::DDSFile::TextureDimension::Texture2D || dds.IsCubemap() || dds.GetArraySize() != 1 || mip_count < 2)
 			{
-				resource.reset();
 				return nullptr;
 			}
-			filedata = resource->filedata.data();
-			filesize = resource->filedata.size();
+
+			auto streaming_texture = std::make_shared<wiResource::StreamingTexture>();
+			streaming_texture->resolution = std::max(dds.GetWidth(), dds.GetHeight());
+			while (streaming_texture->min_mip + 1 < mip_count && (streaming_texture->resolution >> streaming_texture->min_mip) > MIN_RESOLUTION)
+			{
+				streaming_texture->min_mip++;
+			}
+			if (streaming_texture->min_mip == 0)
+			{
+				return nullptr; // small texture, it's always fully resident
+			}
+			streaming_texture->resident_mip = streaming_texture->min_mip;
+			streaming_texture->target_mip = streaming_texture->min_mip;
+			streaming_texture->desired_mip = streaming_texture->min_mip;
+
+			streaming_texture->mip_memory.resize(mip_count);
+			size_t memory = 0;
+			for (uint32_t mip = mip_count; mip > 0; --mip)
+			{
+				memory += dds.GetImageData(mip - 1, 0)->m_memSlicePitch;
+				streaming_texture->mip_memory[mip - 1] = memory;
+			}
+
+			streaming_texture->filename = name;
+			if (filedata != nullptr)
+			{
+				streaming_texture->filedata.assign(filedata, filedata + filesize);
+			}
+			return streaming_texture;
+		}
+
+		void Register(const std::shared_ptr<wiResource>& resource)
+		{
+			locker.lock();
+			textures.push_back(resource);
+			locker.unlock();
+		}
+
+		// Recreates the texture on a worker thread with the given most detailed mip, the result is applied in Update()
+		void Recreate(const std::shared_ptr<wiResource>& resource, uint32_t mip)
+		{
+			std::shared_ptr<wiResource::StreamingTexture> streaming_texture = resource->streaming_texture;
+			streaming_texture->target_mip = mip;
+			std::weak_ptr<wiResource> weak_resource = resource;
+
+			wiJobSystem::Execute(ctx, [weak_resource, streaming_texture, mip](wiJobArgs args) {
+				Result result;
+				result.resource = weak_resource;
+				result.mip = mip;
+
+				if (!weak_resource.expired())
+				{
+					tinyddsloader::DDSFile dds;
+					tinyddsloader::Result dds_result = tinyddsloader::Result::ErrorRead;
+					if (streaming_texture->filedata.empty())
+					{
+						std::vector<uint8_t> filedata;
+						if (wiHelper::FileRead(streaming_texture->filename, filedata))
+						{
+							dds_result = dds.Load(std::move(filedata));
+						}
+					}
+					else
+					{
+						dds_result = dds.Load(streaming_texture->filedata.data(), streaming_texture->filedata.size());
+					}
+
+					// The file could have been modified since it was loaded:
+					if (dds_result == tinyddsloader::Result::Success &&
+						dds.GetMipCount() == (uint32_t)streaming_texture->mip_memory.size() &&
+						std::max(dds.GetWidth(), dds.GetHeight()) == streaming_texture->resolution)
+					{
+						result.success = CreateTextureDDS(dds, mip, &result.texture);
+						wiRenderer::GetDevice()->SetName(&result.texture, streaming_texture->filename.c_str());
+					}
+				}
+
+				locker.lock();
+				results.push_back(result);
+				locker.unlock();
+			});
 		}
 
+		// Applies finished mip level changes, then starts streaming in the requested mips and streaming out the unneeded ones
+		//	This is called on the main thread when no rendering is in progress
+		void Update()
+		{
+			std::vector<Result> finished;
+			std::vector<std::shared_ptr<wiResource>> resources;
+
+			locker.lock();
+			finished.swap(results);
+			resources.reserve(textures.size());
+			for (size_t i = 0; i < textures.size();)
+			{
+				std::shared_ptr<wiResource> resource = textures[i].lock();
+				if (resource == nullptr)
+				{
+					textures[i] = std::move(textures.back());
+					textures.pop_back();
+					continue;
+				}
+				resource->streaming_texture->texture_changed = false;
+				resources.push_back(std::move(resource));
+				i++;
+			}
+			locker.unlock();
+
+			for (auto& result : finished)
+			{
+				std::shared_ptr<wiResource> resource = result.resource.lock();
+				if (resource == nullptr)
+				{
+					continue;
+				}
+				wiResource::StreamingTexture& streaming_texture = *resource->streaming_texture;
+				if (result.success)
+				{
+					resource->texture = result.texture;
+					streaming_texture.resident_mip = result.mip;
+					streaming_texture.texture_changed = true;
+				}
+				streaming_texture.target_mip = streaming_texture.resident_mip;
+			}
+
+			frame++;
+			size_t usage = 0;
+			size_t releasing = 0; // memory that will be freed when the mips that are streamed out are finished
+			uint32_t inflight_count = 0;
+			std::vector<size_t> stream_in;
+			std::vector<size_t> stream_out;
+
+			for (size_t i = 0; i < resources.size(); ++i)
+			{
+				wiResource::StreamingTexture& streaming_texture = *resources[i]->streaming_texture;
+
+				const uint32_t resolution = streaming_texture.requested_resolution.exchange(0, std::memory_order_relaxed);
+				if (resolution > 0)
+				{
+					uint32_t mip = 0;
+					while (mip < streaming_texture.min_mip && (streaming_texture.resolution >> (mip + 1)) >= resolution)
+					{
+						mip++;
+					}
+					streaming_texture.desired_mip = mip;
+					streaming_texture.last_used_frame = frame;
+				}
+				else
+				{
+					// Not visible, the detail can be streamed out if the memory is needed:
+					streaming_texture.desired_mip = streaming_texture.min_mip;
+				}
+
+				// While a texture is recreated, both the old and new textures exist:
+				usage += streaming_texture.mip_memory[std::min(streaming_texture.resident_mip, streaming_texture.target_mip)];
+
+				if (streaming_texture.target_mip != streaming_texture.resident_mip)
+				{
+					inflight_count++;
+					if (streaming_texture.target_mip > streaming_texture.resident_mip)
+					{
+						releasing += streaming_texture.mip_memory[streaming_texture.resident_mip] - streaming_texture.mip_memory[streaming_texture.target_mip];
+					}
+				}
+				else if (streaming_texture.desired_mip < streaming_texture.resident_mip)
+				{
+					stream_in.push_back(i);
+				}
+				else if (streaming_texture.desired_mip > streaming_texture.resident_mip)
+				{
+					stream_out.push_back(i);
+				}
+			}
+
+			// The textures that miss the most detail are streamed in first:
+			std::sort(stream_in.begin(), stream_in.end(), [&](size_t a, size_t b) {
+				const wiResource::StreamingTexture& texture_a = *resources[a]->streaming_texture;
+				const wiResource::StreamingTexture& texture_b = *resources[b]->streaming_texture;
+				return texture_a.resident_mip - texture_a.desired_mip > texture_b.resident_mip - texture_b.desired_mip;
+			});
+			// The least recently used textures are streamed out first:
+			std::sort(stream_out.begin(), stream_out.end(), [&](size_t a, size_t b) {
+				return resources[a]->streaming_texture->last_used_frame < resources[b]->streaming_texture->last_used_frame;
+			});
+
+			size_t next_out = 0;
+			auto StreamOut = [&]() {
+				const std::shared_ptr<wiResource>& resource = resources[stream_out[next_out++]];
+				const wiResource::StreamingTexture& streaming_texture = *resource->streaming_texture;
+				releasing += streaming_texture.mip_memory[streaming_texture.resident_mip] - streaming_texture.mip_memory[streaming_texture.desired_mip];
+				Recreate(resource, streaming_texture.desired_mip);
+				inflight_count++;
+			};
+
+			size_t reserved = 0; // memory for the textures that are streamed in after other textures are streamed out
+			for (size_t index : stream_in)
+			{
+				if (inflight_count >= MAX_INFLIGHT_COUNT)
+				{
+					break;
+				}
+				const std::shared_ptr<wiResource>& resource = resources[index];
+				const wiResource::StreamingTexture& streaming_texture = *resource->streaming_texture;
+				const size_t resident_memory = streaming_texture.mip_memory[streaming_texture.resident_mip];
+				const size_t required = streaming_texture.mip_memory[streaming_texture.desired_mip] - resident_memory;
+
+				if (usage + reserved + required > memory_budget)
+				{
+					// Stream out unneeded mips, and if that makes enough space, then stream in after they are released:
+					while (usage + reserved + required > memory_budget + releasing && next_out < stream_out.size() && inflight_count < MAX_INFLIGHT_COUNT)
+					{
+						StreamOut();
+					}
+					if (usage + reserved + required <= memory_budget + releasing)
+					{
+						reserved += required;
+						continue;
+					}
+				}
+
+				// Stream in the most detailed mips that fit into the budget:
+				uint32_t mip = streaming_texture.desired_mip;
+				while (mip < streaming_texture.resident_mip && usage + reserved + streaming_texture.mip_memory[mip] - resident_memory > memory_budget)
+				{
+					mip++;
+				}
+				if (mip < streaming_texture.resident_mip && inflight_count < MAX_INFLIGHT_COUNT)
+				{
+					usage += streaming_texture.mip_memory[mip] - resident_memory;
+					Recreate(resource, mip);
+					inflight_count++;
+				}
+			}
+
+			// The usage can be over budget without streaming in, for example if the budget was lowered:
+			while (usage > memory_budget + releasing && next_out < stream_out.size() && inflight_count < MAX_INFLIGHT_COUNT)
+			{
+				StreamOut();
+			}
+
+			memory_usage = usage;
+		}
+	}
+
+	namespace TextureCooking
+	{
+		std::string path = "cooked_textures/";
+		bool enabled = false; // only enabled when the directory exists, so that loading doesn't check each image for a cooked texture
+
+		void Refresh()
+		{
+			std::error_code ec;
+			enabled = std::filesystem::is_directory(path, ec);
+		}
+	}
+
+	// Creates the resource from file data, the resource->filedata is kept or released depending on the IMPORT_RETAIN_FILEDATA flag
+	bool Import(wiResource* resource, const std::string& name, uint32_t flags, const uint8_t* filedata, size_t filesize)
+	{
 		std::string ext = wiHelper::toUpper(wiHelper::GetExtensionFromFileName(name));
 		wiResource::DATA_TYPE type;
 
@@ -82,7 +591,7 @@ namespace wiResourceManager
 			}
 			else
 			{
-				return nullptr;
+				return false;
 			}
 		}
 
@@ -93,146 +602,48 @@ namespace wiResourceManager
 		case wiResource::IMAGE:
 		{
 			GraphicsDevice* device = wiRenderer::GetDevice();
-			if (!ext.compare(std::string("DDS")))
+
+			// Source images are replaced by their cooked DDS if it exists (see wiTextureCooker):
+			std::string cooked_name;
+			std::vector<uint8_t> cooked;
+			if (ext.compare(std::string("DDS")) && !(flags & IMPORT_COLORGRADINGLUT) && TextureCooking::enabled)
+			{
+				cooked_name = TextureCooking::path + wiTextureCooker::GetCookedFileName(filedata, filesize);
+				if (!wiHelper::FileExists(cooked_name) || !wiHelper::FileRead(cooked_name, cooked))
+				{
+					cooked_name.clear();
+					cooked.clear();
+				}
+			}
+
+			if (!ext.compare(std::string("DDS")) || !cooked_name.empty())
 			{
 				// Load dds
 
 				tinyddsloader::DDSFile dds;
-				auto result = dds.Load(filedata, filesize);
+				auto result = cooked_name.empty() ? dds.Load(filedata, filesize) : dds.Load(std::move(cooked));
 
 				if (result == tinyddsloader::Result::Success)
 				{
-					TextureDesc desc;
-					desc.ArraySize = 1;
-					desc.BindFlags = BIND_SHADER_RESOURCE;
-					desc.CPUAccessFlags = 0;
-					desc.Width = dds.GetWidth();
-					desc.Height = dds.GetHeight();
-					desc.Depth = dds.GetDepth();
-					desc.MipLevels = dds.GetMipCount();
-					desc.ArraySize = dds.GetArraySize();
-					desc.MiscFlags = 0;
-					desc.Usage = USAGE_IMMUTABLE;
-					desc.Format = FORMAT_R8G8B8A8_UNORM;
-					desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE;
-
-					if (dds.IsCubemap())
-					{
-						desc.MiscFlags |= RESOURCE_MISC_TEXTURECUBE;
-					}
-
-					auto ddsFormat = dds.GetFormat();
-
-					switch (ddsFormat)
-					{
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32B32A32_Float: desc.Format = FORMAT_R32G32B32A32_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32B32A32_UInt: desc.Format = FORMAT_R32G32B32A32_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32B32A32_SInt: desc.Format = FORMAT_R32G32B32A32_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32B32_Float: desc.Format = FORMAT_R32G32B32_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32B32_UInt: desc.Format = FORMAT_R32G32B32_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32B32_SInt: desc.Format = FORMAT_R32G32B32_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_Float: desc.Format = FORMAT_R16G16B16A16_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_UNorm: desc.Format = FORMAT_R16G16B16A16_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_UInt: desc.Format = FORMAT_R16G16B16A16_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_SNorm: desc.Format = FORMAT_R16G16B16A16_SNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16B16A16_SInt: desc.Format = FORMAT_R16G16B16A16_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32_Float: desc.Format = FORMAT_R32G32_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32_UInt: desc.Format = FORMAT_R32G32_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32G32_SInt: desc.Format = FORMAT_R32G32_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R10G10B10A2_UNorm: desc.Format = FORMAT_R10G10B10A2_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R10G10B10A2_UInt: desc.Format = FORMAT_R10G10B10A2_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R11G11B10_Float: desc.Format = FORMAT_R11G11B10_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::B8G8R8A8_UNorm: desc.Format = FORMAT_B8G8R8A8_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::B8G8R8A8_UNorm_SRGB: desc.Format = FORMAT_B8G8R8A8_UNORM_SRGB; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_UNorm: desc.Format = FORMAT_R8G8B8A8_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_UNorm_SRGB: desc.Format = FORMAT_R8G8B8A8_UNORM_SRGB; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_UInt: desc.Format = FORMAT_R8G8B8A8_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_SNorm: desc.Format = FORMAT_R8G8B8A8_SNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8B8A8_SInt: desc.Format = FORMAT_R8G8B8A8_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16_Float: desc.Format = FORMAT_R16G16_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16_UNorm: desc.Format = FORMAT_R16G16_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16_UInt: desc.Format = FORMAT_R16G16_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16_SNorm: desc.Format = FORMAT_R16G16_SNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16G16_SInt: desc.Format = FORMAT_R16G16_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::D32_Float: desc.Format = FORMAT_D32_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32_Float: desc.Format = FORMAT_R32_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32_UInt: desc.Format = FORMAT_R32_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R32_SInt: desc.Format = FORMAT_R32_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8_UNorm: desc.Format = FORMAT_R8G8_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8_UInt: desc.Format = FORMAT_R8G8_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8_SNorm: desc.Format = FORMAT_R8G8_SNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8G8_SInt: desc.Format = FORMAT_R8G8_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16_Float: desc.Format = FORMAT_R16_FLOAT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::D16_UNorm: desc.Format = FORMAT_D16_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16_UNorm: desc.Format = FORMAT_R16_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16_UInt: desc.Format = FORMAT_R16_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16_SNorm: desc.Format = FORMAT_R16_SNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R16_SInt: desc.Format = FORMAT_R16_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8_UNorm: desc.Format = FORMAT_R8_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8_UInt: desc.Format = FORMAT_R8_UINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8_SNorm: desc.Format = FORMAT_R8_SNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::R8_SInt: desc.Format = FORMAT_R8_SINT; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC1_UNorm: desc.Format = FORMAT_BC1_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC1_UNorm_SRGB: desc.Format = FORMAT_BC1_UNORM_SRGB; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC2_UNorm: desc.Format = FORMAT_BC2_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC2_UNorm_SRGB: desc.Format = FORMAT_BC2_UNORM_SRGB; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC3_UNorm: desc.Format = FORMAT_BC3_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC3_UNorm_SRGB: desc.Format = FORMAT_BC3_UNORM_SRGB; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC4_UNorm: desc.Format = FORMAT_BC4_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC4_SNorm: desc.Format = FORMAT_BC4_SNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC5_UNorm: desc.Format = FORMAT_BC5_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC5_SNorm: desc.Format = FORMAT_BC5_SNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC7_UNorm: desc.Format = FORMAT_BC7_UNORM; break;
-					case tinyddsloader::DDSFile::DXGIFormat::BC7_UNorm_SRGB: desc.Format = FORMAT_BC7_UNORM_SRGB; break;
-					default:
-						assert(0); // incoming format is not supported 
-						break;
-					}
-
-					std::vector<SubresourceData> InitData;
-					for (uint32_t arrayIndex = 0; arrayIndex < desc.ArraySize; ++arrayIndex)
+					uint32_t first_mip = 0;
+					if ((flags & IMPORT_TEXTURE_STREAMING) && TextureStreaming::enabled)
 					{
-						for (uint32_t mip = 0; mip < desc.MipLevels; ++mip)
+						if (cooked_name.empty())
 						{
-							auto imageData = dds.GetImageData(mip, arrayIndex);
-							SubresourceData subresourceData;
-							subresourceData.pSysMem = imageData->m_mem;
-							subresourceData.SysMemPitch = imageData->m_memPitch;
-							subresourceData.SysMemSlicePitch = imageData->m_memSlicePitch;
-							InitData.push_back(subresourceData);
+							resource->streaming_texture = TextureStreaming::Create(dds, name, filedata == resource->filedata.data() ? nullptr : filedata, filesize);
+						}
+						else
+						{
+							// the higher mips are streamed from the cooked file, the retained file data remains the source image:
+							resource->streaming_texture = TextureStreaming::Create(dds, cooked_name, nullptr, 0);
+						}
+						if (resource->streaming_texture != nullptr)
+						{
+							first_mip = resource->streaming_texture->min_mip;
 						}
 					}
 
-					auto dim = dds.GetTextureDimension();
-					switch (dim)
-					{
-					case tinyddsloader::DDSFile::TextureDimension::Texture1D:
-					{
-						desc.type = TextureDesc::TEXTURE_1D;
-					}
-					break;
-					case tinyddsloader::DDSFile::TextureDimension::Texture2D:
-					{
-						desc.type = TextureDesc::TEXTURE_2D;
-					}
-					break;
-					case tinyddsloader::DDSFile::TextureDimension::Texture3D:
-					{
-						desc.type = TextureDesc::TEXTURE_3D;
-					}
-					break;
-					default:
-						assert(0);
-						break;
-					}
-
-					if (device->IsFormatBlockCompressed(desc.Format))
-					{
-						desc.Width = std::max(4u, desc.Width);
-						desc.Height = std::max(4u, desc.Height);
-					}
-
-					success = device->CreateTexture(&desc, InitData.data(), &resource->texture);
+					success = CreateTextureDDS(dds, first_mip, &resource->texture);
 					device->SetName(&resource->texture, name.c_str());
 				}
 				else assert(0); // failed to load DDS
@@ -352,36 +763,344 @@ namespace wiResourceManager
 				resource->filedata.clear();
 			}
 
-			if (type == wiResource::IMAGE && resource->texture.desc.MipLevels > 1 && resource->texture.desc.BindFlags & BIND_UNORDERED_ACCESS)
+			return true;
+		}
+
+		return false;
+	}
+	inline bool IsMIPGenRequired(const wiResource* resource)
+	{
+		return resource->type == wiResource::IMAGE && resource->texture.desc.MipLevels > 1 && resource->texture.desc.BindFlags & BIND_UNORDERED_ACCESS;
+	}
+
+	std::shared_ptr<wiResource> Load(const std::string& name, uint32_t flags, const uint8_t* filedata, size_t filesize)
+	{
+		if (mode == MODE_DISCARD_FILEDATA_AFTER_LOAD)
+		{
+			flags &= ~IMPORT_RETAIN_FILEDATA;
+		}
+
+		const size_t hash = Cache::Hash(name);
+		Cache::Shard& shard = Cache::GetShard(hash);
+
+		std::unique_lock<std::mutex> lock(shard.locker);
+		Cache::Entry* entry = Cache::FindLoaded(shard, hash, name, lock);
+		std::shared_ptr<wiResource> resource = entry == nullptr ? nullptr : entry->resource.lock();
+		if (resource != nullptr)
+		{
+			return resource;
+		}
+		resource = std::make_shared<wiResource>();
+		if (entry == nullptr)
+		{
+			entry = &Cache::Insert(shard, hash, name);
+		}
+		entry->resource = resource;
+		entry->loading = true;
+		lock.unlock();
+
+		bool success = true;
+		if (filedata == nullptr || filesize == 0)
+		{
+			success = wiHelper::FileRead(name, resource->filedata);
+			filedata = resource->filedata.data();
+			filesize = resource->filedata.size();
+		}
+
+		success = success && Import(resource.get(), name, flags, filedata, filesize);
+		if (success)
+		{
+			if (IsMIPGenRequired(resource.get()))
 			{
 				wiRenderer::AddDeferredMIPGen(resource, true);
 			}
+			if (resource->streaming_texture != nullptr)
+			{
+				TextureStreaming::Register(resource);
+			}
+		}
+
+		Cache::FinishLoading(shard, hash, name, resource.get(), success);
+
+		return success ? resource : nullptr;
+	}
 
+	namespace Streaming
+	{
+		struct Request
+		{
+			std::weak_ptr<wiResource> resource; // not owning, so the request is cancelled when nobody holds the resource
+			std::string name;
+			uint32_t flags = 0;
+			int priority = 0;
+			uint64_t order = 0; // requests with the same priority are started in request order
+
+			bool operator<(const Request& other) const
+			{
+				// std::priority_queue pops the largest element first:
+				return priority < other.priority || (priority == other.priority && order > other.order);
+			}
+		};
+		struct Result
+		{
+			std::weak_ptr<wiResource> resource;
+			std::shared_ptr<wiResource> loaded; // nullptr if loading failed
+		};
+
+		std::mutex locker;
+		std::priority_queue<Request> requests;
+		std::vector<Result> results; // finished requests, they are published at the thread safe point
+		uint64_t order = 0;
+		size_t inflight_memory = 0;
+		uint32_t inflight_count = 0;
+		size_t memory_budget = 256ull * 1024ull * 1024ull;
+		wiJobSystem::context ctx;
+		wiEvent::Handle publish_handle;
+
+		void Kick();
+
+		// Reads and decodes a resource on a worker thread:
+		void Process(const Request& request, size_t reserved_memory)
+		{
+			size_t memory = reserved_memory;
+			std::shared_ptr<wiResource> loaded;
+
+			if (!request.resource.expired())
+			{
+				loaded = std::make_shared<wiResource>();
+				bool success = wiHelper::FileRead(request.name, loaded->filedata);
+
+				if (success && !loaded->filedata.empty())
+				{
+					// Decoded image memory is also counted, so the budget covers the whole import:
+					int width, height, channels;
+					if (stbi_info_from_memory(loaded->filedata.data(), (int)loaded->filedata.size(), &width, &height, &channels))
+					{
+						const size_t decoded_memory = size_t(width) * size_t(height) * 4;
+						locker.lock();
+						inflight_memory += decoded_memory;
+						locker.unlock();
+						memory += decoded_memory;
+					}
+				}
+
+				// The request could have been cancelled while the file was read:
+				success = success && !request.resource.expired();
+				success = success && Import(loaded.get(), request.name, request.flags, loaded->filedata.data(), loaded->filedata.size());
+				if (!success)
+				{
+					loaded.reset();
+				}
+			}
+
+			locker.lock();
+			inflight_memory -= memory;
+			inflight_count--;
+			results.push_back({ request.resource, loaded });
+			Kick();
+			locker.unlock();
+		}
+
+		// Starts requests in priority order while the in-flight memory budget allows it, locker must be held
+		void Kick()
+		{
+			while (!requests.empty() && (inflight_count == 0 || inflight_memory < memory_budget))
+			{
+				Request request = requests.top();
+				requests.pop();
+				if (request.resource.expired())
+				{
+					continue; // cancelled
+				}
+
+				// The file size is reserved from the budget before reading it:
+				std::error_code ec;
+				uintmax_t filesize = std::filesystem::file_size(request.name, ec);
+				const size_t reserved_memory = ec ? 0 : (size_t)filesize;
+				inflight_memory += reserved_memory;
+				inflight_count++;
+
+				wiJobSystem::Execute(ctx, [request, reserved_memory](wiJobArgs args) {
+					Process(request, reserved_memory);
+				});
+			}
+		}
+
+		// Replaces placeholders with the loaded resources, this is called on the main thread when no rendering is in progress
+		void Publish()
+		{
+			std::vector<Result> finished;
+			locker.lock();
+			finished.swap(results);
+			locker.unlock();
+
+			for (auto& result : finished)
+			{
+				std::shared_ptr<wiResource> resource = result.resource.lock();
+				if (resource == nullptr)
+				{
+					continue;
+				}
+				resource->streaming = false;
+				if (result.loaded == nullptr)
+				{
+					continue; // failed, the placeholder is kept
+				}
+				resource->texture = result.loaded->texture;
+				resource->sound = result.loaded->sound;
+				resource->filedata = std::move(result.loaded->filedata);
+				resource->flags = result.loaded->flags;
+				resource->type = result.loaded->type;
+				resource->streaming_texture = result.loaded->streaming_texture;
+
+				if (IsMIPGenRequired(resource.get()))
+				{
+					wiRenderer::AddDeferredMIPGen(resource, true);
+				}
+				if (resource->streaming_texture != nullptr)
+				{
+					TextureStreaming::Register(resource);
+				}
+			}
+		}
+	}
+
+	void Initialize()
+	{
+		TextureCooking::Refresh();
+
+		Streaming::publish_handle = wiEvent::Subscribe(SYSTEM_EVENT_THREAD_SAFE_POINT, [](uint64_t userdata) {
+			Streaming::Publish();
+			TextureStreaming::Update();
+		});
+	}
+
+	std::shared_ptr<wiResource> LoadAsync(const std::string& name, uint32_t flags, int priority, const Texture* placeholder)
+	{
+		if (mode == MODE_DISCARD_FILEDATA_AFTER_LOAD)
+		{
+			flags &= ~IMPORT_RETAIN_FILEDATA;
+		}
+
+		const size_t hash = Cache::Hash(name);
+		Cache::Shard& shard = Cache::GetShard(hash);
+
+		// If Load() is importing the same resource on an other thread, that is waited, because it can't be published as a placeholder:
+		std::unique_lock<std::mutex> lock(shard.locker);
+		Cache::Entry* entry = Cache::FindLoaded(shard, hash, name, lock);
+		std::shared_ptr<wiResource> resource = entry == nullptr ? nullptr : entry->resource.lock();
+		if (resource != nullptr)
+		{
 			return resource;
 		}
+		resource = std::make_shared<wiResource>();
+		resource->streaming = true;
+		if (placeholder == nullptr)
+		{
+			placeholder = wiTextureHelper::getWhite();
+		}
+		if (placeholder != nullptr)
+		{
+			resource->texture = *placeholder;
+		}
+		if (entry == nullptr)
+		{
+			entry = &Cache::Insert(shard, hash, name);
+		}
+		entry->resource = resource;
+		lock.unlock();
+
+		Streaming::Request request;
+		request.resource = resource;
+		request.name = name;
+		request.flags = flags;
+		request.priority = priority;
+
+		Streaming::locker.lock();
+		request.order = Streaming::order++;
+		Streaming::requests.push(request);
+		Streaming::Kick();
+		Streaming::locker.unlock();
 
-		return nullptr;
+		return resource;
+	}
+
+	void SetStreamingMemoryBudget(size_t bytes)
+	{
+		Streaming::locker.lock();
+		Streaming::memory_budget = bytes;
+		Streaming::Kick();
+		Streaming::locker.unlock();
+	}
+	size_t GetStreamingMemoryBudget()
+	{
+		return Streaming::memory_budget;
+	}
+	bool IsStreamingBusy()
+	{
+		Streaming::locker.lock();
+		bool result = !Streaming::requests.empty() || Streaming::inflight_count > 0 || !Streaming::results.empty();
+		Streaming::locker.unlock();
+		return result;
+	}
+
+	void SetTextureStreamingEnabled(bool value)
+	{
+		TextureStreaming::enabled = value;
+	}
+	bool IsTextureStreamingEnabled()
+	{
+		return TextureStreaming::enabled;
+	}
+	void SetTextureStreamingMemoryBudget(size_t bytes)
+	{
+		TextureStreaming::memory_budget = bytes;
+	}
+	size_t GetTextureStreamingMemoryBudget()
+	{
+		return TextureStreaming::memory_budget;
+	}
+	size_t GetTextureStreamingMemoryUsage()
+	{
+		return TextureStreaming::memory_usage;
+	}
+
+	void SetCookedTexturePath(const std::string& path)
+	{
+		TextureCooking::path = path;
+		TextureCooking::Refresh();
+	}
+	const std::string& GetCookedTexturePath()
+	{
+		return TextureCooking::path;
 	}
 
 	bool Contains(const std::string& name)
 	{
 		bool result = false;
-		locker.lock();
-		auto it = resources.find(name);
-		if (it != resources.end())
+		const size_t hash = Cache::Hash(name);
+		Cache::Shard& shard = Cache::GetShard(hash);
+		shard.locker.lock();
+		const Cache::Entry* entry = Cache::Find(shard, hash, name);
+		if (entry != nullptr && !entry->loading)
 		{
-			auto resource = it->second.lock();
+			auto resource = entry->resource.lock();
 			result = resource != nullptr && resource->type != wiResource::EMPTY;
 		}
-		locker.unlock();
+		shard.locker.unlock();
 		return result;
 	}
 
 	void Clear()
 	{
-		locker.lock();
-		resources.clear();
-		locker.unlock();
+		for (auto& shard : Cache::shards)
+		{
+			shard.locker.lock();
+			shard.entries.clear();
+			shard.sweep_threshold = Cache::MIN_SWEEP_THRESHOLD;
+			shard.locker.unlock();
+			shard.loaded.notify_all();
+		}
 	}
 
 
@@ -427,7 +1146,6 @@ namespace wiResourceManager
 		}
 		else
 		{
-			locker.lock();
 			size_t serializable_count = 0;
 
 			if (mode == MODE_ALLOW_RETAIN_FILEDATA_BUT_DISABLE_EMBEDDING)
@@ -438,34 +1156,39 @@ namespace wiResourceManager
 			}
 			else
 			{
-				// Count embedded resources:
-				for (auto& it : resources)
+				// Gather embedded resources, the shards are only locked while they are searched:
+				std::vector<std::pair<std::string, std::shared_ptr<wiResource>>> embedded;
+				for (auto& shard : Cache::shards)
 				{
-					std::shared_ptr<wiResource> resource = it.second.lock();
-					if (resource != nullptr && !resource->filedata.empty())
+					shard.locker.lock();
+					for (auto& it : shard.entries)
 					{
-						serializable_count++;
+						if (it.second.loading)
+						{
+							continue;
+						}
+						std::shared_ptr<wiResource> resource = it.second.resource.lock();
+						if (resource != nullptr && !resource->filedata.empty())
+						{
+							embedded.emplace_back(it.second.name, std::move(resource));
+						}
 					}
+					shard.locker.unlock();
 				}
+				serializable_count = embedded.size();
 
 				// Write all embedded resources:
 				archive << serializable_count;
-				for (auto& it : resources)
+				for (auto& it : embedded)
 				{
-					std::shared_ptr<wiResource> resource = it.second.lock();
-
-					if (resource != nullptr && !resource->filedata.empty())
-					{
-						std::string name = it.first;
-						wiHelper::MakePathRelative(archive.GetSourceDirectory(), name);
+					std::string name = it.first;
+					wiHelper::MakePathRelative(archive.GetSourceDirectory(), name);
 
-						archive << name;
-						archive << resource->flags;
-						archive << resource->filedata;
-					}
+					archive << name;
+					archive << it.second->flags;
+					archive << it.second->filedata;
 				}
 			}
-			locker.unlock();
 		}
 	}
 
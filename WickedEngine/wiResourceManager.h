@@ -8,6 +8,7 @@
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <atomic>
 
 struct wiResource
 {
@@ -23,10 +24,38 @@ struct wiResource
 
 	uint32_t flags = 0;
 	std::vector<uint8_t> filedata;
+	bool streaming = false; // the resource was requested with wiResourceManager::LoadAsync() and it's not loaded yet, the texture is a placeholder until then
+
+	// Mip streaming state of textures that were loaded with IMPORT_TEXTURE_STREAMING, see wiResourceManager::SetTextureStreamingEnabled()
+	struct StreamingTexture
+	{
+		std::string filename; // the DDS file that the mip levels are read from
+		std::vector<uint8_t> filedata; // if the resource was not loaded from a file, the DDS data is kept here instead
+		std::vector<size_t> mip_memory; // GPU memory of the texture if the given mip is the most detailed resident mip
+		uint32_t resolution = 0; // larger dimension of the full resolution texture
+		uint32_t min_mip = 0; // the low resolution mips starting from this are always resident
+		uint32_t resident_mip = 0; // the most detailed mip level that is resident
+		uint32_t target_mip = 0; // if this is different from resident_mip, the texture is being recreated with this most detailed mip
+		uint32_t desired_mip = 0; // the most detailed mip level that was requested in the last update
+		uint64_t last_used_frame = 0;
+		bool texture_changed = false; // the texture was replaced in this frame, so descriptors that refer to it must be updated
+		std::atomic<uint32_t> requested_resolution{ 0 }; // the largest resolution that was requested since the last update
+
+		// Request the resolution that the texture is displayed with (larger dimension in pixels), it can be called from multiple threads
+		inline void RequestResolution(uint32_t value)
+		{
+			uint32_t prev = requested_resolution.load(std::memory_order_relaxed);
+			while (prev < value && !requested_resolution.compare_exchange_weak(prev, value, std::memory_order_relaxed));
+		}
+	};
+	std::shared_ptr<StreamingTexture> streaming_texture; // only valid if the texture mips are streamed
 };
 
 namespace wiResourceManager
 {
+	// Subscribes to the thread safe point event, which finishes asynchronous loading
+	void Initialize();
+
 	enum MODE
 	{
 		MODE_DISCARD_FILEDATA_AFTER_LOAD,	// default behaviour: file data will be discarded after loaded. This will not allow serialization of embedded resources, but less memory will be used overall
@@ -42,9 +71,11 @@ namespace wiResourceManager
 		EMPTY = 0,
 		IMPORT_COLORGRADINGLUT = 1 << 0, // image import will convert resource to 3D color grading LUT
 		IMPORT_RETAIN_FILEDATA = 1 << 1, // file data will be kept for later reuse. This is necessary for keeping the resource serializable
+		IMPORT_TEXTURE_STREAMING = 1 << 2, // DDS textures with mip levels will only keep their low resolution mips resident, when texture streaming is enabled
 	};
 
 	// Load a resource
+	//	If an other thread is loading the same resource, this waits for it and returns the same resource
 	//	name : file name of resource
 	//	flags : specify flags that modify behaviour (optional)
 	//	filedata : pointer to file data, if file was loaded manually (optional)
@@ -55,6 +86,40 @@ namespace wiResourceManager
 		const uint8_t* filedata = nullptr,
 		size_t filesize = 0
 	);
+	// Load a resource asynchronously, the resource is returned immediately, and its texture is a placeholder until loading finishes
+	//	The loaded data replaces the placeholder at the SYSTEM_EVENT_THREAD_SAFE_POINT event, when wiResource::streaming is set to false
+	//	If all references to the resource are released before loading starts, the request is cancelled
+	//	name : file name of resource
+	//	flags : specify flags that modify behaviour (optional)
+	//	priority : requests with higher priority are loaded first (optional)
+	//	placeholder : the texture that is used until the resource is loaded, by default it's a white texture (optional)
+	std::shared_ptr<wiResource> LoadAsync(
+		const std::string& name,
+		uint32_t flags = EMPTY,
+		int priority = 0,
+		const wiGraphics::Texture* placeholder = nullptr
+	);
+	// Limit the memory of resources that are loaded asynchronously at the same time (file data and decoded images)
+	//	At least one resource is always loaded, even if it exceeds the budget
+	void SetStreamingMemoryBudget(size_t bytes);
+	size_t GetStreamingMemoryBudget();
+	// Check if there are asynchronous load requests that are not finished
+	bool IsStreamingBusy();
+	// Enable texture mip streaming for textures that are loaded with IMPORT_TEXTURE_STREAMING after this (disabled by default)
+	//	Only the low resolution mips are created when the texture is loaded, the higher resolution mips are streamed in when
+	//	wiRenderer::UpdateVisibility() requests them, and streamed out when the memory budget is exceeded
+	//	Mip level changes are applied at the SYSTEM_EVENT_THREAD_SAFE_POINT event
+	void SetTextureStreamingEnabled(bool value);
+	bool IsTextureStreamingEnabled();
+	// Limit the GPU memory of streaming textures, the always resident low resolution mips are also counted, but never streamed out
+	void SetTextureStreamingMemoryBudget(size_t bytes);
+	size_t GetTextureStreamingMemoryBudget();
+	// Returns the GPU memory of the resident mips of streaming textures, including the ones that are being streamed out
+	size_t GetTextureStreamingMemoryUsage();
+	// Set the directory of cooked textures (default: "cooked_textures/"), see wiTextureCooker
+	//	When the directory exists, PNG, JPG, TGA and BMP images are loaded from their cooked DDS instead, if it was cooked
+	void SetCookedTexturePath(const std::string& path);
+	const std::string& GetCookedTexturePath();
 	// Check if a resource is currently loaded
 	bool Contains(const std::string& name);
 	// Invalidate all resources
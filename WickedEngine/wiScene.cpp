@@ -351,7 +351,7 @@ namespace wiScene
 		{
 			if (!x.name.empty())
 			{
-				x.resource = wiResourceManager::Load(x.name, wiResourceManager::IMPORT_RETAIN_FILEDATA);
+				x.resource = wiResourceManager::Load(x.name, wiResourceManager::IMPORT_RETAIN_FILEDATA | wiResourceManager::IMPORT_TEXTURE_STREAMING);
 			}
 		}
 
@@ -382,6 +382,11 @@ namespace wiScene
 	{
 		GraphicsDevice* device = wiRenderer::GetDevice();
 
+		revision++;
+
+		// The triangle BVH will be rebuilt by the mesh update system:
+		bvh.Clear();
+
 		// Create index buffer GPU data:
 		{
 			GPUBufferDesc bd;
@@ -1496,53 +1501,95 @@ namespace wiScene
 			}
 		}
 
-		wiJobSystem::context ctx;
+		// The systems are executed as a task graph. Each system declares which scene data it reads and writes,
+		//	and it will only wait for the systems that it really depends on. Systems that don't conflict run concurrently.
+		//	When systems conflict, they will execute in the order that they are added here.
+		//	Transforms are declared as two resources: &transforms is the world matrices, and &transforms_local is the local space (scale, rotation, translation) with the dirty flag
+		wiJobSystem::TaskGraph graph;
+		const uint8_t transforms_local = 0; // resource token, only its address is used
+
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunPreviousFrameTransformUpdateSystem(ctx); },
+			{ &transforms }, { &prev_transforms });
 
-		RunPreviousFrameTransformUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunAnimationUpdateSystem(ctx); },
+			{ &objects }, { &animations, &animation_datas, &transforms, &transforms_local, &meshes });
 
-		RunAnimationUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunTransformUpdateSystem(ctx); },
+			{}, { &transforms, &transforms_local });
 
-		RunTransformUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunWeatherUpdateSystem(ctx); },
+			{ &weathers }, { &weather });
 
-		wiJobSystem::Wait(ctx); // dependencies
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunHierarchyUpdateSystem(ctx); },
+			{ &hierarchy, &transforms_local }, { &transforms, &layers });
 
-		RunHierarchyUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunSpringUpdateSystem(ctx); },
+			{ &hierarchy, &weather }, { &springs, &transforms, &transforms_local });
 
-		RunSpringUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunInverseKinematicsUpdateSystem(ctx); },
+			{ &inverse_kinematics, &hierarchy }, { &transforms, &transforms_local });
 
-		RunInverseKinematicsUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunArmatureUpdateSystem(ctx); },
+			{ &transforms }, { &armatures });
 
-		RunArmatureUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunMaterialUpdateSystem(ctx); },
+			{ &layers }, { &materials });
 
-		RunMeshUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunMeshUpdateSystem(ctx); },
+			{ &armatures, &softbodies, &materials }, { &meshes });
 
-		RunMaterialUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunImpostorUpdateSystem(ctx); },
+			{}, { &impostors });
 
-		RunImpostorUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunCameraUpdateSystem(ctx); },
+			{ &transforms }, { &cameras });
 
-		RunWeatherUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunDecalUpdateSystem(ctx); },
+			{ &transforms, &layers, &materials }, { &decals, &aabb_decals });
 
-		wiPhysicsEngine::RunPhysicsUpdateSystem(ctx, *this, dt);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunProbeUpdateSystem(ctx); },
+			{ &transforms, &layers }, { &probes, &aabb_probes });
 
-		wiJobSystem::Wait(ctx); // dependencies
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunForceUpdateSystem(ctx); },
+			{ &transforms }, { &forces });
 
-		RunObjectUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunLightUpdateSystem(ctx); },
+			{ &transforms, &layers }, { &lights, &aabb_lights, &weather });
 
-		RunCameraUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunSoundUpdateSystem(ctx); },
+			{ &transforms }, { &sounds });
 
-		RunDecalUpdateSystem(ctx);
+		// Physics reads the world matrices and writes the local space of simulated transforms (used by the next frame's transform update),
+		//	so it runs concurrently with the systems that only read world matrices:
+		graph.AddTask([&](wiJobSystem::context& ctx) { wiPhysicsEngine::RunPhysicsUpdateSystem(ctx, *this, dt); },
+			{ &transforms, &objects, &armatures, &weather }, { &transforms_local, &rigidbodies, &softbodies, &meshes });
 
-		RunProbeUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunObjectUpdateSystem(ctx); },
+			{ &meshes, &transforms, &prev_transforms, &armatures, &materials, &layers }, { &objects, &aabb_objects, &impostors, &softbodies });
 
-		RunForceUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { RunParticleUpdateSystem(ctx); },
+			{ &layers, &transforms, &meshes }, { &emitters, &hairs });
 
-		RunLightUpdateSystem(ctx);
+		// Culling BVHs are updated as soon as their bounding boxes are ready:
+		auto update_bvh = [](wiJobSystem::context& ctx, wiBVH& bvh, const wiECS::ComponentManager<AABB>& aabbs) {
+			const uint32_t count = (uint32_t)aabbs.GetCount();
+			bvh.Update(ctx, count > 0 ? &aabbs[0] : nullptr, count);
+		};
+		graph.AddTask([&](wiJobSystem::context& ctx) { update_bvh(ctx, bvh_objects, aabb_objects); },
+			{ &aabb_objects }, { &bvh_objects });
+
+		graph.AddTask([&](wiJobSystem::context& ctx) { update_bvh(ctx, bvh_lights, aabb_lights); },
+			{ &aabb_lights }, { &bvh_lights });
 
-		RunParticleUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { update_bvh(ctx, bvh_decals, aabb_decals); },
+			{ &aabb_decals }, { &bvh_decals });
 
-		RunSoundUpdateSystem(ctx);
+		graph.AddTask([&](wiJobSystem::context& ctx) { update_bvh(ctx, bvh_probes, aabb_probes); },
+			{ &aabb_probes }, { &bvh_probes });
 
-		wiJobSystem::Wait(ctx); // dependencies
+		wiJobSystem::context ctx;
+		graph.Run(ctx);
+		wiJobSystem::Wait(ctx);
 
 		// Merge parallel bounds computation (depends on object update system):
 		bounds = AABB();
@@ -1708,6 +1755,10 @@ namespace wiScene
 
 		TLAS = RaytracingAccelerationStructure();
 		BVH.Clear();
+		bvh_objects.Clear();
+		bvh_lights.Clear();
+		bvh_decals.Clear();
+		bvh_probes.Clear();
 		packedDecals.clear();
 		waterRipples.clear();
 	}
@@ -2144,18 +2195,21 @@ namespace wiScene
 	}
 	void Scene::RunAnimationUpdateSystem(wiJobSystem::context& ctx)
 	{
-		for (size_t i = 0; i < animations.GetCount(); ++i)
+		const uint32_t animationCount = (uint32_t)animations.GetCount();
+		auto is_active = [](const AnimationComponent& animation) {
+			return animation.IsPlaying() || animation.timer != 0.0f;
+		};
+
+		// Backwards-compatibility conversion creates components, so it is done before the parallel update:
+		for (uint32_t i = 0; i < animationCount; ++i)
 		{
 			AnimationComponent& animation = animations[i];
-			if (!animation.IsPlaying() && animation.timer == 0.0f)
+			if (!is_active(animation))
 			{
 				continue;
 			}
-
-			for (const AnimationComponent::AnimationChannel& channel : animation.channels)
+			for (AnimationComponent::AnimationSampler& sampler : animation.samplers)
 			{
-				assert(channel.samplerIndex < (int)animation.samplers.size());
-				AnimationComponent::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
 				if (sampler.data == INVALID_ENTITY)
 				{
 					// backwards-compatibility mode
@@ -2164,8 +2218,71 @@ namespace wiScene
 					sampler.backwards_compatibility_data.keyframe_times.clear();
 					sampler.backwards_compatibility_data.keyframe_data.clear();
 				}
+			}
+		}
+
+		// Animations are updated in parallel, except those that share a target with an other animation,
+		//	because those are blended together in order. They are updated serially in a single job instead:
+		std::vector<uint64_t> animation_targets; // target entity << 32 | animation index
+		std::vector<uint8_t> animation_serial(animationCount, 0);
+		std::vector<uint32_t> active_animations;
+		for (uint32_t i = 0; i < animationCount; ++i)
+		{
+			const AnimationComponent& animation = animations[i];
+			if (!is_active(animation))
+			{
+				continue;
+			}
+			active_animations.push_back(i);
+			for (const AnimationComponent::AnimationChannel& channel : animation.channels)
+			{
+				Entity target = channel.target;
+				if (channel.path == AnimationComponent::AnimationChannel::Path::WEIGHTS)
+				{
+					const ObjectComponent* object = objects.GetComponent(channel.target);
+					if (object != nullptr)
+					{
+						target = object->meshID;
+					}
+				}
+				animation_targets.push_back((uint64_t(target) << 32ull) | uint64_t(i));
+			}
+		}
+		std::sort(animation_targets.begin(), animation_targets.end());
+		for (size_t j = 1; j < animation_targets.size(); ++j)
+		{
+			const uint64_t prev = animation_targets[j - 1];
+			const uint64_t next = animation_targets[j];
+			if ((prev >> 32ull) == (next >> 32ull) && prev != next)
+			{
+				animation_serial[uint32_t(prev)] = 1;
+				animation_serial[uint32_t(next)] = 1;
+			}
+		}
+		// The jobs only get the index lists, because they must not read the state of animations that other jobs are updating (the timer):
+		std::vector<uint32_t> parallel_animations;
+		std::vector<uint32_t> serial_animations;
+		for (uint32_t i : active_animations)
+		{
+			if (animation_serial[i])
+			{
+				serial_animations.push_back(i);
+			}
+			else
+			{
+				parallel_animations.push_back(i);
+			}
+		}
+
+		auto update_animation = [&](uint32_t i) {
+			AnimationComponent& animation = animations[i];
+
+			for (const AnimationComponent::AnimationChannel& channel : animation.channels)
+			{
+				assert(channel.samplerIndex < (int)animation.samplers.size());
+				AnimationComponent::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
 				const AnimationDataComponent* animationdata = animation_datas.GetComponent(sampler.data);
-				if (animationdata == nullptr)
+				if (animationdata == nullptr || animationdata->keyframe_times.empty())
 				{
 					continue;
 				}
@@ -2173,16 +2290,33 @@ namespace wiScene
 				int keyLeft = 0;
 				int keyRight = 0;
 
-				if (animationdata->keyframe_times.back() < animation.timer)
+				const std::vector<float>& keyframe_times = animationdata->keyframe_times;
+				const int keyCount = (int)keyframe_times.size();
+				if (keyframe_times.back() < animation.timer)
 				{
 					// Rightmost keyframe is already outside animation, so just snap to last keyframe:
-					keyLeft = keyRight = (int)animationdata->keyframe_times.size() - 1;
+					keyLeft = keyRight = keyCount - 1;
 				}
 				else
 				{
-					// Search for the right keyframe (greater/equal to anim time):
-					while (animationdata->keyframe_times[keyRight++] < animation.timer) {}
-					keyRight--;
+					// Search for the right keyframe (greater/equal to anim time)
+					//	The result of the previous update is checked first, because playback usually stays on the same or advances to the next keyframe:
+					auto is_right_key = [&](int key) {
+						return keyframe_times[key] >= animation.timer && (key == 0 || keyframe_times[key - 1] < animation.timer);
+					};
+					keyRight = std::min(std::max(0, sampler.keyframe_cursor), keyCount - 1);
+					if (!is_right_key(keyRight))
+					{
+						if (keyRight + 1 < keyCount && is_right_key(keyRight + 1))
+						{
+							keyRight++;
+						}
+						else
+						{
+							keyRight = int(std::lower_bound(keyframe_times.begin(), keyframe_times.end(), animation.timer) - keyframe_times.begin());
+						}
+					}
+					sampler.keyframe_cursor = keyRight;
 
 					// Left keyframe is just near right:
 					keyLeft = std::max(0, keyRight - 1);
@@ -2440,7 +2574,21 @@ namespace wiScene
 			{
 				animation.timer = animation.start;
 			}
+		};
+
+		wiJobSystem::Dispatch(ctx, (uint32_t)parallel_animations.size(), 1, [&](wiJobArgs args) {
+			update_animation(parallel_animations[args.jobIndex]);
+		});
+		if (!serial_animations.empty())
+		{
+			wiJobSystem::Execute(ctx, [&](wiJobArgs args) {
+				for (uint32_t i : serial_animations)
+				{
+					update_animation(i);
+				}
+			});
 		}
+		wiJobSystem::Wait(ctx); // the jobs refer to local data
 	}
 	void Scene::RunTransformUpdateSystem(wiJobSystem::context& ctx)
 	{
@@ -2452,28 +2600,194 @@ namespace wiScene
 	}
 	void Scene::RunHierarchyUpdateSystem(wiJobSystem::context& ctx)
 	{
-		// This needs serialized execution because there are dependencies enforced by component order!
+		const uint32_t nodeCount = (uint32_t)hierarchy.GetCount();
 
-		for (size_t i = 0; i < hierarchy.GetCount(); ++i)
+		// Rebuild the depth sorted node list only when the hierarchy changed:
+		bool changed = hierarchy_signature.size() != nodeCount;
+		hierarchy_signature.resize(nodeCount);
+		for (uint32_t i = 0; i < nodeCount; ++i)
 		{
-			const HierarchyComponent& parentcomponent = hierarchy[i];
-			Entity entity = hierarchy.GetEntity(i);
+			const uint64_t signature = (uint64_t(hierarchy.GetEntity(i)) << 32ull) | uint64_t(hierarchy[i].parentID);
+			changed |= hierarchy_signature[i] != signature;
+			hierarchy_signature[i] = signature;
+		}
 
-			TransformComponent* transform_child = transforms.GetComponent(entity);
-			TransformComponent* transform_parent = transforms.GetComponent(parentcomponent.parentID);
-			if (transform_child != nullptr && transform_parent != nullptr)
+		if (changed)
+		{
+			// Compute depth of every node, parents that don't have a hierarchy are at depth 0:
+			static constexpr uint32_t UNVISITED = ~0u;
+			static constexpr uint32_t VISITING = ~0u - 1;
+			std::vector<uint32_t> depths(nodeCount, UNVISITED);
+			std::vector<uint32_t> parents(nodeCount); // hierarchy index of parent, or ~0 if it's a root parent
+			std::vector<uint32_t> path;
+			uint32_t levelCount = 0;
+			for (uint32_t i = 0; i < nodeCount; ++i)
 			{
-				transform_child->UpdateTransform_Parented(*transform_parent);
+				path.clear();
+				uint32_t current = i;
+				uint32_t depth = 0;
+				while (depths[current] == UNVISITED)
+				{
+					depths[current] = VISITING;
+					path.push_back(current);
+					const size_t parent = hierarchy.GetIndex(hierarchy[current].parentID);
+					parents[current] = parent == ~0ull ? ~0u : (uint32_t)parent;
+					if (parent == ~0ull)
+					{
+						break;
+					}
+					if (depths[parent] == VISITING)
+					{
+						// Cyclic hierarchy, the cycle is broken up and the parent treated as root:
+						parents[current] = ~0u;
+						break;
+					}
+					current = (uint32_t)parent;
+				}
+				if (!path.empty() && parents[path.back()] != ~0u)
+				{
+					depth = depths[parents[path.back()]] + 1;
+				}
+				for (auto it = path.rbegin(); it != path.rend(); ++it)
+				{
+					depths[*it] = depth++;
+				}
+				levelCount = std::max(levelCount, depth);
+			}
+
+			// Counting sort by depth, component order is kept within a level:
+			hierarchy_levels.clear();
+			hierarchy_levels.resize(levelCount + 1, 0);
+			for (uint32_t i = 0; i < nodeCount; ++i)
+			{
+				hierarchy_levels[depths[i] + 1]++;
+			}
+			for (uint32_t level = 0; level < levelCount; ++level)
+			{
+				hierarchy_levels[level + 1] += hierarchy_levels[level];
+			}
+			std::vector<uint32_t> slots(nodeCount);
+			std::vector<uint32_t> offsets(hierarchy_levels.begin(), hierarchy_levels.end() - 1);
+			for (uint32_t i = 0; i < nodeCount; ++i)
+			{
+				slots[i] = offsets[depths[i]]++;
+			}
+
+			// Root parents are appended after the nodes:
+			hierarchy_roots.clear();
+			std::unordered_map<Entity, uint32_t> root_slots;
+			hierarchy_nodes.resize(nodeCount);
+			for (uint32_t i = 0; i < nodeCount; ++i)
+			{
+				HierarchyNode& node = hierarchy_nodes[slots[i]];
+				node.entity = hierarchy.GetEntity(i);
+				if (parents[i] != ~0u)
+				{
+					node.parent_slot = slots[parents[i]];
+				}
+				else
+				{
+					const Entity parentID = hierarchy[i].parentID;
+					auto it = root_slots.find(parentID);
+					if (it == root_slots.end())
+					{
+						node.parent_slot = nodeCount + (uint32_t)hierarchy_roots.size();
+						root_slots[parentID] = node.parent_slot;
+						hierarchy_roots.push_back(parentID);
+					}
+					else
+					{
+						node.parent_slot = it->second;
+					}
+				}
 			}
 
+			const size_t slotCount = nodeCount + hierarchy_roots.size();
+			hierarchy_worlds.resize(slotCount);
+			hierarchy_layermasks.resize(slotCount);
+			hierarchy_slotflags.resize(slotCount);
+			hierarchy_slots = std::move(slots);
+			hierarchy_version++;
+		}
+
+		// Root parents only provide their current state to the first level:
+		wiJobSystem::Dispatch(ctx, (uint32_t)hierarchy_roots.size(), small_subtask_groupsize, [&](wiJobArgs args) {
+
+			const uint32_t slot = nodeCount + args.jobIndex;
+			const Entity entity = hierarchy_roots[args.jobIndex];
+			uint8_t flags = 0;
+
+			const TransformComponent* transform = transforms.GetComponent(entity);
+			if (transform != nullptr)
+			{
+				hierarchy_worlds[slot] = transform->world;
+				flags |= HIERARCHY_SLOT_TRANSFORM;
+			}
+
+			const LayerComponent* layer = layers.GetComponent(entity);
+			if (layer != nullptr)
+			{
+				hierarchy_layermasks[slot] = layer->GetLayerMask();
+				flags |= HIERARCHY_SLOT_LAYER;
+			}
+
+			hierarchy_slotflags[slot] = flags;
+		});
+		wiJobSystem::Wait(ctx);
+
+		auto update_node = [&](uint32_t slot) {
 
-			LayerComponent* layer_child = layers.GetComponent(entity);
-			LayerComponent* layer_parent = layers.GetComponent(parentcomponent.parentID);
-			if (layer_child != nullptr && layer_parent != nullptr)
+			const HierarchyNode& node = hierarchy_nodes[slot];
+			const uint8_t parent_flags = hierarchy_slotflags[node.parent_slot];
+			uint8_t flags = 0;
+
+			TransformComponent* transform = transforms.GetComponent(node.entity);
+			if (transform != nullptr)
+			{
+				if (parent_flags & HIERARCHY_SLOT_TRANSFORM)
+				{
+					XMMATRIX W = transform->GetLocalMatrix();
+					XMMATRIX W_parent = XMLoadFloat4x4(&hierarchy_worlds[node.parent_slot]);
+					XMStoreFloat4x4(&transform->world, W * W_parent);
+				}
+				hierarchy_worlds[slot] = transform->world;
+				flags |= HIERARCHY_SLOT_TRANSFORM;
+			}
+
+			LayerComponent* layer = layers.GetComponent(node.entity);
+			if (layer != nullptr)
 			{
-				layer_child->propagationMask = layer_parent->GetLayerMask();
+				if (parent_flags & HIERARCHY_SLOT_LAYER)
+				{
+					layer->propagationMask = hierarchy_layermasks[node.parent_slot];
+				}
+				hierarchy_layermasks[slot] = layer->GetLayerMask();
+				flags |= HIERARCHY_SLOT_LAYER;
 			}
 
+			hierarchy_slotflags[slot] = flags;
+		};
+
+		// Every level depends only on the previous levels:
+		for (size_t level = 0; level + 1 < hierarchy_levels.size(); ++level)
+		{
+			const uint32_t levelOffset = hierarchy_levels[level];
+			const uint32_t levelCount = hierarchy_levels[level + 1] - levelOffset;
+			if (levelCount <= small_subtask_groupsize)
+			{
+				// Small levels (for example long bone chains) are not worth the dispatch overhead:
+				for (uint32_t i = 0; i < levelCount; ++i)
+				{
+					update_node(levelOffset + i);
+				}
+			}
+			else
+			{
+				wiJobSystem::Dispatch(ctx, levelCount, small_subtask_groupsize, [&](wiJobArgs args) {
+					update_node(levelOffset + args.jobIndex);
+				});
+				wiJobSystem::Wait(ctx);
+			}
 		}
 	}
 	void Scene::RunSpringUpdateSystem(wiJobSystem::context& ctx)
@@ -2483,19 +2797,91 @@ namespace wiScene
 		const XMVECTOR windDir = XMLoadFloat3(&weather.windDirection);
 		const XMVECTOR gravity = XMVectorSet(0, -9.8f, 0, 0);
 
-		for (size_t i = 0; i < springs.GetCount(); ++i)
+		const uint32_t springCount = (uint32_t)springs.GetCount();
+		const uint32_t nodeCount = (uint32_t)hierarchy_nodes.size();
+
+		// Rebuild the islands only when the springs or the hierarchy changed:
+		bool changed = spring_hierarchy_version != hierarchy_version || spring_signature.size() != springCount;
+		spring_hierarchy_version = hierarchy_version;
+		spring_signature.resize(springCount);
+		for (uint32_t i = 0; i < springCount; ++i)
+		{
+			const Entity entity = springs.GetEntity(i);
+			changed |= spring_signature[i] != entity;
+			spring_signature[i] = entity;
+		}
+
+		if (changed)
 		{
-			SpringComponent& spring = springs[i];
+			// The island of a spring is identified by the first parent up the hierarchy that is not a spring (or a root parent)
+			//	The walk uses the depth sorted hierarchy nodes, so it will terminate even for cyclic hierarchies
+			std::unordered_map<Entity, uint32_t> island_lookup;
+			std::vector<uint32_t> islands(springCount);
+			uint32_t islandCount = 0;
+			for (uint32_t i = 0; i < springCount; ++i)
+			{
+				Entity key = springs.GetEntity(i);
+				const size_t index = hierarchy.GetIndex(key);
+				uint32_t slot = index == ~0ull ? ~0u : hierarchy_slots[index];
+				while (slot != ~0u)
+				{
+					const uint32_t parent_slot = hierarchy_nodes[slot].parent_slot;
+					if (parent_slot >= nodeCount)
+					{
+						key = hierarchy_roots[parent_slot - nodeCount];
+						break;
+					}
+					key = hierarchy_nodes[parent_slot].entity;
+					slot = springs.Contains(key) ? parent_slot : ~0u;
+				}
+
+				auto it = island_lookup.find(key);
+				if (it == island_lookup.end())
+				{
+					island_lookup[key] = islandCount;
+					islands[i] = islandCount++;
+				}
+				else
+				{
+					islands[i] = it->second;
+				}
+			}
+
+			// Counting sort by island, component order is kept within an island:
+			spring_islands.clear();
+			spring_islands.resize(islandCount + 1, 0);
+			for (uint32_t i = 0; i < springCount; ++i)
+			{
+				spring_islands[islands[i] + 1]++;
+			}
+			for (uint32_t island = 0; island < islandCount; ++island)
+			{
+				spring_islands[island + 1] += spring_islands[island];
+			}
+			std::vector<uint32_t> offsets(spring_islands.begin(), spring_islands.end() - 1);
+			spring_nodes.resize(springCount);
+			for (uint32_t i = 0; i < springCount; ++i)
+			{
+				SpringNode& node = spring_nodes[offsets[islands[i]]++];
+				node.spring_index = i;
+				const HierarchyComponent* hier = hierarchy.GetComponent(springs.GetEntity(i));
+				node.parent = hier == nullptr ? INVALID_ENTITY : hier->parentID;
+			}
+		}
+
+		auto update_spring = [&](const SpringNode& node) {
+
+			SpringComponent& spring = springs[node.spring_index];
 			if (spring.IsDisabled())
 			{
-				continue;
+				return;
 			}
-			Entity entity = springs.GetEntity(i);
+			Entity entity = springs.GetEntity(node.spring_index);
 			TransformComponent* transform = transforms.GetComponent(entity);
 			if (transform == nullptr)
 			{
 				assert(0);
-				continue;
+				return;
 			}
 
 			if (spring.IsResetting())
@@ -2505,8 +2891,7 @@ namespace wiScene
 				spring.velocity = XMFLOAT3(0, 0, 0);
 			}
 
-			const HierarchyComponent* hier = hierarchy.GetComponent(entity);
-			TransformComponent* parent_transform = hier == nullptr ? nullptr : transforms.GetComponent(hier->parentID);
+			TransformComponent* parent_transform = node.parent == INVALID_ENTITY ? nullptr : transforms.GetComponent(node.parent);
 			if (parent_transform != nullptr)
 			{
 				// Spring hierarchy resolve depends on spring component order!
@@ -2562,37 +2947,173 @@ namespace wiScene
 			velocity *= spring.damping;
 			XMStoreFloat3(&spring.velocity, velocity);
 			*((XMFLOAT3*)&transform->world._41) = spring.center_of_mass;
-		}
+		};
+
+		// Islands don't share any transforms, so they can be solved in parallel:
+		const uint32_t islandCount = spring_islands.empty() ? 0 : (uint32_t)spring_islands.size() - 1;
+		wiJobSystem::Dispatch(ctx, islandCount, small_subtask_groupsize, [&](wiJobArgs args) {
+			for (uint32_t i = spring_islands[args.jobIndex]; i < spring_islands[args.jobIndex + 1]; ++i)
+			{
+				update_spring(spring_nodes[i]);
+			}
+		});
+		wiJobSystem::Wait(ctx);
 	}
 	void Scene::RunInverseKinematicsUpdateSystem(wiJobSystem::context& ctx)
 	{
-		bool recompute_hierarchy = false;
-		for (size_t i = 0; i < inverse_kinematics.GetCount(); ++i)
+		static constexpr uint32_t max_chain_length = 32;
+		const uint32_t ikCount = (uint32_t)inverse_kinematics.GetCount();
+		const uint32_t nodeCount = (uint32_t)hierarchy_nodes.size();
+
+		// Rebuild the islands only when the IK components or the hierarchy changed:
+		bool changed = ik_hierarchy_version != hierarchy_version || ik_signature.size() != ikCount * 2;
+		ik_hierarchy_version = hierarchy_version;
+		ik_signature.resize(ikCount * 2);
+		for (uint32_t i = 0; i < ikCount; ++i)
 		{
 			const InverseKinematicsComponent& ik = inverse_kinematics[i];
+			const uint64_t signature = (uint64_t(inverse_kinematics.GetEntity(i)) << 32ull) | uint64_t(ik.target);
+			changed |= ik_signature[i * 2 + 0] != signature;
+			changed |= ik_signature[i * 2 + 1] != ik.chain_length;
+			ik_signature[i * 2 + 0] = signature;
+			ik_signature[i * 2 + 1] = ik.chain_length;
+		}
+
+		if (changed)
+		{
+			// Union-find over every transform that is read or written by the IK chains:
+			std::unordered_map<Entity, uint32_t> ids;
+			std::vector<uint32_t> sets;
+			auto find = [&](Entity entity) {
+				auto it = ids.find(entity);
+				if (it == ids.end())
+				{
+					const uint32_t id = (uint32_t)sets.size();
+					sets.push_back(id);
+					ids[entity] = id;
+					return id;
+				}
+				uint32_t id = it->second;
+				while (sets[id] != id)
+				{
+					sets[id] = sets[sets[id]];
+					id = sets[id];
+				}
+				return id;
+			};
+			auto join = [&](Entity a, Entity b) {
+				const uint32_t set_a = find(a);
+				const uint32_t set_b = find(b);
+				sets[set_b] = set_a;
+			};
+
+			std::unordered_map<Entity, uint32_t> root_slots;
+			for (uint32_t i = 0; i < (uint32_t)hierarchy_roots.size(); ++i)
+			{
+				root_slots[hierarchy_roots[i]] = nodeCount + i;
+			}
+			auto get_slot = [&](Entity entity) {
+				const size_t index = hierarchy.GetIndex(entity);
+				if (index != ~0ull)
+				{
+					return hierarchy_slots[index];
+				}
+				auto it = root_slots.find(entity);
+				return it == root_slots.end() ? ~0u : it->second;
+			};
+
+			// The chain is walked the same way as the solver does it:
+			ik_chain_offsets.resize(ikCount + 1);
+			ik_chain_slots.clear();
+			for (uint32_t i = 0; i < ikCount; ++i)
+			{
+				ik_chain_offsets[i] = (uint32_t)ik_chain_slots.size();
+				const InverseKinematicsComponent& ik = inverse_kinematics[i];
+				const Entity entity = inverse_kinematics.GetEntity(i);
+				join(entity, ik.target);
+				const HierarchyComponent* hier = hierarchy.GetComponent(entity);
+				if (hier == nullptr)
+				{
+					continue;
+				}
+				ik_chain_slots.push_back(get_slot(entity));
+				Entity parent_entity = hier->parentID;
+				for (uint32_t chain = 0; chain < std::min(ik.chain_length, max_chain_length); ++chain)
+				{
+					join(entity, parent_entity);
+					ik_chain_slots.push_back(get_slot(parent_entity));
+					const HierarchyComponent* hier_parent = hierarchy.GetComponent(parent_entity);
+					if (hier_parent == nullptr)
+					{
+						break;
+					}
+					join(entity, hier_parent->parentID); // the world matrix of the parent's parent is read
+					parent_entity = hier_parent->parentID;
+				}
+			}
+			ik_chain_offsets[ikCount] = (uint32_t)ik_chain_slots.size();
+
+			std::unordered_map<uint32_t, uint32_t> island_lookup;
+			std::vector<uint32_t> islands(ikCount);
+			uint32_t islandCount = 0;
+			for (uint32_t i = 0; i < ikCount; ++i)
+			{
+				const uint32_t set = find(inverse_kinematics.GetEntity(i));
+				auto it = island_lookup.find(set);
+				if (it == island_lookup.end())
+				{
+					island_lookup[set] = islandCount;
+					islands[i] = islandCount++;
+				}
+				else
+				{
+					islands[i] = it->second;
+				}
+			}
+
+			// Counting sort by island, component order is kept within an island:
+			ik_islands.clear();
+			ik_islands.resize(islandCount + 1, 0);
+			for (uint32_t i = 0; i < ikCount; ++i)
+			{
+				ik_islands[islands[i] + 1]++;
+			}
+			for (uint32_t island = 0; island < islandCount; ++island)
+			{
+				ik_islands[island + 1] += ik_islands[island];
+			}
+			std::vector<uint32_t> offsets(ik_islands.begin(), ik_islands.end() - 1);
+			ik_order.resize(ikCount);
+			for (uint32_t i = 0; i < ikCount; ++i)
+			{
+				ik_order[offsets[islands[i]]++] = i;
+			}
+		}
+
+		auto update_ik = [&](uint32_t index) {
+
+			const InverseKinematicsComponent& ik = inverse_kinematics[index];
 			if (ik.IsDisabled())
 			{
-				continue;
+				return;
 			}
-			Entity entity = inverse_kinematics.GetEntity(i);
+			Entity entity = inverse_kinematics.GetEntity(index);
 			TransformComponent* transform = transforms.GetComponent(entity);
 			TransformComponent* target = transforms.GetComponent(ik.target);
 			const HierarchyComponent* hier = hierarchy.GetComponent(entity);
 			if (transform == nullptr || target == nullptr || hier == nullptr)
 			{
-				continue;
+				return;
 			}
 
 			const XMVECTOR target_pos = target->GetPositionV();
 			for (uint32_t iteration = 0; iteration < ik.iteration_count; ++iteration)
 			{
-				TransformComponent* stack[32] = {};
+				TransformComponent* stack[max_chain_length] = {};
 				Entity parent_entity = hier->parentID;
 				TransformComponent* child_transform = transform;
-				for (uint32_t chain = 0; chain < std::min(ik.chain_length, (uint32_t)arraysize(stack)); ++chain)
+				for (uint32_t chain = 0; chain < std::min(ik.chain_length, max_chain_length); ++chain)
 				{
-					recompute_hierarchy = true; // any IK will trigger a full transform hierarchy recompute step at the end(**)
-
 					// stack stores all traversed chain links so far:
 					stack[chain] = child_transform;
 
@@ -2638,29 +3159,83 @@ namespace wiScene
 					// move up in the chain by one:
 					child_transform = parent_transform;
 					parent_entity = hier_parent->parentID;
-					assert(chain < (uint32_t)arraysize(stack) - 1); // if this is encountered, just extend stack array size
+					assert(chain < max_chain_length - 1); // if this is encountered, just extend max_chain_length
 
 				}
 			}
-		}
+		};
 
-		if (recompute_hierarchy)
+		// Islands don't share any transforms, so they can be solved in parallel:
+		const uint32_t islandCount = ik_islands.empty() ? 0 : (uint32_t)ik_islands.size() - 1;
+		wiJobSystem::Dispatch(ctx, islandCount, 1, [&](wiJobArgs args) {
+			for (uint32_t i = ik_islands[args.jobIndex]; i < ik_islands[args.jobIndex + 1]; ++i)
+			{
+				update_ik(ik_order[i]);
+			}
+		});
+		wiJobSystem::Wait(ctx);
+
+		// The IK chain is computed from child to parent upwards, so the transforms below the modified chain links
+		//	(such as children that animation writes to) must be updated. Only these subtrees are recomputed, level by level:
+		ik_dirty.assign(hierarchy_worlds.size(), 0);
+		bool dirty = false;
+		for (uint32_t i = 0; i < ikCount; ++i)
 		{
-			// (**)If there was IK, we need to recompute transform hierarchy. This is only necessary for transforms that have parent
-			//	transforms that are IK. Because the IK chain is computed from child to parent upwards, IK that have child would not update
-			//	its transform properly in some cases (such as if animation writes to that child)
-			for (size_t i = 0; i < hierarchy.GetCount(); ++i)
+			if (inverse_kinematics[i].IsDisabled())
 			{
-				const HierarchyComponent& parentcomponent = hierarchy[i];
-				Entity entity = hierarchy.GetEntity(i);
+				continue;
+			}
+			for (uint32_t j = ik_chain_offsets[i]; j < ik_chain_offsets[i + 1]; ++j)
+			{
+				const uint32_t slot = ik_chain_slots[j];
+				if (slot != ~0u)
+				{
+					ik_dirty[slot] = 1;
+					dirty = true;
+				}
+			}
+		}
+		if (!dirty)
+		{
+			return;
+		}
+
+		auto update_node = [&](uint32_t slot) {
+
+			const HierarchyNode& node = hierarchy_nodes[slot];
+			if (ik_dirty[node.parent_slot] == 0)
+			{
+				return;
+			}
+			ik_dirty[slot] = 1;
+
+			const Entity parent = node.parent_slot < nodeCount ? hierarchy_nodes[node.parent_slot].entity : hierarchy_roots[node.parent_slot - nodeCount];
+			TransformComponent* transform_child = transforms.GetComponent(node.entity);
+			const TransformComponent* transform_parent = transforms.GetComponent(parent);
+			if (transform_child != nullptr && transform_parent != nullptr)
+			{
+				transform_child->UpdateTransform_Parented(*transform_parent);
+			}
+		};
 
-				TransformComponent* transform_child = transforms.GetComponent(entity);
-				TransformComponent* transform_parent = transforms.GetComponent(parentcomponent.parentID);
-				if (transform_child != nullptr && transform_parent != nullptr)
+		for (size_t level = 0; level + 1 < hierarchy_levels.size(); ++level)
+		{
+			const uint32_t levelOffset = hierarchy_levels[level];
+			const uint32_t levelCount = hierarchy_levels[level + 1] - levelOffset;
+			if (levelCount <= small_subtask_groupsize)
+			{
+				for (uint32_t i = 0; i < levelCount; ++i)
 				{
-					transform_child->UpdateTransform_Parented(*transform_parent);
+					update_node(levelOffset + i);
 				}
 			}
+			else
+			{
+				wiJobSystem::Dispatch(ctx, levelCount, small_subtask_groupsize, [&](wiJobArgs args) {
+					update_node(levelOffset + args.jobIndex);
+				});
+				wiJobSystem::Wait(ctx);
+			}
 		}
 	}
 	void Scene::RunArmatureUpdateSystem(wiJobSystem::context& ctx)
@@ -2744,17 +3319,47 @@ namespace wiScene
 				std::swap(mesh.streamoutBuffer_POS, mesh.vertexBuffer_PRE);
 			}
 
-			uint32_t subsetIndex = 0;
-			for (auto& subset : mesh.subsets)
+			// The triangle BVH of the CPU queries is only built once, deformed meshes are tested by brute force instead:
+			if (!mesh.IsSkinned() && mesh.targets.empty() && !softbodies.Contains(entity) && !mesh.vertex_positions.empty())
 			{
-				const MaterialComponent* material = materials.GetComponent(subset.materialID);
-				if (material != nullptr)
+				uint32_t triangleCount = 0;
+				for (auto& subset : mesh.subsets)
 				{
-					subset.materialIndex = (uint32_t)materials.GetIndex(subset.materialID);
-					if (mesh.BLAS.IsValid())
+					triangleCount += subset.indexCount / 3;
+				}
+				if (!mesh.bvh.IsValid(triangleCount))
+				{
+					std::vector<AABB> triangles;
+					triangles.reserve(triangleCount);
+					for (auto& subset : mesh.subsets)
 					{
-						auto& geometry = mesh.BLAS.desc.bottomlevel.geometries[subsetIndex];
-						uint32_t flags = geometry._flags;
+						for (uint32_t i = 0; i < subset.indexCount / 3 * 3; i += 3)
+						{
+							const XMVECTOR p0 = XMLoadFloat3(&mesh.vertex_positions[mesh.indices[subset.indexOffset + i + 0]]);
+							const XMVECTOR p1 = XMLoadFloat3(&mesh.vertex_positions[mesh.indices[subset.indexOffset + i + 1]]);
+							const XMVECTOR p2 = XMLoadFloat3(&mesh.vertex_positions[mesh.indices[subset.indexOffset + i + 2]]);
+							AABB aabb;
+							XMStoreFloat3(&aabb._min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+							XMStoreFloat3(&aabb._max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+							triangles.push_back(aabb);
+						}
+					}
+					wiJobSystem::context bvh_ctx;
+					mesh.bvh.Build(bvh_ctx, triangles.data(), triangleCount);
+				}
+			}
+
+			uint32_t subsetIndex = 0;
+			for (auto& subset : mesh.subsets)
+			{
+				const MaterialComponent* material = materials.GetComponent(subset.materialID);
+				if (material != nullptr)
+				{
+					subset.materialIndex = (uint32_t)materials.GetIndex(subset.materialID);
+					if (mesh.BLAS.IsValid())
+					{
+						auto& geometry = mesh.BLAS.desc.bottomlevel.geometries[subsetIndex];
+						uint32_t flags = geometry._flags;
 						if (material->IsAlphaTestEnabled() || (material->GetRenderTypes() & RENDERTYPE_TRANSPARENT) || !material->IsCastingShadow())
 						{
 							geometry._flags &= ~RaytracingAccelerationStructureDesc::BottomLevel::Geometry::FLAG_OPAQUE;
@@ -2903,6 +3508,14 @@ namespace wiScene
 				material.engineStencilRef = STENCILREF_CUSTOMSHADER;
 			}
 
+			for (auto& x : material.textures)
+			{
+				if (x.resource != nullptr && x.resource->streaming_texture != nullptr && x.resource->streaming_texture->texture_changed)
+				{
+					material.SetDirty(); // the streamed texture was recreated, the descriptor index must be updated
+				}
+			}
+
 			if (material.IsDirty())
 			{
 				material.SetDirty(false);
@@ -2987,11 +3600,16 @@ namespace wiScene
 
 		parallel_bounds.clear();
 		parallel_bounds.resize((size_t)wiJobSystem::DispatchGroupCount((uint32_t)objects.GetCount(), small_subtask_groupsize));
+
+		moved_object_bounds.resize(moved_object_bounds_capacity);
+		moved_object_count.store(0);
+		object_bounds_version++;
 		
 		wiJobSystem::Dispatch(ctx, (uint32_t)objects.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
 
 			ObjectComponent& object = objects[args.jobIndex];
 			AABB& aabb = aabb_objects[args.jobIndex];
+			const AABB aabb_prev = aabb;
 
 			// Update occlusion culling status:
 			if (!wiRenderer::GetFreezeCullingCameraEnabled())
@@ -3223,6 +3841,19 @@ namespace wiScene
 				}
 			}
 
+			if (aabb.layerMask != aabb_prev.layerMask ||
+				aabb._min.x != aabb_prev._min.x || aabb._min.y != aabb_prev._min.y || aabb._min.z != aabb_prev._min.z ||
+				aabb._max.x != aabb_prev._max.x || aabb._max.y != aabb_prev._max.y || aabb._max.z != aabb_prev._max.z)
+			{
+				const uint32_t moved_index = moved_object_count.fetch_add(1);
+				if (moved_index < moved_object_bounds_capacity)
+				{
+					AABB& moved = moved_object_bounds[moved_index];
+					moved = AABB::Merge(aabb, aabb_prev);
+					moved.layerMask = aabb.layerMask | aabb_prev.layerMask;
+				}
+			}
+
 		}, sizeof(AABB));
 	}
 	void Scene::RunCameraUpdateSystem(wiJobSystem::context& ctx)
@@ -3285,9 +3916,10 @@ namespace wiScene
 			// atlas part is not thread safe:
 			if (decal.texture != nullptr && decal.texture->texture.IsValid())
 			{
-				if (packedDecals.find(decal.texture) == packedDecals.end())
+				const bool streamed = decal.texture->streaming_texture != nullptr && decal.texture->streaming_texture->texture_changed;
+				if (streamed || packedDecals.find(decal.texture) == packedDecals.end())
 				{
-					// we need to pack this decal texture into the atlas
+					// we need to pack this decal texture into the atlas (again, if its resolution was changed by texture streaming)
 					wiRectPacker::rect_xywh newRect = wiRectPacker::rect_xywh(0, 0, decal.texture->texture.desc.Width + atlasClampBorder * 2, decal.texture->texture.desc.Height + atlasClampBorder * 2);
 					packedDecals[decal.texture] = newRect;
 					decal_repack_needed = true;
@@ -3673,21 +4305,21 @@ namespace wiScene
 
 
 
-	Entity LoadModel(const std::string& fileName, const XMMATRIX& transformMatrix, bool attached)
+	Entity LoadModel(const std::string& fileName, const XMMATRIX& transformMatrix, bool attached, uint64_t sectionMask)
 	{
 		Scene scene;
-		Entity root = LoadModel(scene, fileName, transformMatrix, attached);
+		Entity root = LoadModel(scene, fileName, transformMatrix, attached, sectionMask);
 		GetScene().Merge(scene);
 		return root;
 	}
 
-	Entity LoadModel(Scene& scene, const std::string& fileName, const XMMATRIX& transformMatrix, bool attached)
+	Entity LoadModel(Scene& scene, const std::string& fileName, const XMMATRIX& transformMatrix, bool attached, uint64_t sectionMask)
 	{
 		wiArchive archive(fileName, true);
 		if (archive.IsOpen())
 		{
 			// Serialize it from file:
-			scene.Serialize(archive);
+			scene.Serialize(archive, false, sectionMask);
 
 			// First, create new root:
 			Entity root = CreateEntity();
@@ -3726,103 +4358,139 @@ namespace wiScene
 		return INVALID_ENTITY;
 	}
 
+	// Triangles of MeshComponent::bvh are numbered in the order of subsets, this returns the subset index and the first index of the triangle
+	static int GetBVHTriangle(const MeshComponent& mesh, uint32_t triangle, uint32_t& indexOffset)
+	{
+		int subsetIndex = 0;
+		for (auto& subset : mesh.subsets)
+		{
+			const uint32_t triangleCount = subset.indexCount / 3;
+			if (triangle < triangleCount)
+			{
+				indexOffset = subset.indexOffset + triangle * 3;
+				return subsetIndex;
+			}
+			triangle -= triangleCount;
+			subsetIndex++;
+		}
+		assert(0);
+		indexOffset = 0;
+		return -1;
+	}
+	// The mesh BVH is in the undeformed local space, it can't be used while the mesh is deformed
+	static bool IsBVHUsable(const MeshComponent& mesh, bool deformed)
+	{
+		if (deformed || mesh.bvh.nodes.empty())
+		{
+			return false;
+		}
+		uint32_t triangleCount = 0;
+		for (auto& subset : mesh.subsets)
+		{
+			triangleCount += subset.indexCount / 3;
+		}
+		return mesh.bvh.IsValid(triangleCount);
+	}
+
+	// Skins every vertex of the mesh once, so that the shared vertices of triangles are not skinned multiple times
+	static void SkinVertices(const MeshComponent& mesh, const ArmatureComponent& armature, std::vector<XMFLOAT3>& positions)
+	{
+		positions.resize(mesh.vertex_positions.size());
+		for (size_t i = 0; i < positions.size(); ++i)
+		{
+			XMStoreFloat3(&positions[i], SkinVertex(mesh, armature, (uint32_t)i));
+		}
+	}
+
 	PickResult Pick(const RAY& ray, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
 	{
 		PickResult result;
+		Pick(&ray, 1, &result, renderTypeMask, layerMask, scene);
+		return result;
+	}
+	void Pick(const RAY* rays, uint32_t count, PickResult* results, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			results[i] = PickResult();
+		}
 
 		if (scene.objects.GetCount() > 0)
 		{
-			const XMVECTOR rayOrigin = XMLoadFloat3(&ray.origin);
-			const XMVECTOR rayDirection = XMVector3Normalize(XMLoadFloat3(&ray.direction));
+			const uint32_t objectCount = (uint32_t)scene.aabb_objects.GetCount();
+			const bool bvh_valid = scene.bvh_objects.IsValid(objectCount);
+			std::unordered_map<uint32_t, std::vector<XMFLOAT3>> skinned_positions; // per object index, reused by all packets
 
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
+			// The rays are traced in packets, the object and triangle BVHs are traversed once for the whole packet:
+			for (uint32_t first = 0; first < count; first += RAY_Packet::WIDTH)
 			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (!ray.intersects(aabb))
+				const uint32_t packetSize = std::min(RAY_Packet::WIDTH, count - first);
+				PickResult* packetResults = results + first;
+				XMVECTOR rayOrigins[RAY_Packet::WIDTH];
+				XMVECTOR rayDirections[RAY_Packet::WIDTH];
+				RAY_Packet packet;
+				for (uint32_t lane = 0; lane < packetSize; ++lane)
 				{
-					continue;
+					rayOrigins[lane] = XMLoadFloat3(&rays[first + lane].origin);
+					rayDirections[lane] = XMVector3Normalize(XMLoadFloat3(&rays[first + lane].direction));
+					packet.set(lane, rayOrigins[lane], rayDirections[lane], FLT_MAX);
 				}
 
-				const ObjectComponent& object = scene.objects[i];
-				if (object.meshID == INVALID_ENTITY)
-				{
-					continue;
-				}
-				if (!(renderTypeMask & object.GetRenderTypes()))
-				{
-					continue;
-				}
+				auto pick_object = [&](uint32_t objectIndex, uint32_t rayMask) {
 
-				Entity entity = scene.aabb_objects.GetEntity(i);
-				const LayerComponent* layer = scene.layers.GetComponent(entity);
-				if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
-				{
-					continue;
-				}
+					const ObjectComponent& object = scene.objects[objectIndex];
+					if (object.meshID == INVALID_ENTITY)
+					{
+						return;
+					}
+					if (!(renderTypeMask & object.GetRenderTypes()))
+					{
+						return;
+					}
 
-				const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
-				const SoftBodyPhysicsComponent* softbody = scene.softbodies.GetComponent(object.meshID);
-				const bool softbody_active = softbody != nullptr && !softbody->vertex_positions_simulation.empty();
+					Entity entity = scene.aabb_objects.GetEntity(objectIndex);
+					const LayerComponent* layer = scene.layers.GetComponent(entity);
+					if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
+					{
+						return;
+					}
 
-				const XMMATRIX objectMat = object.transform_index >= 0 ? XMLoadFloat4x4(&scene.transforms[object.transform_index].world) : XMMatrixIdentity();
-				const XMMATRIX objectMat_Inverse = XMMatrixInverse(nullptr, objectMat);
+					const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
+					const SoftBodyPhysicsComponent* softbody = scene.softbodies.GetComponent(object.meshID);
+					const bool softbody_active = softbody != nullptr && !softbody->vertex_positions_simulation.empty();
 
-				const XMVECTOR rayOrigin_local = XMVector3Transform(rayOrigin, objectMat_Inverse);
-				const XMVECTOR rayDirection_local = XMVector3Normalize(XMVector3TransformNormal(rayDirection, objectMat_Inverse));
+					const XMMATRIX objectMat = object.transform_index >= 0 ? XMLoadFloat4x4(&scene.transforms[object.transform_index].world) : XMMatrixIdentity();
+					const XMMATRIX objectMat_Inverse = XMMatrixInverse(nullptr, objectMat);
 
-				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
+					const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 
-				int subsetCounter = 0;
-				for (auto& subset : mesh.subsets)
-				{
-					for (size_t i = 0; i < subset.indexCount; i += 3)
+					// Rays in object local space, the local distances are scaled compared to world space:
+					XMVECTOR rayOrigins_local[RAY_Packet::WIDTH];
+					XMVECTOR rayDirections_local[RAY_Packet::WIDTH];
+					float scales[RAY_Packet::WIDTH];
+					RAY_Packet packet_local;
+					for (uint32_t lane = 0; lane < packetSize; ++lane)
 					{
-						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
-						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
-						const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
-
-						XMVECTOR p0;
-						XMVECTOR p1;
-						XMVECTOR p2;
-
-						if (softbody_active)
+						if (rayMask & (1u << lane))
 						{
-							p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
-							p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
-							p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
-						}
-						else
-						{
-							if (armature == nullptr)
-							{
-								if (mesh.vertex_positions_morphed.empty())
-							    {
-									p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
-									p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
-									p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
-								}
-								else
-								{
-								    p0 = mesh.vertex_positions_morphed[i0].LoadPOS();
-								    p1 = mesh.vertex_positions_morphed[i1].LoadPOS();
-								    p2 = mesh.vertex_positions_morphed[i2].LoadPOS();
-								}
-							}
-							else
-							{
-								p0 = SkinVertex(mesh, *armature, i0);
-								p1 = SkinVertex(mesh, *armature, i1);
-								p2 = SkinVertex(mesh, *armature, i2);
-							}
+							rayOrigins_local[lane] = XMVector3Transform(rayOrigins[lane], objectMat_Inverse);
+							const XMVECTOR direction = XMVector3TransformNormal(rayDirections[lane], objectMat_Inverse);
+							scales[lane] = XMVectorGetX(XMVector3Length(direction));
+							rayDirections_local[lane] = direction / scales[lane];
+							packet_local.set(lane, rayOrigins_local[lane], rayDirections_local[lane], std::min(FLT_MAX, packetResults[lane].distance * scales[lane]));
 						}
+					}
+
+					auto pick_triangle = [&](uint32_t lane, int subsetIndex, uint32_t i0, uint32_t i1, uint32_t i2, XMVECTOR p0, XMVECTOR p1, XMVECTOR p2) {
 
 						float distance;
 						XMFLOAT2 bary;
-						if (wiMath::RayTriangleIntersects(rayOrigin_local, rayDirection_local, p0, p1, p2, distance, bary))
+						if (wiMath::RayTriangleIntersects(rayOrigins_local[lane], rayDirections_local[lane], p0, p1, p2, distance, bary))
 						{
-							const XMVECTOR pos = XMVector3Transform(XMVectorAdd(rayOrigin_local, rayDirection_local*distance), objectMat);
-							distance = wiMath::Distance(pos, rayOrigin);
+							const XMVECTOR pos = XMVector3Transform(XMVectorAdd(rayOrigins_local[lane], rayDirections_local[lane] * distance), objectMat);
+							distance = wiMath::Distance(pos, rayOrigins[lane]);
 
+							PickResult& result = packetResults[lane];
 							if (distance < result.distance)
 							{
 								const XMVECTOR nor = XMVector3Normalize(XMVector3TransformNormal(XMVector3Cross(XMVectorSubtract(p2, p1), XMVectorSubtract(p1, p0)), objectMat));
@@ -3831,230 +4499,400 @@ namespace wiScene
 								XMStoreFloat3(&result.position, pos);
 								XMStoreFloat3(&result.normal, nor);
 								result.distance = distance;
-								result.subsetIndex = subsetCounter;
+								result.subsetIndex = subsetIndex;
 								result.vertexID0 = (int)i0;
 								result.vertexID1 = (int)i1;
 								result.vertexID2 = (int)i2;
 								result.bary = bary;
+
+								// The rest of the traversal can skip everything that is farther than this hit:
+								packet.set_tmax(lane, distance);
+								packet_local.set_tmax(lane, distance * scales[lane]);
+							}
+						}
+					};
+
+					if (IsBVHUsable(mesh, softbody_active || armature != nullptr || !mesh.vertex_positions_morphed.empty()))
+					{
+						mesh.bvh.Intersects(packet_local, ~0u, [&](uint32_t triangle, uint32_t triangleMask) {
+							uint32_t indexOffset;
+							const int subsetIndex = GetBVHTriangle(mesh, triangle, indexOffset);
+							const uint32_t i0 = mesh.indices[indexOffset + 0];
+							const uint32_t i1 = mesh.indices[indexOffset + 1];
+							const uint32_t i2 = mesh.indices[indexOffset + 2];
+							const XMVECTOR p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
+							const XMVECTOR p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
+							const XMVECTOR p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
+							for (uint32_t lane = 0; lane < packetSize; ++lane)
+							{
+								if (triangleMask & (1u << lane))
+								{
+									pick_triangle(lane, subsetIndex, i0, i1, i2, p0, p1, p2);
+								}
 							}
+						});
+						return;
+					}
+
+					// Deformed meshes are tested by brute force against the whole packet, skinning is only computed once for all packets:
+					const std::vector<XMFLOAT3>* skinned = nullptr;
+					if (!softbody_active && armature != nullptr)
+					{
+						std::vector<XMFLOAT3>& positions = skinned_positions[objectIndex];
+						if (positions.empty())
+						{
+							SkinVertices(mesh, *armature, positions);
 						}
+						skinned = &positions;
 					}
-					subsetCounter++;
-				}
 
+					int subsetCounter = 0;
+					for (auto& subset : mesh.subsets)
+					{
+						for (size_t i = 0; i < subset.indexCount; i += 3)
+						{
+							const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
+							const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
+							const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
+
+							XMVECTOR p0;
+							XMVECTOR p1;
+							XMVECTOR p2;
+
+							if (softbody_active)
+							{
+								p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
+								p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
+								p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+							}
+							else
+							{
+								if (armature == nullptr)
+								{
+									if (mesh.vertex_positions_morphed.empty())
+									{
+										p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
+										p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
+										p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
+									}
+									else
+									{
+										p0 = mesh.vertex_positions_morphed[i0].LoadPOS();
+										p1 = mesh.vertex_positions_morphed[i1].LoadPOS();
+										p2 = mesh.vertex_positions_morphed[i2].LoadPOS();
+									}
+								}
+								else
+								{
+									p0 = XMLoadFloat3(&(*skinned)[i0]);
+									p1 = XMLoadFloat3(&(*skinned)[i1]);
+									p2 = XMLoadFloat3(&(*skinned)[i2]);
+								}
+							}
+
+							for (uint32_t lane = 0; lane < packetSize; ++lane)
+							{
+								if (rayMask & (1u << lane))
+								{
+									pick_triangle(lane, subsetCounter, i0, i1, i2, p0, p1, p2);
+								}
+							}
+						}
+						subsetCounter++;
+					}
+				};
+
+				if (bvh_valid)
+				{
+					scene.bvh_objects.Intersects(packet, layerMask, pick_object);
+				}
+				else
+				{
+					for (uint32_t i = 0; i < objectCount; ++i)
+					{
+						const uint32_t rayMask = packet.intersects(scene.aabb_objects[i]);
+						if (rayMask != 0)
+						{
+							pick_object(i, rayMask);
+						}
+					}
+				}
 			}
 		}
 
-		// Construct a matrix that will orient to position (P) according to surface normal (N):
-		XMVECTOR N = XMLoadFloat3(&result.normal);
-		XMVECTOR P = XMLoadFloat3(&result.position);
-		XMVECTOR E = XMLoadFloat3(&ray.origin);
-		XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, P - E));
-		XMVECTOR B = XMVector3Normalize(XMVector3Cross(T, N));
-		XMMATRIX M = { T, N, B, P };
-		XMStoreFloat4x4(&result.orientation, M);
-
-		return result;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			PickResult& result = results[i];
+
+			// Construct a matrix that will orient to position (P) according to surface normal (N):
+			XMVECTOR N = XMLoadFloat3(&result.normal);
+			XMVECTOR P = XMLoadFloat3(&result.position);
+			XMVECTOR E = XMLoadFloat3(&rays[i].origin);
+			XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, P - E));
+			XMVECTOR B = XMVector3Normalize(XMVector3Cross(T, N));
+			XMMATRIX M = { T, N, B, P };
+			XMStoreFloat4x4(&result.orientation, M);
+		}
 	}
 
-	SceneIntersectSphereResult SceneIntersectSphere(const SPHERE& sphere, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
+	// Calls func(Entity entity, const MeshComponent& mesh, XMVECTOR p0, XMVECTOR p1, XMVECTOR p2) with the world space triangles of the objects that can intersect the world space box
+	//	Objects and triangles are visited in component and subset order, the iteration stops when func returns true
+	template<typename F>
+	static void ForEachTriangleInBox(const AABB& box, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene, F func)
 	{
-		SceneIntersectSphereResult result;
-		XMVECTOR Center = XMLoadFloat3(&sphere.center);
-		XMVECTOR Radius = XMVectorReplicate(sphere.radius);
-		XMVECTOR RadiusSq = XMVectorMultiply(Radius, Radius);
-
-		if (scene.objects.GetCount() > 0)
+		if (scene.objects.GetCount() == 0)
 		{
+			return;
+		}
 
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
+		std::vector<uint32_t> candidates;
+		const uint32_t objectCount = (uint32_t)scene.aabb_objects.GetCount();
+		if (scene.bvh_objects.IsValid(objectCount))
+		{
+			scene.bvh_objects.Intersects(box, layerMask, [&](uint32_t objectIndex) {
+				candidates.push_back(objectIndex);
+			});
+			std::sort(candidates.begin(), candidates.end());
+		}
+		else
+		{
+			for (uint32_t i = 0; i < objectCount; ++i)
 			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (!sphere.intersects(aabb))
+				if (box.intersects(scene.aabb_objects[i]) != AABB::OUTSIDE)
 				{
-					continue;
+					candidates.push_back(i);
 				}
+			}
+		}
 
-				const ObjectComponent& object = scene.objects[i];
-				if (object.meshID == INVALID_ENTITY)
-				{
-					continue;
-				}
-				if (!(renderTypeMask & object.GetRenderTypes()))
-				{
-					continue;
-				}
+		std::vector<uint32_t> triangles;
+		std::vector<XMFLOAT3> skinned;
+		for (uint32_t objectIndex : candidates)
+		{
+			const ObjectComponent& object = scene.objects[objectIndex];
+			if (object.meshID == INVALID_ENTITY)
+			{
+				continue;
+			}
+			if (!(renderTypeMask & object.GetRenderTypes()))
+			{
+				continue;
+			}
 
-				Entity entity = scene.aabb_objects.GetEntity(i);
-				const LayerComponent* layer = scene.layers.GetComponent(entity);
-				if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
-				{
-					continue;
-				}
+			Entity entity = scene.aabb_objects.GetEntity(objectIndex);
+			const LayerComponent* layer = scene.layers.GetComponent(entity);
+			if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
+			{
+				continue;
+			}
 
-				const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
-				const SoftBodyPhysicsComponent* softbody = scene.softbodies.GetComponent(object.meshID);
-				const bool softbody_active = softbody != nullptr && !softbody->vertex_positions_simulation.empty();
+			const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
+			const SoftBodyPhysicsComponent* softbody = scene.softbodies.GetComponent(object.meshID);
+			const bool softbody_active = softbody != nullptr && !softbody->vertex_positions_simulation.empty();
 
-				const XMMATRIX objectMat = object.transform_index >= 0 ? XMLoadFloat4x4(&scene.transforms[object.transform_index].world) : XMMatrixIdentity();
+			const XMMATRIX objectMat = object.transform_index >= 0 ? XMLoadFloat4x4(&scene.transforms[object.transform_index].world) : XMMatrixIdentity();
 
-				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
+			const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 
-				int subsetCounter = 0;
-				for (auto& subset : mesh.subsets)
+			if (IsBVHUsable(mesh, softbody_active || armature != nullptr))
+			{
+				// The query box is transformed to local space, the triangles are visited in ascending order:
+				triangles.clear();
+				mesh.bvh.Intersects(box.transform(XMMatrixInverse(nullptr, objectMat)), ~0u, [&](uint32_t triangle) {
+					triangles.push_back(triangle);
+				});
+				std::sort(triangles.begin(), triangles.end());
+				for (uint32_t triangle : triangles)
 				{
-					for (size_t i = 0; i < subset.indexCount; i += 3)
+					uint32_t indexOffset;
+					GetBVHTriangle(mesh, triangle, indexOffset);
+					const XMVECTOR p0 = XMVector3Transform(XMLoadFloat3(&mesh.vertex_positions[mesh.indices[indexOffset + 0]]), objectMat);
+					const XMVECTOR p1 = XMVector3Transform(XMLoadFloat3(&mesh.vertex_positions[mesh.indices[indexOffset + 1]]), objectMat);
+					const XMVECTOR p2 = XMVector3Transform(XMLoadFloat3(&mesh.vertex_positions[mesh.indices[indexOffset + 2]]), objectMat);
+					if (func(entity, mesh, p0, p1, p2))
 					{
-						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
-						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
-						const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
+						return;
+					}
+				}
+				continue;
+			}
+
+			if (!softbody_active && armature != nullptr)
+			{
+				SkinVertices(mesh, *armature, skinned);
+			}
+
+			for (auto& subset : mesh.subsets)
+			{
+				for (size_t i = 0; i < subset.indexCount; i += 3)
+				{
+					const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
+					const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
+					const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
 
-						XMVECTOR p0;
-						XMVECTOR p1;
-						XMVECTOR p2;
+					XMVECTOR p0;
+					XMVECTOR p1;
+					XMVECTOR p2;
 
-						if (softbody_active)
+					if (softbody_active)
+					{
+						p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
+						p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
+						p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+					}
+					else
+					{
+						if (armature == nullptr)
 						{
-							p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
-							p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
-							p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+							p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
+							p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
+							p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
 						}
 						else
 						{
-							if (armature == nullptr)
-							{
-								p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
-								p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
-								p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
-							}
-							else
-							{
-								p0 = SkinVertex(mesh, *armature, i0);
-								p1 = SkinVertex(mesh, *armature, i1);
-								p2 = SkinVertex(mesh, *armature, i2);
-							}
+							p0 = XMLoadFloat3(&skinned[i0]);
+							p1 = XMLoadFloat3(&skinned[i1]);
+							p2 = XMLoadFloat3(&skinned[i2]);
 						}
+					}
 
-						p0 = XMVector3Transform(p0, objectMat);
-						p1 = XMVector3Transform(p1, objectMat);
-						p2 = XMVector3Transform(p2, objectMat);
+					p0 = XMVector3Transform(p0, objectMat);
+					p1 = XMVector3Transform(p1, objectMat);
+					p2 = XMVector3Transform(p2, objectMat);
 
-						XMFLOAT3 min, max;
-						XMStoreFloat3(&min, XMVectorMin(p0, XMVectorMin(p1, p2)));
-						XMStoreFloat3(&max, XMVectorMax(p0, XMVectorMax(p1, p2)));
-						AABB aabb_triangle(min, max);
-						if (sphere.intersects(aabb_triangle) == AABB::OUTSIDE)
-						{
-							continue;
-						}
+					if (func(entity, mesh, p0, p1, p2))
+					{
+						return;
+					}
+				}
+			}
+		}
+	}
 
-						// Compute the plane of the triangle (has to be normalized).
-						XMVECTOR N = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+	SceneIntersectSphereResult SceneIntersectSphere(const SPHERE& sphere, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
+	{
+		SceneIntersectSphereResult result;
+		XMVECTOR Center = XMLoadFloat3(&sphere.center);
+		XMVECTOR Radius = XMVectorReplicate(sphere.radius);
+		XMVECTOR RadiusSq = XMVectorMultiply(Radius, Radius);
+		AABB sphere_aabb;
+		sphere_aabb.createFromHalfWidth(sphere.center, XMFLOAT3(sphere.radius, sphere.radius, sphere.radius));
 
-						// Assert that the triangle is not degenerate.
-						assert(!XMVector3Equal(N, XMVectorZero()));
+		ForEachTriangleInBox(sphere_aabb, renderTypeMask, layerMask, scene, [&](Entity entity, const MeshComponent& mesh, XMVECTOR p0, XMVECTOR p1, XMVECTOR p2) {
 
-						// Find the nearest feature on the triangle to the sphere.
-						XMVECTOR Dist = XMVector3Dot(XMVectorSubtract(Center, p0), N);
+			XMFLOAT3 min, max;
+			XMStoreFloat3(&min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+			XMStoreFloat3(&max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+			AABB aabb_triangle(min, max);
+			if (sphere.intersects(aabb_triangle) == AABB::OUTSIDE)
+			{
+				return false;
+			}
 
-						if (!mesh.IsDoubleSided() && XMVectorGetX(Dist) > 0)
-						{
-							continue; // pass through back faces
-						}
+			// Compute the plane of the triangle (has to be normalized).
+			XMVECTOR N = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
 
-						// If the center of the sphere is farther from the plane of the triangle than
-						// the radius of the sphere, then there cannot be an intersection.
-						XMVECTOR NoIntersection = XMVectorLess(Dist, XMVectorNegate(Radius));
-						NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(Dist, Radius));
+			// Assert that the triangle is not degenerate.
+			assert(!XMVector3Equal(N, XMVectorZero()));
 
-						// Project the center of the sphere onto the plane of the triangle.
-						XMVECTOR Point0 = XMVectorNegativeMultiplySubtract(N, Dist, Center);
+			// Find the nearest feature on the triangle to the sphere.
+			XMVECTOR Dist = XMVector3Dot(XMVectorSubtract(Center, p0), N);
 
-						// Is it inside all the edges? If so we intersect because the distance 
-						// to the plane is less than the radius.
-						//XMVECTOR Intersection = DirectX::Internal::PointOnPlaneInsideTriangle(Point0, p0, p1, p2);
+			if (!mesh.IsDoubleSided() && XMVectorGetX(Dist) > 0)
+			{
+				return false; // pass through back faces
+			}
 
-						// Compute the cross products of the vector from the base of each edge to 
-						// the point with each edge vector.
-						XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(Point0, p0), XMVectorSubtract(p1, p0));
-						XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(Point0, p1), XMVectorSubtract(p2, p1));
-						XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(Point0, p2), XMVectorSubtract(p0, p2));
+			// If the center of the sphere is farther from the plane of the triangle than
+			// the radius of the sphere, then there cannot be an intersection.
+			XMVECTOR NoIntersection = XMVectorLess(Dist, XMVectorNegate(Radius));
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(Dist, Radius));
 
-						// If the cross product points in the same direction as the normal the the
-						// point is inside the edge (it is zero if is on the edge).
-						XMVECTOR Zero = XMVectorZero();
-						XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
-						XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
-						XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
+			// Project the center of the sphere onto the plane of the triangle.
+			XMVECTOR Point0 = XMVectorNegativeMultiplySubtract(N, Dist, Center);
 
-						// If the point inside all of the edges it is inside.
-						XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
+			// Is it inside all the edges? If so we intersect because the distance 
+			// to the plane is less than the radius.
+			//XMVECTOR Intersection = DirectX::Internal::PointOnPlaneInsideTriangle(Point0, p0, p1, p2);
 
-						bool inside = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+			// Compute the cross products of the vector from the base of each edge to 
+			// the point with each edge vector.
+			XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(Point0, p0), XMVectorSubtract(p1, p0));
+			XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(Point0, p1), XMVectorSubtract(p2, p1));
+			XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(Point0, p2), XMVectorSubtract(p0, p2));
 
-						// Find the nearest point on each edge.
+			// If the cross product points in the same direction as the normal the the
+			// point is inside the edge (it is zero if is on the edge).
+			XMVECTOR Zero = XMVectorZero();
+			XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
+			XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
+			XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
 
-						// Edge 0,1
-						XMVECTOR Point1 = DirectX::Internal::PointOnLineSegmentNearestPoint(p0, p1, Center);
+			// If the point inside all of the edges it is inside.
+			XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point1)), RadiusSq));
+			bool inside = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
 
-						// Edge 1,2
-						XMVECTOR Point2 = DirectX::Internal::PointOnLineSegmentNearestPoint(p1, p2, Center);
+			// Find the nearest point on each edge.
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point2)), RadiusSq));
+			// Edge 0,1
+			XMVECTOR Point1 = DirectX::Internal::PointOnLineSegmentNearestPoint(p0, p1, Center);
 
-						// Edge 2,0
-						XMVECTOR Point3 = DirectX::Internal::PointOnLineSegmentNearestPoint(p2, p0, Center);
+			// If the distance to the center of the sphere to the point is less than 
+			// the radius of the sphere then it must intersect.
+			Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point1)), RadiusSq));
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point3)), RadiusSq));
+			// Edge 1,2
+			XMVECTOR Point2 = DirectX::Internal::PointOnLineSegmentNearestPoint(p1, p2, Center);
 
-						bool intersects = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+			// If the distance to the center of the sphere to the point is less than 
+			// the radius of the sphere then it must intersect.
+			Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point2)), RadiusSq));
 
-						if (intersects)
-						{
-							XMVECTOR bestPoint = Point0;
-							if (!inside)
-							{
-								// If the sphere center's projection on the triangle plane is not within the triangle,
-								//	determine the closest point on triangle to the sphere center
-								float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - Center));
-								bestPoint = Point1;
+			// Edge 2,0
+			XMVECTOR Point3 = DirectX::Internal::PointOnLineSegmentNearestPoint(p2, p0, Center);
 
-								float d = XMVectorGetX(XMVector3LengthSq(Point2 - Center));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									bestPoint = Point2;
-								}
-								d = XMVectorGetX(XMVector3LengthSq(Point3 - Center));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									bestPoint = Point3;
-								}
-							}
-							XMVECTOR intersectionVec = Center - bestPoint;
-							XMVECTOR intersectionVecLen = XMVector3Length(intersectionVec);
-
-							result.entity = entity;
-							result.depth = sphere.radius - XMVectorGetX(intersectionVecLen);
-							XMStoreFloat3(&result.position, bestPoint);
-							XMStoreFloat3(&result.normal, intersectionVec / intersectionVecLen);
-							return result;
-						}
+			// If the distance to the center of the sphere to the point is less than 
+			// the radius of the sphere then it must intersect.
+			Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point3)), RadiusSq));
+
+			bool intersects = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+
+			if (intersects)
+			{
+				XMVECTOR bestPoint = Point0;
+				if (!inside)
+				{
+					// If the sphere center's projection on the triangle plane is not within the triangle,
+					//	determine the closest point on triangle to the sphere center
+					float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - Center));
+					bestPoint = Point1;
+
+					float d = XMVectorGetX(XMVector3LengthSq(Point2 - Center));
+					if (d < bestDist)
+					{
+						bestDist = d;
+						bestPoint = Point2;
+					}
+					d = XMVectorGetX(XMVector3LengthSq(Point3 - Center));
+					if (d < bestDist)
+					{
+						bestDist = d;
+						bestPoint = Point3;
 					}
-					subsetCounter++;
 				}
-
+				XMVECTOR intersectionVec = Center - bestPoint;
+				XMVECTOR intersectionVecLen = XMVector3Length(intersectionVec);
+
+				result.entity = entity;
+				result.depth = sphere.radius - XMVectorGetX(intersectionVecLen);
+				XMStoreFloat3(&result.position, bestPoint);
+				XMStoreFloat3(&result.normal, intersectionVec / intersectionVecLen);
+				return true;
 			}
-		}
+
+			return false;
+		});
 
 		return result;
 	}
@@ -4070,268 +4908,192 @@ namespace wiScene
 		XMVECTOR RadiusSq = XMVectorMultiply(Radius, Radius);
 		AABB capsule_aabb = capsule.getAABB();
 
-		if (scene.objects.GetCount() > 0)
-		{
+		ForEachTriangleInBox(capsule_aabb, renderTypeMask, layerMask, scene, [&](Entity entity, const MeshComponent& mesh, XMVECTOR p0, XMVECTOR p1, XMVECTOR p2) {
 
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
+			XMFLOAT3 min, max;
+			XMStoreFloat3(&min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+			XMStoreFloat3(&max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+			AABB aabb_triangle(min, max);
+			if (capsule_aabb.intersects(aabb_triangle) == AABB::OUTSIDE)
 			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (capsule_aabb.intersects(aabb) == AABB::INTERSECTION_TYPE::OUTSIDE)
-				{
-					continue;
-				}
+				return false;
+			}
 
-				const ObjectComponent& object = scene.objects[i];
-				if (object.meshID == INVALID_ENTITY)
-				{
-					continue;
-				}
-				if (!(renderTypeMask & object.GetRenderTypes()))
-				{
-					continue;
-				}
+			// Compute the plane of the triangle (has to be normalized).
+			XMVECTOR N = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+			
+			XMVECTOR ReferencePoint;
+			XMVECTOR d = XMVector3Normalize(B - A);
+			if (abs(XMVectorGetX(XMVector3Dot(N, d))) < FLT_EPSILON)
+			{
+				// Capsule line cannot be intersected with triangle plane (they are parallel)
+				//	In this case, just take a point from triangle
+				ReferencePoint = p0;
+			}
+			else
+			{
+				// Intersect capsule line with triangle plane:
+				XMVECTOR t = XMVector3Dot(N, (Base - p0) / XMVectorAbs(XMVector3Dot(N, d)));
+				XMVECTOR LinePlaneIntersection = Base + d * t;
 
-				Entity entity = scene.aabb_objects.GetEntity(i);
-				const LayerComponent* layer = scene.layers.GetComponent(entity);
-				if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
-				{
-					continue;
-				}
+				// Compute the cross products of the vector from the base of each edge to 
+				// the point with each edge vector.
+				XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p0), XMVectorSubtract(p1, p0));
+				XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p1), XMVectorSubtract(p2, p1));
+				XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p2), XMVectorSubtract(p0, p2));
 
-				const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
-				const SoftBodyPhysicsComponent* softbody = scene.softbodies.GetComponent(object.meshID);
-				const bool softbody_active = softbody != nullptr && !softbody->vertex_positions_simulation.empty();
+				// If the cross product points in the same direction as the normal the the
+				// point is inside the edge (it is zero if is on the edge).
+				XMVECTOR Zero = XMVectorZero();
+				XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
+				XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
+				XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
 
-				const XMMATRIX objectMat = object.transform_index >= 0 ? XMLoadFloat4x4(&scene.transforms[object.transform_index].world) : XMMatrixIdentity();
+				// If the point inside all of the edges it is inside.
+				XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
 
-				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
+				bool inside = XMVectorGetIntX(Intersection) != 0;
 
-				int subsetCounter = 0;
-				for (auto& subset : mesh.subsets)
+				if (inside)
 				{
-					for (size_t i = 0; i < subset.indexCount; i += 3)
-					{
-						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
-						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
-						const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
-
-						XMVECTOR p0;
-						XMVECTOR p1;
-						XMVECTOR p2;
-
-						if (softbody_active)
-						{
-							p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
-							p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
-							p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
-						}
-						else
-						{
-							if (armature == nullptr)
-							{
-								p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
-								p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
-								p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
-							}
-							else
-							{
-								p0 = SkinVertex(mesh, *armature, i0);
-								p1 = SkinVertex(mesh, *armature, i1);
-								p2 = SkinVertex(mesh, *armature, i2);
-							}
-						}
-						
-						p0 = XMVector3Transform(p0, objectMat);
-						p1 = XMVector3Transform(p1, objectMat);
-						p2 = XMVector3Transform(p2, objectMat);
-
-						XMFLOAT3 min, max;
-						XMStoreFloat3(&min, XMVectorMin(p0, XMVectorMin(p1, p2)));
-						XMStoreFloat3(&max, XMVectorMax(p0, XMVectorMax(p1, p2)));
-						AABB aabb_triangle(min, max);
-						if (capsule_aabb.intersects(aabb_triangle) == AABB::OUTSIDE)
-						{
-							continue;
-						}
-
-						// Compute the plane of the triangle (has to be normalized).
-						XMVECTOR N = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
-						
-						XMVECTOR ReferencePoint;
-						XMVECTOR d = XMVector3Normalize(B - A);
-						if (abs(XMVectorGetX(XMVector3Dot(N, d))) < FLT_EPSILON)
-						{
-							// Capsule line cannot be intersected with triangle plane (they are parallel)
-							//	In this case, just take a point from triangle
-							ReferencePoint = p0;
-						}
-						else
-						{
-							// Intersect capsule line with triangle plane:
-							XMVECTOR t = XMVector3Dot(N, (Base - p0) / XMVectorAbs(XMVector3Dot(N, d)));
-							XMVECTOR LinePlaneIntersection = Base + d * t;
-
-							// Compute the cross products of the vector from the base of each edge to 
-							// the point with each edge vector.
-							XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p0), XMVectorSubtract(p1, p0));
-							XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p1), XMVectorSubtract(p2, p1));
-							XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p2), XMVectorSubtract(p0, p2));
-
-							// If the cross product points in the same direction as the normal the the
-							// point is inside the edge (it is zero if is on the edge).
-							XMVECTOR Zero = XMVectorZero();
-							XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
-							XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
-							XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
-
-							// If the point inside all of the edges it is inside.
-							XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
-
-							bool inside = XMVectorGetIntX(Intersection) != 0;
-
-							if (inside)
-							{
-								ReferencePoint = LinePlaneIntersection;
-							}
-							else
-							{
-								// Find the nearest point on each edge.
+					ReferencePoint = LinePlaneIntersection;
+				}
+				else
+				{
+					// Find the nearest point on each edge.
 
-								// Edge 0,1
-								XMVECTOR Point1 = wiMath::ClosestPointOnLineSegment(p0, p1, LinePlaneIntersection);
+					// Edge 0,1
+					XMVECTOR Point1 = wiMath::ClosestPointOnLineSegment(p0, p1, LinePlaneIntersection);
 
-								// Edge 1,2
-								XMVECTOR Point2 = wiMath::ClosestPointOnLineSegment(p1, p2, LinePlaneIntersection);
+					// Edge 1,2
+					XMVECTOR Point2 = wiMath::ClosestPointOnLineSegment(p1, p2, LinePlaneIntersection);
 
-								// Edge 2,0
-								XMVECTOR Point3 = wiMath::ClosestPointOnLineSegment(p2, p0, LinePlaneIntersection);
+					// Edge 2,0
+					XMVECTOR Point3 = wiMath::ClosestPointOnLineSegment(p2, p0, LinePlaneIntersection);
 
-								ReferencePoint = Point1;
-								float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - LinePlaneIntersection));
-								float d = abs(XMVectorGetX(XMVector3LengthSq(Point2 - LinePlaneIntersection)));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									ReferencePoint = Point2;
-								}
-								d = abs(XMVectorGetX(XMVector3LengthSq(Point3 - LinePlaneIntersection)));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									ReferencePoint = Point3;
-								}
-							}
+					ReferencePoint = Point1;
+					float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - LinePlaneIntersection));
+					float d = abs(XMVectorGetX(XMVector3LengthSq(Point2 - LinePlaneIntersection)));
+					if (d < bestDist)
+					{
+						bestDist = d;
+						ReferencePoint = Point2;
+					}
+					d = abs(XMVectorGetX(XMVector3LengthSq(Point3 - LinePlaneIntersection)));
+					if (d < bestDist)
+					{
+						bestDist = d;
+						ReferencePoint = Point3;
+					}
+				}
 
 
-						}
+			}
 
-						// Place a sphere on closest point on line segment to intersection:
-						XMVECTOR Center = wiMath::ClosestPointOnLineSegment(A, B, ReferencePoint);
+			// Place a sphere on closest point on line segment to intersection:
+			XMVECTOR Center = wiMath::ClosestPointOnLineSegment(A, B, ReferencePoint);
 
-						// Assert that the triangle is not degenerate.
-						assert(!XMVector3Equal(N, XMVectorZero()));
+			// Assert that the triangle is not degenerate.
+			assert(!XMVector3Equal(N, XMVectorZero()));
 
-						// Find the nearest feature on the triangle to the sphere.
-						XMVECTOR Dist = XMVector3Dot(XMVectorSubtract(Center, p0), N);
+			// Find the nearest feature on the triangle to the sphere.
+			XMVECTOR Dist = XMVector3Dot(XMVectorSubtract(Center, p0), N);
 
-						if (!mesh.IsDoubleSided() && XMVectorGetX(Dist) > 0)
-						{
-							continue; // pass through back faces
-						}
+			if (!mesh.IsDoubleSided() && XMVectorGetX(Dist) > 0)
+			{
+				return false; // pass through back faces
+			}
 
-						// If the center of the sphere is farther from the plane of the triangle than
-						// the radius of the sphere, then there cannot be an intersection.
-						XMVECTOR NoIntersection = XMVectorLess(Dist, XMVectorNegate(Radius));
-						NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(Dist, Radius));
+			// If the center of the sphere is farther from the plane of the triangle than
+			// the radius of the sphere, then there cannot be an intersection.
+			XMVECTOR NoIntersection = XMVectorLess(Dist, XMVectorNegate(Radius));
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(Dist, Radius));
 
-						// Project the center of the sphere onto the plane of the triangle.
-						XMVECTOR Point0 = XMVectorNegativeMultiplySubtract(N, Dist, Center);
+			// Project the center of the sphere onto the plane of the triangle.
+			XMVECTOR Point0 = XMVectorNegativeMultiplySubtract(N, Dist, Center);
 
-						// Is it inside all the edges? If so we intersect because the distance 
-						// to the plane is less than the radius.
-						//XMVECTOR Intersection = DirectX::Internal::PointOnPlaneInsideTriangle(Point0, p0, p1, p2);
+			// Is it inside all the edges? If so we intersect because the distance 
+			// to the plane is less than the radius.
+			//XMVECTOR Intersection = DirectX::Internal::PointOnPlaneInsideTriangle(Point0, p0, p1, p2);
 
-						// Compute the cross products of the vector from the base of each edge to 
-						// the point with each edge vector.
-						XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(Point0, p0), XMVectorSubtract(p1, p0));
-						XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(Point0, p1), XMVectorSubtract(p2, p1));
-						XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(Point0, p2), XMVectorSubtract(p0, p2));
+			// Compute the cross products of the vector from the base of each edge to 
+			// the point with each edge vector.
+			XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(Point0, p0), XMVectorSubtract(p1, p0));
+			XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(Point0, p1), XMVectorSubtract(p2, p1));
+			XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(Point0, p2), XMVectorSubtract(p0, p2));
 
-						// If the cross product points in the same direction as the normal the the
-						// point is inside the edge (it is zero if is on the edge).
-						XMVECTOR Zero = XMVectorZero();
-						XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
-						XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
-						XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
+			// If the cross product points in the same direction as the normal the the
+			// point is inside the edge (it is zero if is on the edge).
+			XMVECTOR Zero = XMVectorZero();
+			XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
+			XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
+			XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
 
-						// If the point inside all of the edges it is inside.
-						XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
+			// If the point inside all of the edges it is inside.
+			XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
 
-						bool inside = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+			bool inside = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
 
-						// Find the nearest point on each edge.
+			// Find the nearest point on each edge.
 
-						// Edge 0,1
-						XMVECTOR Point1 = wiMath::ClosestPointOnLineSegment(p0, p1, Center);
+			// Edge 0,1
+			XMVECTOR Point1 = wiMath::ClosestPointOnLineSegment(p0, p1, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point1)), RadiusSq));
+			// If the distance to the center of the sphere to the point is less than 
+			// the radius of the sphere then it must intersect.
+			Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point1)), RadiusSq));
 
-						// Edge 1,2
-						XMVECTOR Point2 = wiMath::ClosestPointOnLineSegment(p1, p2, Center);
+			// Edge 1,2
+			XMVECTOR Point2 = wiMath::ClosestPointOnLineSegment(p1, p2, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point2)), RadiusSq));
+			// If the distance to the center of the sphere to the point is less than 
+			// the radius of the sphere then it must intersect.
+			Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point2)), RadiusSq));
 
-						// Edge 2,0
-						XMVECTOR Point3 = wiMath::ClosestPointOnLineSegment(p2, p0, Center);
+			// Edge 2,0
+			XMVECTOR Point3 = wiMath::ClosestPointOnLineSegment(p2, p0, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point3)), RadiusSq));
+			// If the distance to the center of the sphere to the point is less than 
+			// the radius of the sphere then it must intersect.
+			Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point3)), RadiusSq));
 
-						bool intersects = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+			bool intersects = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
 
-						if (intersects)
-						{
-							XMVECTOR bestPoint = Point0;
-							if (!inside)
-							{
-								// If the sphere center's projection on the triangle plane is not within the triangle,
-								//	determine the closest point on triangle to the sphere center
-								float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - Center));
-								bestPoint = Point1;
+			if (intersects)
+			{
+				XMVECTOR bestPoint = Point0;
+				if (!inside)
+				{
+					// If the sphere center's projection on the triangle plane is not within the triangle,
+					//	determine the closest point on triangle to the sphere center
+					float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - Center));
+					bestPoint = Point1;
 
-								float d = XMVectorGetX(XMVector3LengthSq(Point2 - Center));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									bestPoint = Point2;
-								}
-								d = XMVectorGetX(XMVector3LengthSq(Point3 - Center));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									bestPoint = Point3;
-								}
-							}
-							XMVECTOR intersectionVec = Center - bestPoint;
-							XMVECTOR intersectionVecLen = XMVector3Length(intersectionVec);
-
-							result.entity = entity;
-							result.depth = capsule.radius - XMVectorGetX(intersectionVecLen);
-							XMStoreFloat3(&result.position, bestPoint);
-							XMStoreFloat3(&result.normal, intersectionVec / intersectionVecLen);
-							return result;
-						}
+					float d = XMVectorGetX(XMVector3LengthSq(Point2 - Center));
+					if (d < bestDist)
+					{
+						bestDist = d;
+						bestPoint = Point2;
+					}
+					d = XMVectorGetX(XMVector3LengthSq(Point3 - Center));
+					if (d < bestDist)
+					{
+						bestDist = d;
+						bestPoint = Point3;
 					}
-					subsetCounter++;
 				}
-
+				XMVECTOR intersectionVec = Center - bestPoint;
+				XMVECTOR intersectionVecLen = XMVector3Length(intersectionVec);
+
+				result.entity = entity;
+				result.depth = capsule.radius - XMVectorGetX(intersectionVecLen);
+				XMStoreFloat3(&result.position, bestPoint);
+				XMStoreFloat3(&result.normal, intersectionVec / intersectionVecLen);
+				return true;
 			}
-		}
+
+			return false;
+		});
 
 		return result;
 	}
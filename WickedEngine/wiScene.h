@@ -10,6 +10,7 @@
 #include "wiResourceManager.h"
 #include "wiSpinLock.h"
 #include "wiGPUBVH.h"
+#include "wiBVH.h"
 #include "wiOcean.h"
 #include "wiSprite.h"
 
@@ -371,8 +372,13 @@ namespace wiScene
 		};
 		std::vector<MeshMorphTarget> targets;
 
+		// Simplified convex hull for CONVEX_HULL physics shapes (optional, see wiPhysicsEngine::CookConvexHull())
+		std::vector<XMFLOAT3> convexhull_positions;
+
 		// Non-serialized attributes:
 		AABB aabb;
+		uint32_t revision = 0; // incremented when the mesh data is changed (CreateRenderData(), wiPhysicsEngine::CookConvexHull()), so the data that is derived from it can be recreated
+		wiBVH bvh; // triangle BVH in local space for the CPU queries (Pick(), SceneIntersectSphere()...), triangles are numbered in the order of subsets. Only built for meshes that are not deformed
 		wiGraphics::GPUBuffer indexBuffer;
 		wiGraphics::GPUBuffer vertexBuffer_POS;
 		wiGraphics::GPUBuffer vertexBuffer_TAN;
@@ -1083,6 +1089,9 @@ namespace wiScene
 
 			// The data is now not part of the sampler, so it can be shared. This is kept only for backwards compatibility with previous versions.
 			AnimationDataComponent backwards_compatibility_data;
+
+			// Non-serialized attributes:
+			int keyframe_cursor = 0; // right keyframe of the previous update, this is where the next keyframe search starts
 		};
 		std::vector<AnimationChannel> channels;
 		std::vector<AnimationSampler> samplers;
@@ -1290,6 +1299,69 @@ namespace wiScene
 		AABB bounds;
 		std::vector<AABB> parallel_bounds;
 		WeatherComponent weather;
+
+		// Bounding boxes of objects that changed in the last object update (merged previous and current bounds)
+		//	This lets cached culling results be validated by checking only the objects that moved
+		//	If more objects moved than the capacity, moved_object_count will be larger than the capacity and only the count is valid
+		static constexpr uint32_t moved_object_bounds_capacity = 1024;
+		std::vector<AABB> moved_object_bounds;
+		std::atomic<uint32_t> moved_object_count{ 0 };
+		uint64_t object_bounds_version = 0; // incremented on every object update
+
+		// CPU BVHs over the bounding boxes for culling, these are refitted or rebuilt by Scene::Update():
+		wiBVH bvh_objects;
+		wiBVH bvh_lights;
+		wiBVH bvh_decals;
+		wiBVH bvh_probes;
+
+		// Hierarchy update state:
+		//	Nodes are sorted by depth level, so each level can be processed in parallel
+		//	Every node and every root parent occupies a slot in the contiguous world/layer arrays
+		struct HierarchyNode
+		{
+			wiECS::Entity entity;
+			uint32_t parent_slot;
+		};
+		enum HIERARCHY_SLOT_FLAGS
+		{
+			HIERARCHY_SLOT_TRANSFORM = 1 << 0,
+			HIERARCHY_SLOT_LAYER = 1 << 1,
+		};
+		std::vector<uint64_t> hierarchy_signature; // (entity, parent) pairs in component order, to detect changes
+		std::vector<HierarchyNode> hierarchy_nodes; // slots [0, nodecount)
+		std::vector<wiECS::Entity> hierarchy_roots; // parents without hierarchy, slots [nodecount, nodecount + rootcount)
+		std::vector<uint32_t> hierarchy_levels; // offsets of depth levels into hierarchy_nodes
+		std::vector<uint32_t> hierarchy_slots; // hierarchy component index -> slot
+		std::vector<XMFLOAT4X4> hierarchy_worlds;
+		std::vector<uint32_t> hierarchy_layermasks;
+		std::vector<uint8_t> hierarchy_slotflags;
+		uint64_t hierarchy_version = 0; // incremented when the nodes are rebuilt
+
+		// Spring update state:
+		//	Springs are grouped into islands that don't share transforms, so islands can be solved in parallel
+		//	An island is the set of springs that are connected through spring parents, including the first non-spring parent
+		//	Springs keep their component order inside an island
+		struct SpringNode
+		{
+			uint32_t spring_index;
+			wiECS::Entity parent;
+		};
+		std::vector<wiECS::Entity> spring_signature; // spring entities in component order, to detect changes
+		uint64_t spring_hierarchy_version = ~0ull;
+		std::vector<SpringNode> spring_nodes; // sorted by island
+		std::vector<uint32_t> spring_islands; // offsets of islands into spring_nodes
+
+		// Inverse kinematics update state:
+		//	IK components whose chains or targets share transforms are grouped into the same island, islands are solved in parallel
+		//	Instead of recomputing the whole hierarchy after IK, only the subtrees under the modified chains are updated
+		std::vector<uint64_t> ik_signature; // (entity, target) pairs and chain lengths in component order, to detect changes
+		uint64_t ik_hierarchy_version = ~0ull;
+		std::vector<uint32_t> ik_order; // IK component indices sorted by island
+		std::vector<uint32_t> ik_islands; // offsets of islands into ik_order
+		std::vector<uint32_t> ik_chain_offsets; // offsets into ik_chain_slots per IK component index
+		std::vector<uint32_t> ik_chain_slots; // hierarchy slots of the transforms that are modified by each IK chain
+		std::vector<uint8_t> ik_dirty; // per hierarchy slot
+
 		wiGraphics::RaytracingAccelerationStructure TLAS;
 		std::vector<uint8_t> TLAS_instances;
 		wiGPUBVH BVH; // this is for non-hardware accelerated raytracing
@@ -1418,7 +1490,48 @@ namespace wiScene
 		// Detaches all children from an entity (if there are any):
 		void Component_DetachChildren(wiECS::Entity parent);
 
-		void Serialize(wiArchive& archive);
+		// Sections of the chunked scene format, every serialized component manager is in a separate section
+		//	The values are written to files, so existing ones must not be changed
+		enum SECTION
+		{
+			SECTION_NAMES,
+			SECTION_LAYERS,
+			SECTION_TRANSFORMS,
+			SECTION_PREV_TRANSFORMS,
+			SECTION_HIERARCHY,
+			SECTION_MATERIALS,
+			SECTION_MESHES,
+			SECTION_IMPOSTORS,
+			SECTION_OBJECTS,
+			SECTION_AABB_OBJECTS,
+			SECTION_RIGIDBODIES,
+			SECTION_SOFTBODIES,
+			SECTION_ARMATURES,
+			SECTION_LIGHTS,
+			SECTION_AABB_LIGHTS,
+			SECTION_CAMERAS,
+			SECTION_PROBES,
+			SECTION_AABB_PROBES,
+			SECTION_FORCES,
+			SECTION_DECALS,
+			SECTION_AABB_DECALS,
+			SECTION_ANIMATIONS,
+			SECTION_EMITTERS,
+			SECTION_HAIRS,
+			SECTION_WEATHERS,
+			SECTION_SOUNDS,
+			SECTION_INVERSE_KINEMATICS,
+			SECTION_SPRINGS,
+			SECTION_ANIMATION_DATAS,
+			SECTION_COUNT
+		};
+		static constexpr uint64_t SECTION_MASK_ALL = ~0ull;
+
+		// Read/write the scene from/to an archive
+		//	chunked		:	when writing, every component manager is written into a separate section, and the sections are decoded in parallel when reading
+		//					when reading, the format is detected automatically
+		//	sectionMask	:	when reading a chunked scene, only the sections with (1ull << SECTION) bits set are decoded, the others are skipped
+		void Serialize(wiArchive& archive, bool chunked = false, uint64_t sectionMask = SECTION_MASK_ALL);
 
 		void RunPreviousFrameTransformUpdateSystem(wiJobSystem::context& ctx);
 		void RunAnimationUpdateSystem(wiJobSystem::context& ctx);
@@ -1464,18 +1577,20 @@ namespace wiScene
 	//	fileName		:	file path
 	//	transformMatrix	:	everything will be transformed by this matrix (optional)
 	//	attached		:	everything will be attached to a base entity
+	//	sectionMask		:	sections of a chunked scene that will be loaded, see Scene::SECTION (optional)
 	//
 	//	returns INVALID_ENTITY if attached argument was false, else it returns the base entity handle
-	wiECS::Entity LoadModel(const std::string& fileName, const XMMATRIX& transformMatrix = XMMatrixIdentity(), bool attached = false);
+	wiECS::Entity LoadModel(const std::string& fileName, const XMMATRIX& transformMatrix = XMMatrixIdentity(), bool attached = false, uint64_t sectionMask = Scene::SECTION_MASK_ALL);
 
 	// Helper function to open a wiscene file and add the contents to the specified scene. This is thread safe as it doesn't modify global scene
 	//	scene			:	the scene that will contain the model
 	//	fileName		:	file path
 	//	transformMatrix	:	everything will be transformed by this matrix (optional)
 	//	attached		:	everything will be attached to a base entity
+	//	sectionMask		:	sections of a chunked scene that will be loaded, see Scene::SECTION (optional)
 	//
 	//	returns INVALID_ENTITY if attached argument was false, else it returns the base entity handle
-	wiECS::Entity LoadModel(Scene& scene, const std::string& fileName, const XMMATRIX& transformMatrix = XMMatrixIdentity(), bool attached = false);
+	wiECS::Entity LoadModel(Scene& scene, const std::string& fileName, const XMMATRIX& transformMatrix = XMMatrixIdentity(), bool attached = false, uint64_t sectionMask = Scene::SECTION_MASK_ALL);
 
 	struct PickResult
 	{
@@ -1501,6 +1616,11 @@ namespace wiScene
 	//	layerMask		:	filter based on layer
 	//	scene			:	the scene that will be traced against the ray
 	PickResult Pick(const RAY& ray, uint32_t renderTypeMask = RENDERTYPE_OPAQUE, uint32_t layerMask = ~0, const Scene& scene = GetScene());
+	// Batched version of Pick(), the rays are traced in packets against the object and mesh BVHs
+	//	rays			:	array of rays that will be traced
+	//	count			:	number of rays
+	//	results			:	array of count elements that receives the result of each ray
+	void Pick(const RAY* rays, uint32_t count, PickResult* results, uint32_t renderTypeMask = RENDERTYPE_OPAQUE, uint32_t layerMask = ~0, const Scene& scene = GetScene());
 
 	struct SceneIntersectSphereResult
 	{
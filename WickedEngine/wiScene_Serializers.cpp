@@ -348,14 +348,14 @@ namespace wiScene
 		if (archive.IsReadMode())
 		{
 			archive >> _flags;
-			archive >> vertex_positions;
-			archive >> vertex_normals;
-			archive >> vertex_uvset_0;
-			archive >> vertex_boneindices;
-			archive >> vertex_boneweights;
-			archive >> vertex_atlas;
-			archive >> vertex_colors;
-			archive >> indices;
+			archive.ReadBlock(vertex_positions);
+			archive.ReadBlock(vertex_normals);
+			archive.ReadBlock(vertex_uvset_0);
+			archive.ReadBlock(vertex_boneindices);
+			archive.ReadBlock(vertex_boneweights);
+			archive.ReadBlock(vertex_atlas);
+			archive.ReadBlock(vertex_colors);
+			archive.ReadBlock(indices);
 
 			size_t subsetCount;
 			archive >> subsetCount;
@@ -372,7 +372,7 @@ namespace wiScene
 
 			if (archive.GetVersion() >= 28)
 			{
-				archive >> vertex_uvset_1;
+				archive.ReadBlock(vertex_uvset_1);
 			}
 
 			if (archive.GetVersion() >= 41)
@@ -384,12 +384,12 @@ namespace wiScene
 
 			if (archive.GetVersion() >= 43)
 			{
-				archive >> vertex_windweights;
+				archive.ReadBlock(vertex_windweights);
 			}
 
 			if (archive.GetVersion() >= 51)
 			{
-				archive >> vertex_tangents;
+				archive.ReadBlock(vertex_tangents);
 			}
 
 			if (archive.GetVersion() >= 53)
@@ -399,12 +399,17 @@ namespace wiScene
 			    targets.resize(targetCount);
 			    for (size_t i = 0; i < targetCount; ++i)
 			    {
-					archive >> targets[i].vertex_positions;
-					archive >> targets[i].vertex_normals;
+					archive.ReadBlock(targets[i].vertex_positions);
+					archive.ReadBlock(targets[i].vertex_normals);
 					archive >> targets[i].weight;
 			    }
 			}
 
+			if (archive.GetVersion() >= 75)
+			{
+				archive.ReadBlock(convexhull_positions);
+			}
+
 			wiJobSystem::Execute(seri.ctx, [&](wiJobArgs args) {
 				CreateRenderData();
 			});
@@ -412,14 +417,14 @@ namespace wiScene
 		else
 		{
 			archive << _flags;
-			archive << vertex_positions;
-			archive << vertex_normals;
-			archive << vertex_uvset_0;
-			archive << vertex_boneindices;
-			archive << vertex_boneweights;
-			archive << vertex_atlas;
-			archive << vertex_colors;
-			archive << indices;
+			archive.WriteBlock(vertex_positions);
+			archive.WriteBlock(vertex_normals);
+			archive.WriteBlock(vertex_uvset_0);
+			archive.WriteBlock(vertex_boneindices);
+			archive.WriteBlock(vertex_boneweights);
+			archive.WriteBlock(vertex_atlas);
+			archive.WriteBlock(vertex_colors);
+			archive.WriteBlock(indices);
 
 			archive << subsets.size();
 			for (size_t i = 0; i < subsets.size(); ++i)
@@ -434,7 +439,7 @@ namespace wiScene
 
 			if (archive.GetVersion() >= 28)
 			{
-				archive << vertex_uvset_1;
+				archive.WriteBlock(vertex_uvset_1);
 			}
 
 			if (archive.GetVersion() >= 41)
@@ -446,12 +451,12 @@ namespace wiScene
 
 			if (archive.GetVersion() >= 43)
 			{
-				archive << vertex_windweights;
+				archive.WriteBlock(vertex_windweights);
 			}
 
 			if (archive.GetVersion() >= 51)
 			{
-				archive << vertex_tangents;
+				archive.WriteBlock(vertex_tangents);
 			}
 
 			if (archive.GetVersion() >= 53)
@@ -459,12 +464,17 @@ namespace wiScene
 			    archive << targets.size();
 			    for (size_t i = 0; i < targets.size(); ++i)
 			    {
-					archive << targets[i].vertex_positions;
-					archive << targets[i].vertex_normals;
+					archive.WriteBlock(targets[i].vertex_positions);
+					archive.WriteBlock(targets[i].vertex_normals);
 					archive << targets[i].weight;
 			    }
 			}
 
+			if (archive.GetVersion() >= 75)
+			{
+				archive.WriteBlock(convexhull_positions);
+			}
+
 		}
 	}
 	void ImpostorComponent::Serialize(wiArchive& archive, EntitySerializer& seri)
@@ -915,14 +925,14 @@ namespace wiScene
 		if (archive.IsReadMode())
 		{
 			archive >> _flags;
-			archive >> keyframe_times;
-			archive >> keyframe_data;
+			archive.ReadBlock(keyframe_times);
+			archive.ReadBlock(keyframe_data);
 		}
 		else
 		{
 			archive << _flags;
-			archive << keyframe_times;
-			archive << keyframe_data;
+			archive.WriteBlock(keyframe_times);
+			archive.WriteBlock(keyframe_data);
 		}
 	}
 	void WeatherComponent::Serialize(wiArchive& archive, EntitySerializer& seri)
@@ -1281,19 +1291,22 @@ namespace wiScene
 		}
 	}
 
-	void Scene::Serialize(wiArchive& archive)
+	void Scene::Serialize(wiArchive& archive, bool chunked, uint64_t sectionMask)
 	{
 		std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
 
+		// The first value was reserved before archive version 74, since then it contains flags:
+		static constexpr uint32_t SERIALIZED_CHUNKED = 1 << 0;
 		if (archive.IsReadMode())
 		{
-			uint32_t reserved;
-			archive >> reserved;
+			uint32_t serialized_flags;
+			archive >> serialized_flags;
+			chunked = archive.GetVersion() >= 74 && (serialized_flags & SERIALIZED_CHUNKED);
 		}
 		else
 		{
-			uint32_t reserved = 0;
-			archive << reserved;
+			uint32_t serialized_flags = chunked ? SERIALIZED_CHUNKED : 0;
+			archive << serialized_flags;
 		}
 
 		// Keeping this alive to keep serialized resources alive until entity serialization ends:
@@ -1303,49 +1316,123 @@ namespace wiScene
 			wiResourceManager::Serialize(archive, resource_seri);
 		}
 
+		// Sections can be referenced by serialization subtasks, so they are kept alive until entity serialization ends:
+		std::vector<wiArchive> sections;
+
 		// With this we will ensure that serialized entities are unique and persistent across the scene:
 		EntitySerializer seri;
 
-		names.Serialize(archive, seri);
-		layers.Serialize(archive, seri);
-		transforms.Serialize(archive, seri);
-		prev_transforms.Serialize(archive, seri);
-		hierarchy.Serialize(archive, seri);
-		materials.Serialize(archive, seri);
-		meshes.Serialize(archive, seri);
-		impostors.Serialize(archive, seri);
-		objects.Serialize(archive, seri);
-		aabb_objects.Serialize(archive, seri);
-		rigidbodies.Serialize(archive, seri);
-		softbodies.Serialize(archive, seri);
-		armatures.Serialize(archive, seri);
-		lights.Serialize(archive, seri);
-		aabb_lights.Serialize(archive, seri);
-		cameras.Serialize(archive, seri);
-		probes.Serialize(archive, seri);
-		aabb_probes.Serialize(archive, seri);
-		forces.Serialize(archive, seri);
-		decals.Serialize(archive, seri);
-		aabb_decals.Serialize(archive, seri);
-		animations.Serialize(archive, seri);
-		emitters.Serialize(archive, seri);
-		hairs.Serialize(archive, seri);
-		weathers.Serialize(archive, seri);
-		if (archive.GetVersion() >= 30)
-		{
-			sounds.Serialize(archive, seri);
-		}
-		if (archive.GetVersion() >= 37)
+		auto serialize_section = [&](uint32_t section, wiArchive& archive) {
+			switch (section)
+			{
+			case SECTION_NAMES: names.Serialize(archive, seri); break;
+			case SECTION_LAYERS: layers.Serialize(archive, seri); break;
+			case SECTION_TRANSFORMS: transforms.Serialize(archive, seri); break;
+			case SECTION_PREV_TRANSFORMS: prev_transforms.Serialize(archive, seri); break;
+			case SECTION_HIERARCHY: hierarchy.Serialize(archive, seri); break;
+			case SECTION_MATERIALS: materials.Serialize(archive, seri); break;
+			case SECTION_MESHES: meshes.Serialize(archive, seri); break;
+			case SECTION_IMPOSTORS: impostors.Serialize(archive, seri); break;
+			case SECTION_OBJECTS: objects.Serialize(archive, seri); break;
+			case SECTION_AABB_OBJECTS: aabb_objects.Serialize(archive, seri); break;
+			case SECTION_RIGIDBODIES: rigidbodies.Serialize(archive, seri); break;
+			case SECTION_SOFTBODIES: softbodies.Serialize(archive, seri); break;
+			case SECTION_ARMATURES: armatures.Serialize(archive, seri); break;
+			case SECTION_LIGHTS: lights.Serialize(archive, seri); break;
+			case SECTION_AABB_LIGHTS: aabb_lights.Serialize(archive, seri); break;
+			case SECTION_CAMERAS: cameras.Serialize(archive, seri); break;
+			case SECTION_PROBES: probes.Serialize(archive, seri); break;
+			case SECTION_AABB_PROBES: aabb_probes.Serialize(archive, seri); break;
+			case SECTION_FORCES: forces.Serialize(archive, seri); break;
+			case SECTION_DECALS: decals.Serialize(archive, seri); break;
+			case SECTION_AABB_DECALS: aabb_decals.Serialize(archive, seri); break;
+			case SECTION_ANIMATIONS: animations.Serialize(archive, seri); break;
+			case SECTION_EMITTERS: emitters.Serialize(archive, seri); break;
+			case SECTION_HAIRS: hairs.Serialize(archive, seri); break;
+			case SECTION_WEATHERS: weathers.Serialize(archive, seri); break;
+			case SECTION_SOUNDS: sounds.Serialize(archive, seri); break;
+			case SECTION_INVERSE_KINEMATICS: inverse_kinematics.Serialize(archive, seri); break;
+			case SECTION_SPRINGS: springs.Serialize(archive, seri); break;
+			case SECTION_ANIMATION_DATAS: animation_datas.Serialize(archive, seri); break;
+			default: break; // unknown sections are skipped
+			}
+		};
+
+		if (!chunked)
 		{
-			inverse_kinematics.Serialize(archive, seri);
+			// Every component manager is serialized sequentially to the archive:
+			for (uint32_t section = 0; section < SECTION_COUNT; ++section)
+			{
+				if (section == SECTION_SOUNDS && archive.GetVersion() < 30)
+					continue;
+				if (section == SECTION_INVERSE_KINEMATICS && archive.GetVersion() < 37)
+					continue;
+				if (section == SECTION_SPRINGS && archive.GetVersion() < 38)
+					continue;
+				if (section == SECTION_ANIMATION_DATAS && archive.GetVersion() < 46)
+					continue;
+				serialize_section(section, archive);
+			}
 		}
-		if (archive.GetVersion() >= 38)
+		else if (archive.IsReadMode())
 		{
-			springs.Serialize(archive, seri);
+			// Table of contents: section identifiers and sizes
+			uint32_t section_count;
+			archive >> section_count;
+			std::vector<uint32_t> section_ids(section_count);
+			std::vector<uint64_t> section_sizes(section_count);
+			for (uint32_t i = 0; i < section_count; ++i)
+			{
+				archive >> section_ids[i];
+				archive >> section_sizes[i];
+			}
+
+			// The sections are opened in place, the unneeded ones are skipped:
+			std::vector<uint32_t> decoded_ids;
+			sections.reserve(section_count);
+			decoded_ids.reserve(section_count);
+			for (uint32_t i = 0; i < section_count; ++i)
+			{
+				if (section_ids[i] < SECTION_COUNT && (sectionMask & (1ull << section_ids[i])))
+				{
+					sections.push_back(archive.OpenSection((size_t)section_sizes[i]));
+					decoded_ids.push_back(section_ids[i]);
+				}
+				else
+				{
+					archive.Skip((size_t)section_sizes[i]);
+				}
+			}
+
+			// Component managers are independent, so the sections are decoded in parallel:
+			wiJobSystem::context ctx;
+			for (size_t i = 0; i < sections.size(); ++i)
+			{
+				wiJobSystem::Execute(ctx, [&, i](wiJobArgs args) {
+					serialize_section(decoded_ids[i], sections[i]);
+				});
+			}
+			wiJobSystem::Wait(ctx);
 		}
-		if (archive.GetVersion() >= 46)
+		else
 		{
-			animation_datas.Serialize(archive, seri);
+			sections.reserve(SECTION_COUNT);
+			for (uint32_t section = 0; section < SECTION_COUNT; ++section)
+			{
+				sections.push_back(archive.CreateSection());
+				serialize_section(section, sections.back());
+			}
+
+			archive << (uint32_t)sections.size();
+			for (uint32_t section = 0; section < SECTION_COUNT; ++section)
+			{
+				archive << section;
+				archive << (uint64_t)sections[section].GetSize();
+			}
+			for (auto& section : sections)
+			{
+				archive.WriteSection(section);
+			}
 		}
 
 		std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
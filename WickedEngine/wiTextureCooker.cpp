@@ -0,0 +1,615 @@
+#include "wiTextureCooker.h"
+
+#include "Utility/stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cfloat>
+
+namespace wiTextureCooker_Internal
+{
+	static constexpr uint64_t COOK_VERSION = 1; // must be incremented when the cooked output changes, so that old cooked textures are not used
+
+	// DXGI_FORMAT values of the DDS DX10 header:
+	static constexpr uint32_t DXGI_FORMAT_BC1_UNORM = 71;
+	static constexpr uint32_t DXGI_FORMAT_BC3_UNORM = 77;
+	static constexpr uint32_t DXGI_FORMAT_BC5_UNORM = 83;
+	static constexpr uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+
+	// MurmurHash64A by Austin Appleby (public domain)
+	uint64_t Hash(const uint8_t* data, size_t size, uint64_t seed)
+	{
+		const uint64_t m = 0xc6a4a7935bd1e995ull;
+		const int r = 47;
+		uint64_t h = seed ^ (size * m);
+
+		const size_t blocks = size / 8;
+		for (size_t i = 0; i < blocks; ++i)
+		{
+			uint64_t k;
+			std::memcpy(&k, data + i * 8, sizeof(k));
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+			h ^= k;
+			h *= m;
+		}
+
+		const uint8_t* tail = data + blocks * 8;
+		switch (size & 7)
+		{
+		case 7: h ^= uint64_t(tail[6]) << 48; [[fallthrough]];
+		case 6: h ^= uint64_t(tail[5]) << 40; [[fallthrough]];
+		case 5: h ^= uint64_t(tail[4]) << 32; [[fallthrough]];
+		case 4: h ^= uint64_t(tail[3]) << 24; [[fallthrough]];
+		case 3: h ^= uint64_t(tail[2]) << 16; [[fallthrough]];
+		case 2: h ^= uint64_t(tail[1]) << 8; [[fallthrough]];
+		case 1: h ^= uint64_t(tail[0]);
+			h *= m;
+		}
+
+		h ^= h >> r;
+		h *= m;
+		h ^= h >> r;
+		return h;
+	}
+
+	struct Image
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> rgba;
+	};
+
+	// The same filtering as generateMIPChain2DCS with coverage preservation: 2x2 box filter, but alpha is averaged in gamma 2.2 space
+	Image Downsample(const Image& src)
+	{
+		static const std::vector<float> alpha_to_linear = [] {
+			std::vector<float> table(256);
+			for (int i = 0; i < 256; ++i)
+			{
+				table[i] = std::pow(i / 255.0f, 2.2f);
+			}
+			return table;
+		}();
+
+		Image dst;
+		dst.width = std::max(1u, src.width / 2);
+		dst.height = std::max(1u, src.height / 2);
+		dst.rgba.resize(size_t(dst.width) * dst.height * 4);
+
+		for (uint32_t y = 0; y < dst.height; ++y)
+		{
+			const uint32_t y0 = std::min(y * 2, src.height - 1);
+			const uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+			for (uint32_t x = 0; x < dst.width; ++x)
+			{
+				const uint32_t x0 = std::min(x * 2, src.width - 1);
+				const uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+				const uint8_t* texels[] = {
+					&src.rgba[(size_t(y0) * src.width + x0) * 4],
+					&src.rgba[(size_t(y0) * src.width + x1) * 4],
+					&src.rgba[(size_t(y1) * src.width + x0) * 4],
+					&src.rgba[(size_t(y1) * src.width + x1) * 4],
+				};
+				uint8_t* dest = &dst.rgba[(size_t(y) * dst.width + x) * 4];
+				for (int c = 0; c < 3; ++c)
+				{
+					dest[c] = uint8_t((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+				}
+				const float alpha = (alpha_to_linear[texels[0][3]] + alpha_to_linear[texels[1][3]] + alpha_to_linear[texels[2][3]] + alpha_to_linear[texels[3][3]]) * 0.25f;
+				dest[3] = uint8_t(std::pow(alpha, 1.0f / 2.2f) * 255.0f + 0.5f);
+			}
+		}
+		return dst;
+	}
+
+	// 4x4 pixels, the blocks on the edges of small mips repeat the last row and column
+	struct Block
+	{
+		float pixels[16][4];
+	};
+	void GetBlock(const Image& image, uint32_t bx, uint32_t by, Block& block)
+	{
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			const uint32_t x = std::min(bx * 4 + (i & 3), image.width - 1);
+			const uint32_t y = std::min(by * 4 + (i >> 2), image.height - 1);
+			const uint8_t* texel = &image.rgba[(size_t(y) * image.width + x) * 4];
+			for (int c = 0; c < 4; ++c)
+			{
+				block.pixels[i][c] = texel[c];
+			}
+		}
+	}
+
+	// Computes the endpoints of the line that fits the block pixels best, using the first channel_count channels
+	void FitLine(const Block& block, int channel_count, float e0[4], float e1[4])
+	{
+		float mean[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < channel_count; ++c)
+			{
+				mean[c] += block.pixels[i][c] / 16.0f;
+			}
+		}
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c0 = 0; c0 < channel_count; ++c0)
+			{
+				for (int c1 = 0; c1 < channel_count; ++c1)
+				{
+					covariance[c0][c1] += (block.pixels[i][c0] - mean[c0]) * (block.pixels[i][c1] - mean[c1]);
+				}
+			}
+		}
+
+		// Principal axis with power iteration, starting from the row of the largest variance:
+		int largest = 0;
+		for (int c = 1; c < channel_count; ++c)
+		{
+			if (covariance[c][c] > covariance[largest][largest])
+			{
+				largest = c;
+			}
+		}
+		float axis[4] = {};
+		for (int c = 0; c < channel_count; ++c)
+		{
+			axis[c] = covariance[largest][c];
+		}
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float length = 0;
+			for (int c0 = 0; c0 < channel_count; ++c0)
+			{
+				for (int c1 = 0; c1 < channel_count; ++c1)
+				{
+					next[c0] += covariance[c0][c1] * axis[c1];
+				}
+				length += next[c0] * next[c0];
+			}
+			if (length < FLT_EPSILON)
+			{
+				break;
+			}
+			length = 1.0f / std::sqrt(length);
+			for (int c = 0; c < channel_count; ++c)
+			{
+				axis[c] = next[c] * length;
+			}
+		}
+
+		float tmin = FLT_MAX;
+		float tmax = -FLT_MAX;
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0;
+			for (int c = 0; c < channel_count; ++c)
+			{
+				t += (block.pixels[i][c] - mean[c]) * axis[c];
+			}
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+		for (int c = 0; c < channel_count; ++c)
+		{
+			e0[c] = std::max(0.0f, std::min(255.0f, mean[c] + axis[c] * tmax));
+			e1[c] = std::max(0.0f, std::min(255.0f, mean[c] + axis[c] * tmin));
+		}
+	}
+
+	// Least squares fit of the endpoints to the selected palette indices
+	//	weights : the interpolation factor toward e1 of each palette entry
+	void Refit(const Block& block, int channel_count, const uint8_t indices[16], const float* weights, float e0[4], float e1[4])
+	{
+		float aa = 0, ab = 0, bb = 0;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			const float b = weights[indices[i]];
+			const float a = 1 - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < channel_count; ++c)
+			{
+				ax[c] += a * block.pixels[i][c];
+				bx[c] += b * block.pixels[i][c];
+			}
+		}
+		const float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-6f)
+		{
+			return;
+		}
+		for (int c = 0; c < channel_count; ++c)
+		{
+			e0[c] = std::max(0.0f, std::min(255.0f, (bb * ax[c] - ab * bx[c]) / det));
+			e1[c] = std::max(0.0f, std::min(255.0f, (aa * bx[c] - ab * ax[c]) / det));
+		}
+	}
+
+	// Selects the closest palette entry for every pixel, returns the squared error
+	float SelectIndices(const Block& block, int channel_count, const float palette[][4], int palette_size, uint8_t indices[16])
+	{
+		float error = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			float best = FLT_MAX;
+			for (int j = 0; j < palette_size; ++j)
+			{
+				float distance = 0;
+				for (int c = 0; c < channel_count; ++c)
+				{
+					const float d = block.pixels[i][c] - palette[j][c];
+					distance += d * d;
+				}
+				if (distance < best)
+				{
+					best = distance;
+					indices[i] = uint8_t(j);
+				}
+			}
+			error += best;
+		}
+		return error;
+	}
+
+	inline uint16_t PackRGB565(const float color[4])
+	{
+		const uint32_t r = uint32_t(color[0] * 31.0f / 255.0f + 0.5f);
+		const uint32_t g = uint32_t(color[1] * 63.0f / 255.0f + 0.5f);
+		const uint32_t b = uint32_t(color[2] * 31.0f / 255.0f + 0.5f);
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+	inline void UnpackRGB565(uint16_t value, float color[4])
+	{
+		const uint32_t r = value >> 11;
+		const uint32_t g = (value >> 5) & 63;
+		const uint32_t b = value & 31;
+		color[0] = float((r << 3) | (r >> 2));
+		color[1] = float((g << 2) | (g >> 4));
+		color[2] = float((b << 3) | (b >> 2));
+		color[3] = 255;
+	}
+
+	// BC1 color block (the four color mode is always used), 8 bytes
+	void CompressBC1(const Block& block, uint8_t* dst)
+	{
+		static const float weights[4] = { 0, 1, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float e0[4], e1[4];
+		FitLine(block, 3, e0, e1);
+
+		uint16_t best_c0 = 0, best_c1 = 0;
+		uint8_t best_indices[16] = {};
+		float best_error = FLT_MAX;
+		for (int iteration = 0; iteration < 3; ++iteration)
+		{
+			const uint16_t c0 = PackRGB565(e0);
+			const uint16_t c1 = PackRGB565(e1);
+			float palette[4][4];
+			UnpackRGB565(c0, palette[0]);
+			UnpackRGB565(c1, palette[1]);
+			for (int c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (palette[0][c] * 2 + palette[1][c]) / 3.0f;
+				palette[3][c] = (palette[0][c] + palette[1][c] * 2) / 3.0f;
+			}
+			uint8_t indices[16];
+			const float error = SelectIndices(block, 3, palette, 4, indices);
+			if (error < best_error)
+			{
+				best_error = error;
+				best_c0 = c0;
+				best_c1 = c1;
+				std::memcpy(best_indices, indices, sizeof(indices));
+			}
+			Refit(block, 3, indices, weights, e0, e1);
+		}
+
+		// The four color mode requires c0 > c1:
+		if (best_c0 < best_c1)
+		{
+			std::swap(best_c0, best_c1);
+			for (auto& index : best_indices)
+			{
+				index ^= 1;
+			}
+		}
+		else if (best_c0 == best_c1)
+		{
+			std::memset(best_indices, 0, sizeof(best_indices));
+		}
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			bits |= uint32_t(best_indices[i]) << (i * 2);
+		}
+		dst[0] = uint8_t(best_c0);
+		dst[1] = uint8_t(best_c0 >> 8);
+		dst[2] = uint8_t(best_c1);
+		dst[3] = uint8_t(best_c1 >> 8);
+		for (int i = 0; i < 4; ++i)
+		{
+			dst[4 + i] = uint8_t(bits >> (i * 8));
+		}
+	}
+
+	// BC4 single channel block (the eight value mode is always used), 8 bytes
+	void CompressBC4(const Block& block, int channel, uint8_t* dst)
+	{
+		float vmin = 255, vmax = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			vmin = std::min(vmin, block.pixels[i][channel]);
+			vmax = std::max(vmax, block.pixels[i][channel]);
+		}
+		const uint8_t a0 = uint8_t(vmax);
+		const uint8_t a1 = uint8_t(vmin);
+		dst[0] = a0;
+		dst[1] = a1;
+		uint64_t bits = 0;
+		if (a0 > a1)
+		{
+			float palette[8];
+			palette[0] = a0;
+			palette[1] = a1;
+			for (int i = 1; i < 7; ++i)
+			{
+				palette[i + 1] = ((7 - i) * a0 + i * a1) / 7.0f;
+			}
+			for (int i = 0; i < 16; ++i)
+			{
+				uint64_t best_index = 0;
+				float best = FLT_MAX;
+				for (int j = 0; j < 8; ++j)
+				{
+					const float distance = std::abs(block.pixels[i][channel] - palette[j]);
+					if (distance < best)
+					{
+						best = distance;
+						best_index = j;
+					}
+				}
+				bits |= best_index << (i * 3);
+			}
+		}
+		for (int i = 0; i < 6; ++i)
+		{
+			dst[2 + i] = uint8_t(bits >> (i * 8));
+		}
+	}
+
+	// BC7 block in mode 6 (one subset, RGBA endpoints with 7 bits and unique p-bits, 4 bit indices), 16 bytes
+	void CompressBC7(const Block& block, uint8_t* dst)
+	{
+		static const int weights_int[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		static const float weights[16] = {
+			0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+			34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f,
+		};
+
+		float e0[4], e1[4];
+		FitLine(block, 4, e0, e1);
+
+		// Quantizes an endpoint to 7 bits with the p-bit that matches it best:
+		auto Quantize = [](const float endpoint[4], uint32_t quantized[4], uint32_t& pbit) {
+			float best = FLT_MAX;
+			for (uint32_t p = 0; p < 2; ++p)
+			{
+				uint32_t q[4];
+				float error = 0;
+				for (int c = 0; c < 4; ++c)
+				{
+					q[c] = (uint32_t)std::max(0, std::min(127, int((endpoint[c] - p) * 0.5f + 0.5f)));
+					const float d = float(q[c] * 2 + p) - endpoint[c];
+					error += d * d;
+				}
+				if (error < best)
+				{
+					best = error;
+					pbit = p;
+					std::memcpy(quantized, q, sizeof(q));
+				}
+			}
+		};
+
+		uint32_t best_q0[4] = {}, best_q1[4] = {};
+		uint32_t best_p0 = 0, best_p1 = 0;
+		uint8_t best_indices[16] = {};
+		float best_error = FLT_MAX;
+		for (int iteration = 0; iteration < 3; ++iteration)
+		{
+			uint32_t q0[4], q1[4], p0, p1;
+			Quantize(e0, q0, p0);
+			Quantize(e1, q1, p1);
+			float palette[16][4];
+			for (int i = 0; i < 16; ++i)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					const int d0 = int(q0[c] * 2 + p0);
+					const int d1 = int(q1[c] * 2 + p1);
+					palette[i][c] = float(((64 - weights_int[i]) * d0 + weights_int[i] * d1 + 32) >> 6);
+				}
+			}
+			uint8_t indices[16];
+			const float error = SelectIndices(block, 4, palette, 16, indices);
+			if (error < best_error)
+			{
+				best_error = error;
+				std::memcpy(best_q0, q0, sizeof(q0));
+				std::memcpy(best_q1, q1, sizeof(q1));
+				best_p0 = p0;
+				best_p1 = p1;
+				std::memcpy(best_indices, indices, sizeof(indices));
+			}
+			Refit(block, 4, indices, weights, e0, e1);
+		}
+
+		// The most significant bit of the first index is implicitly zero:
+		if (best_indices[0] & 8)
+		{
+			std::swap(best_q0, best_q1);
+			std::swap(best_p0, best_p1);
+			for (auto& index : best_indices)
+			{
+				index = 15 - index;
+			}
+		}
+
+		uint64_t bits[2] = {};
+		uint32_t pos = 0;
+		auto Write = [&](uint32_t value, uint32_t count) {
+			for (uint32_t i = 0; i < count; ++i, ++pos)
+			{
+				bits[pos >> 6] |= uint64_t((value >> i) & 1) << (pos & 63);
+			}
+		};
+		Write(1 << 6, 7); // mode 6
+		for (int c = 0; c < 4; ++c)
+		{
+			Write(best_q0[c], 7);
+			Write(best_q1[c], 7);
+		}
+		Write(best_p0, 1);
+		Write(best_p1, 1);
+		Write(best_indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+		{
+			Write(best_indices[i], 4);
+		}
+		for (int i = 0; i < 16; ++i)
+		{
+			dst[i] = uint8_t(bits[i >> 3] >> ((i & 7) * 8));
+		}
+	}
+}
+using namespace wiTextureCooker_Internal;
+
+namespace wiTextureCooker
+{
+	std::string GetCookedFileName(const uint8_t* filedata, size_t filesize)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.dds", (unsigned long long)Hash(filedata, filesize, COOK_VERSION));
+		return name;
+	}
+
+	bool Cook(const uint8_t* filedata, size_t filesize, std::vector<uint8_t>& dds, FORMAT format)
+	{
+		int width, height, channels;
+		uint8_t* rgba = stbi_load_from_memory(filedata, (int)filesize, &width, &height, &channels, 4);
+		if (rgba == nullptr)
+		{
+			return false;
+		}
+		if (width % 4 != 0 || height % 4 != 0)
+		{
+			// The most detailed mip of block compressed textures must be made of whole blocks
+			stbi_image_free(rgba);
+			return false;
+		}
+
+		std::vector<Image> mips(1);
+		mips[0].width = uint32_t(width);
+		mips[0].height = uint32_t(height);
+		mips[0].rgba.assign(rgba, rgba + size_t(width) * size_t(height) * 4);
+		stbi_image_free(rgba);
+
+		if (format == FORMAT_AUTO)
+		{
+			format = FORMAT_BC1;
+			for (size_t i = 3; i < mips[0].rgba.size(); i += 4)
+			{
+				if (mips[0].rgba[i] < 255)
+				{
+					format = FORMAT_BC3;
+					break;
+				}
+			}
+		}
+
+		while (mips.back().width > 1 || mips.back().height > 1)
+		{
+			mips.push_back(Downsample(mips.back()));
+		}
+
+		uint32_t dxgi_format = DXGI_FORMAT_BC1_UNORM;
+		uint32_t block_size = 8;
+		switch (format)
+		{
+		case FORMAT_BC3: dxgi_format = DXGI_FORMAT_BC3_UNORM; block_size = 16; break;
+		case FORMAT_BC5: dxgi_format = DXGI_FORMAT_BC5_UNORM; block_size = 16; break;
+		case FORMAT_BC7: dxgi_format = DXGI_FORMAT_BC7_UNORM; block_size = 16; break;
+		default: break;
+		}
+
+		// DDS header with the DX10 extension:
+		uint32_t header[32 + 5] = {};
+		header[0] = 0x20534444; // "DDS "
+		header[1] = 124; // header size
+		header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixelformat, mipmapcount, linearsize
+		header[3] = uint32_t(height);
+		header[4] = uint32_t(width);
+		header[5] = uint32_t(width / 4) * uint32_t(height / 4) * block_size;
+		header[7] = uint32_t(mips.size());
+		header[19] = 32; // pixel format size
+		header[20] = 0x4; // fourcc
+		header[21] = 0x30315844; // "DX10"
+		header[27] = 0x1000 | 0x8 | 0x400000; // texture, complex, mipmap
+		header[32] = dxgi_format;
+		header[33] = 3; // texture 2D
+		header[35] = 1; // array size
+
+		dds.resize(sizeof(header));
+		std::memcpy(dds.data(), header, sizeof(header));
+
+		for (const Image& mip : mips)
+		{
+			const uint32_t blocks_x = (mip.width + 3) / 4;
+			const uint32_t blocks_y = (mip.height + 3) / 4;
+			size_t offset = dds.size();
+			dds.resize(offset + size_t(blocks_x) * blocks_y * block_size);
+
+			Block block;
+			for (uint32_t by = 0; by < blocks_y; ++by)
+			{
+				for (uint32_t bx = 0; bx < blocks_x; ++bx)
+				{
+					GetBlock(mip, bx, by, block);
+					uint8_t* dst = dds.data() + offset;
+					switch (format)
+					{
+					case FORMAT_BC3:
+						CompressBC4(block, 3, dst);
+						CompressBC1(block, dst + 8);
+						break;
+					case FORMAT_BC5:
+						CompressBC4(block, 0, dst);
+						CompressBC4(block, 1, dst + 8);
+						break;
+					case FORMAT_BC7:
+						CompressBC7(block, dst);
+						break;
+					default:
+						CompressBC1(block, dst);
+						break;
+					}
+					offset += block_size;
+				}
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <string>
+#include <vector>
+
+// Converts source images to block compressed DDS textures with precomputed mip chains (used by the OfflineTextureCooker tool)
+//	wiResourceManager loads the cooked DDS instead of the source image when it's found in the cooked texture directory
+namespace wiTextureCooker
+{
+	enum FORMAT
+	{
+		FORMAT_AUTO, // BC1 for opaque images, BC3 for images with alpha
+		FORMAT_BC1, // RGB, 4 bits per pixel
+		FORMAT_BC3, // RGBA, 8 bits per pixel
+		FORMAT_BC5, // RG, 8 bits per pixel, for two channel data
+		FORMAT_BC7, // RGBA, 8 bits per pixel, higher quality than BC1 and BC3
+	};
+
+	// Returns the file name of the cooked texture for the source image file data
+	//	The name is the hash of the contents, so a cooked texture is never used for a modified source image
+	std::string GetCookedFileName(const uint8_t* filedata, size_t filesize);
+
+	// Converts source image file data (PNG, JPG, TGA, BMP) to a DDS file with block compressed mips
+	//	Mips are generated the same way as wiRenderer generates them on the GPU for these images (alpha coverage is preserved)
+	//	Returns false if the image can't be decoded, or its dimensions are not multiples of 4
+	bool Cook(const uint8_t* filedata, size_t filesize, std::vector<uint8_t>& dds, FORMAT format = FORMAT_AUTO);
+}